@@ -133,4 +133,18 @@
 #define atomic_store(ptr, val) (*(ptr) = (val))
 #endif
 
+/* Full memory barrier for the lock-free ring buffer. Platforms without one
+ * leave SNG_HAVE_BARRIER undefined and ringbuf falls back to a mutex
+ * lock/unlock pair, which POSIX guarantees synchronizes memory. */
+#if defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 1))
+#define SNG_HAVE_BARRIER
+#define sng_barrier() __sync_synchronize()
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+/* x86 never reorders the loads and stores a seqlock depends on, so a
+ * compiler barrier is enough */
+#include <intrin.h>
+#define SNG_HAVE_BARRIER
+#define sng_barrier() _ReadWriteBarrier()
+#endif
+
 #endif /* COMPAT_H */
@@ -56,6 +56,81 @@ static color_t parse_color(const char *str) {
     return color;
 }
 
+/* "90", "90s", "15m", "6h", "7d" -> milliseconds; bare numbers are seconds */
+static int parse_duration_ms(const char *str, uint32_t *ms) {
+    char *end;
+    double value;
+
+    if (!str) return 0;
+
+    value = strtod(str, &end);
+    if (end == str || value < 0.0) return 0;
+
+    switch (*end) {
+    case 'd': value *= 24.0;   /* fall through */
+    case 'h': value *= 60.0;   /* fall through */
+    case 'm': value *= 60.0;   /* fall through */
+    case 's':
+        end++;
+        /* fall through */
+    case '\0':
+        break;
+    default:
+        return 0;
+    }
+    if (*end != '\0') return 0;
+
+    value *= 1000.0;
+    if (value > 4294967295.0) return 0;
+    *ms = (uint32_t)value;
+    return 1;
+}
+
+/* "3600" -> samples, "6h" -> how far back; a unit makes it a duration */
+static void parse_history(const char *str, uint32_t *samples, uint32_t *ms) {
+    char *end;
+    unsigned long n;
+
+    n = strtoul(str, &end, 10);
+    if (end != str && *end == '\0') {
+        *samples = (uint32_t)n;
+        *ms = 0;
+    } else if (parse_duration_ms(str, ms)) {
+        *samples = 0;
+    }
+}
+
+/* "1m:6h,10m:2d,1h:7d" - bucket width and how far back each tier reaches */
+static void parse_history_tiers(const char *str, config_t *config) {
+    char buf[256];
+    char *item, *colon;
+    uint32_t bucket_ms, span_ms;
+    uint32_t i;
+
+    config->history_tier_count = 0;
+    strncpy(buf, str, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+
+    for (item = strtok(buf, ", "); item; item = strtok(NULL, ", ")) {
+        if (config->history_tier_count >= CONFIG_MAX_HISTORY_TIERS) break;
+        colon = strchr(item, ':');
+        if (!colon) continue;
+        *colon = '\0';
+        if (!parse_duration_ms(item, &bucket_ms) || !parse_duration_ms(colon + 1, &span_ms)) continue;
+        if (bucket_ms == 0 || span_ms < bucket_ms) continue;
+
+        /* keep finest first */
+        i = config->history_tier_count;
+        while (i > 0 && config->history_tiers[i - 1].bucket_ms > bucket_ms) {
+            config->history_tiers[i] = config->history_tiers[i - 1];
+            i--;
+        }
+        config->history_tiers[i].bucket_ms = bucket_ms;
+        config->history_tiers[i].buckets = span_ms / bucket_ms;
+        config->history_tier_count++;
+    }
+}
+
 static int parse_type_target(const char *type, const char *target, plot_config_t *plot, config_t *config) {
     const char *actual_type;
     const char *actual_target;
@@ -79,6 +154,9 @@ static int parse_type_target(const char *type, const char *target, plot_config_t
         if (strncmp(target, "snmp1,", 6) == 0) {
             actual_type = "snmp";
             actual_target = target + 6;
+        } else if (strncmp(target, "snmp2c,", 7) == 0) {
+            actual_type = "snmp2c";
+            actual_target = target + 7;
         } else {
             actual_type = "if_thr";
         }
@@ -97,7 +175,7 @@ static int parse_type_target(const char *type, const char *target, plot_config_t
     }
     type_upper[strlen(type)] = '\0';
 
-    if (strcmp(actual_type, "snmp") == 0) {
+    if (strcmp(actual_type, "snmp") == 0 || strcmp(actual_type, "snmp2c") == 0) {
         if (sscanf(actual_target, "%127[^,],%63[^,],%31s", host, community, iface) == 3) {
             snprintf(auto_name, sizeof(auto_name), "BW - %s:%s", host, iface);
         } else {
@@ -145,6 +223,9 @@ static int parse_type_target(const char *type, const char *target, plot_config_t
     plot->background_color = mk_color(100, 100, 100, 255);
     plot->height = 100;
     plot->refresh_interval_ms = 0;
+    plot->span_ms = 0;
+    plot->history_samples = 0;
+    plot->history_ms = 0;
 
     return 1;
 }
@@ -179,7 +260,15 @@ static void parse_plot_config(ini_file_t *ini, plot_config_t *plot, const char *
     }
 
     if ((value = ini_get_value(ini, section_name, "refresh_interval_sec"))) {
-        plot->refresh_interval_ms = atoi(value) * 1000;
+        plot->refresh_interval_ms = (int32_t)(atof(value) * 1000.0);
+    }
+
+    if ((value = ini_get_value(ini, section_name, "span"))) {
+        parse_duration_ms(value, &plot->span_ms);
+    }
+
+    if ((value = ini_get_value(ini, section_name, "history"))) {
+        parse_history(value, &plot->history_samples, &plot->history_ms);
     }
 }
 
@@ -267,6 +356,14 @@ config_t *config_load(const char *filename) {
     config->font_name = NULL;
     config->http_enabled = 0;
     config->http_port = 8080;
+    config->collector_threads = 4;
+    config->span_ms = 0;
+    config->history_samples = 0;
+    config->history_ms = 0;
+    config->history_dir = NULL;
+    config->history_compressed_kb = 0;
+    parse_history_tiers("1m:6h,10m:2d,1h:7d", config);
+    config->history_percentiles = 0;
     config->plots = NULL;
     config->plot_count = 0;
     
@@ -295,7 +392,7 @@ config_t *config_load(const char *filename) {
         config->default_width = atoi(value);
     }
     if ((value = ini_get_value(ini, "global", "refresh_interval_sec"))) {
-        config->refresh_interval_ms = atoi(value) * 1000;
+        config->refresh_interval_ms = (int32_t)(atof(value) * 1000.0);
     }
     if ((value = ini_get_value(ini, "global", "window_margin"))) {
         config->window_margin = atoi(value);
@@ -321,6 +418,31 @@ config_t *config_load(const char *filename) {
             config->http_port = port;
         }
     }
+    if ((value = ini_get_value(ini, "global", "collector_threads"))) {
+        config->collector_threads = atoi(value);
+        if (config->collector_threads < 1) config->collector_threads = 1;
+    }
+    if ((value = ini_get_value(ini, "global", "span"))) {
+        parse_duration_ms(value, &config->span_ms);
+    }
+    if ((value = ini_get_value(ini, "global", "history"))) {
+        parse_history(value, &config->history_samples, &config->history_ms);
+    }
+    if ((value = ini_get_value(ini, "global", "history_tiers"))) {
+        parse_history_tiers(value, config);
+    }
+    if ((value = ini_get_value(ini, "global", "history_percentiles"))) {
+        config->history_percentiles = (strcmp(value, "1") == 0 || strcmp(value, "true") == 0);
+    }
+    if ((value = ini_get_value(ini, "global", "history_dir")) && *value) {
+        config->history_dir = malloc(strlen(value) + 1);
+        if (config->history_dir) {
+            strcpy(config->history_dir, value);
+        }
+    }
+    if ((value = ini_get_value(ini, "global", "history_compressed_kb"))) {
+        config->history_compressed_kb = (uint32_t)strtoul(value, NULL, 10);
+    }
     if ((value = ini_get_value(ini, "global", "fps_counter"))) {
         config->fps_counter = (strcmp(value, "1") == 0 || strcmp(value, "true") == 0);
     }
@@ -413,6 +535,9 @@ void config_destroy(config_t *config) {
     }
 
     free(config->plots);
+    if (config->history_dir) {
+        free(config->history_dir);
+    }
     if (config->font_name) {
         free(config->font_name);
     }
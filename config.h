@@ -13,8 +13,19 @@ typedef struct {
     color_t background_color;
     int32_t height;
     int32_t refresh_interval_ms;
+    uint32_t span_ms;       /* time shown across the plot, 0 = global */
+    uint32_t history_samples;   /* raw samples kept, 0 = global */
+    uint32_t history_ms;    /* or how far back they reach */
 } plot_config_t;
 
+#define CONFIG_MAX_HISTORY_TIERS 4
+
+/* Consolidated history kept beside the raw samples */
+typedef struct {
+    uint32_t bucket_ms;
+    uint32_t buckets;
+} history_tier_t;
+
 typedef enum {
     FULLSCREEN_OFF = 0,
     FULLSCREEN_ON = 1,
@@ -39,6 +50,15 @@ typedef struct {
     char *font_name;
     int http_enabled;
     int32_t http_port;
+    int32_t collector_threads;
+    uint32_t span_ms;       /* 0 = one pixel per refresh interval */
+    uint32_t history_samples;   /* raw samples kept per plot, 0 = default_width */
+    uint32_t history_ms;    /* or how far back they reach */
+    history_tier_t history_tiers[CONFIG_MAX_HISTORY_TIERS];     /* finest first */
+    uint32_t history_tier_count;
+    int history_percentiles;    /* quantile sketch in every tier bucket */
+    char *history_dir;      /* NULL = history is not kept across restarts */
+    uint32_t history_compressed_kb;     /* per series, 0 = no archive */
 
     plot_config_t *plots;
     uint32_t plot_count;
@@ -17,7 +17,9 @@ extern datasource_handler_t tcp_handler;
 extern datasource_handler_t cpu_handler;
 extern datasource_handler_t memory_handler;
 extern datasource_handler_t snmp_handler;
+extern datasource_handler_t snmp2c_handler;
 extern datasource_handler_t if_thr_handler;
+extern datasource_handler_t if_pps_handler;
 extern datasource_handler_t loadavg_handler;
 #ifndef NO_SHELL
 extern datasource_handler_t shell_handler;
@@ -30,7 +32,9 @@ static datasource_handler_t *handlers[] = {
     &cpu_handler,
     &memory_handler,
     &snmp_handler,
+    &snmp2c_handler,
     &if_thr_handler,
+    &if_pps_handler,
     &loadavg_handler,
 #ifndef NO_SHELL
     &shell_handler,
@@ -108,6 +112,12 @@ void datasource_set_refresh_interval(datasource_t *ds, int32_t refresh_interval_
         extern void shell_set_refresh_interval(void *context, int32_t refresh_interval_ms);
         shell_set_refresh_interval(ds->context, refresh_interval_ms);
     }
+#endif
+#ifndef DS_MINIMAL
+    if (ds->handler == &snmp_handler || ds->handler == &snmp2c_handler) {
+        extern void snmp_set_refresh_interval(void *context, int32_t refresh_interval_ms);
+        snmp_set_refresh_interval(ds->context, refresh_interval_ms);
+    }
 #else
     (void)refresh_interval_ms;
 #endif
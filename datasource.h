@@ -15,6 +15,9 @@ typedef struct {
     double last_secondary;
 } datasource_stats_t;
 
+/* Completion for collect_async; value2 is only used by dual sources */
+typedef void (*datasource_done_fn)(void *arg, int success, double value1, double value2);
+
 typedef struct {
     int (*init)(const char *target, void **context);
     int (*collect)(void *context, double *value);
@@ -28,6 +31,9 @@ typedef struct {
     const char *unit;
     int is_dual;
     double max_scale;
+    /* Optional: start a sample and return without waiting for it. Returns 0
+     * if nothing was started, otherwise done() is called exactly once. */
+    int (*collect_async)(void *context, datasource_done_fn done, void *arg);
 } datasource_handler_t;
 
 typedef struct {
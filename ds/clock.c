@@ -15,8 +15,8 @@ typedef struct {
     double max_hours;
     double min_minutes;
     double max_minutes;
-    uint64_t sum_hours;
-    uint64_t sum_minutes;
+    double sum_hours;
+    double sum_minutes;
     uint32_t sample_count;
     double last_hours;
     double last_minutes;
@@ -37,8 +37,8 @@ static int clock_init(const char *target, void **context) {
     ctx->max_hours = 0.0;
     ctx->min_minutes = 60.0;
     ctx->max_minutes = 0.0;
-    ctx->sum_hours = 0;
-    ctx->sum_minutes = 0;
+    ctx->sum_hours = 0.0;
+    ctx->sum_minutes = 0.0;
     ctx->sample_count = 0;
     ctx->last_hours = 0.0;
     ctx->last_minutes = 0.0;
@@ -80,8 +80,8 @@ static int clock_collect(void *context, double *value) {
     if (hours > ctx->max_hours) ctx->max_hours = hours;
     if (scaled_minutes < ctx->min_minutes) ctx->min_minutes = scaled_minutes;
     if (scaled_minutes > ctx->max_minutes) ctx->max_minutes = scaled_minutes;
-    ctx->sum_hours += (uint64_t)hours;
-    ctx->sum_minutes += (uint64_t)scaled_minutes;
+    ctx->sum_hours += hours;
+    ctx->sum_minutes += scaled_minutes;
     ctx->last_hours = hours;
     ctx->last_minutes = scaled_minutes;
     ctx->sample_count++;
@@ -123,8 +123,8 @@ static int clock_collect_dual(void *context, double *hours_value, double *minute
     if (hours > ctx->max_hours) ctx->max_hours = hours;
     if (scaled_minutes < ctx->min_minutes) ctx->min_minutes = scaled_minutes;
     if (scaled_minutes > ctx->max_minutes) ctx->max_minutes = scaled_minutes;
-    ctx->sum_hours += (uint64_t)hours;
-    ctx->sum_minutes += (uint64_t)scaled_minutes;
+    ctx->sum_hours += hours;
+    ctx->sum_minutes += scaled_minutes;
     ctx->last_hours = hours;
     ctx->last_minutes = scaled_minutes;
     ctx->sample_count++;
@@ -171,11 +171,11 @@ static int clock_get_stats(void *context, datasource_stats_t *stats) {
 
     stats->min = ctx->min_hours;
     stats->max = ctx->max_hours;
-    stats->avg = (double)(ctx->sum_hours / ctx->sample_count);
+    stats->avg = ctx->sum_hours / ctx->sample_count;
     stats->last = last_display;
     stats->min_secondary = ctx->min_minutes;
     stats->max_secondary = ctx->max_minutes;
-    stats->avg_secondary = (double)(ctx->sum_minutes / ctx->sample_count);
+    stats->avg_secondary = ctx->sum_minutes / ctx->sample_count;
     stats->last_secondary = ctx->last_minutes;
 
     return 1;
@@ -219,5 +219,6 @@ datasource_handler_t clock_handler = {
     "clock",
     "",
     1,
-    24.0
+    24.0,
+    NULL
 };
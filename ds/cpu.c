@@ -14,11 +14,14 @@ typedef struct {
     double max_total;
     double min_system;
     double max_system;
-    uint64_t sum_total;
-    uint64_t sum_system;
+    double sum_total;
+    double sum_system;
     uint32_t sample_count;
     double last_total;
     double last_system;
+#ifdef OS_HAVE_CPU_TICKS
+    os_cpu_ticks_t prev_ticks;
+#endif
 } cpu_context_t;
 
 static int cpu_init(const char *target, void **context) {
@@ -29,29 +32,51 @@ static int cpu_init(const char *target, void **context) {
     ctx->max_total = 0.0;
     ctx->min_system = 100.0;
     ctx->max_system = 0.0;
-    ctx->sum_total = 0;
-    ctx->sum_system = 0;
+    ctx->sum_total = 0.0;
+    ctx->sum_system = 0.0;
     ctx->sample_count = 0;
     ctx->last_total = 0.0;
     ctx->last_system = 0.0;
+#ifdef OS_HAVE_CPU_TICKS
+    ctx->prev_ticks.idle = 0;
+    ctx->prev_ticks.system = 0;
+    ctx->prev_ticks.total = 0;
+#endif
 
     *context = ctx;
     return 1;
 }
 
+/* Usage since this plot's own previous sample */
+static int cpu_sample(cpu_context_t *ctx, double *total_value, double *system_value) {
+#ifdef OS_HAVE_CPU_TICKS
+    os_cpu_ticks_t now;
+
+    if (!os_cpu_get_ticks(&now)) return 0;
+
+    os_cpu_ticks_usage(&ctx->prev_ticks, &now, total_value, system_value);
+    ctx->prev_ticks = now;
+    return 1;
+#else
+    (void)ctx;
+    return os_cpu_get_stats_dual(total_value, system_value);
+#endif
+}
+
 static int cpu_collect(void *context, double *value) {
     cpu_context_t *ctx;
+    double system_value;
 
     ctx = (cpu_context_t *)context;
     if (!ctx || !value) return 0;
 
-    if (!os_cpu_get_stats(value)) {
+    if (!cpu_sample(ctx, value, &system_value)) {
         return 0;
     }
 
     if (*value < ctx->min_total) ctx->min_total = *value;
     if (*value > ctx->max_total) ctx->max_total = *value;
-    ctx->sum_total += (uint64_t)*value;
+    ctx->sum_total += *value;
     ctx->last_total = *value;
     ctx->sample_count++;
 
@@ -64,7 +89,7 @@ static int cpu_collect_dual(void *context, double *total_value, double *system_v
     ctx = (cpu_context_t *)context;
     if (!ctx || !total_value || !system_value) return 0;
 
-    if (!os_cpu_get_stats_dual(total_value, system_value)) {
+    if (!cpu_sample(ctx, total_value, system_value)) {
         return 0;
     }
 
@@ -72,8 +97,8 @@ static int cpu_collect_dual(void *context, double *total_value, double *system_v
     if (*total_value > ctx->max_total) ctx->max_total = *total_value;
     if (*system_value < ctx->min_system) ctx->min_system = *system_value;
     if (*system_value > ctx->max_system) ctx->max_system = *system_value;
-    ctx->sum_total += (uint64_t)*total_value;
-    ctx->sum_system += (uint64_t)*system_value;
+    ctx->sum_total += *total_value;
+    ctx->sum_system += *system_value;
     ctx->last_total = *total_value;
     ctx->last_system = *system_value;
     ctx->sample_count++;
@@ -99,11 +124,11 @@ static int cpu_get_stats(void *context, datasource_stats_t *stats) {
 
     stats->min = ctx->min_total;
     stats->max = ctx->max_total;
-    stats->avg = (double)(ctx->sum_total / ctx->sample_count);
+    stats->avg = ctx->sum_total / ctx->sample_count;
     stats->last = ctx->last_total;
     stats->min_secondary = ctx->min_system;
     stats->max_secondary = ctx->max_system;
-    stats->avg_secondary = (double)(ctx->sum_system / ctx->sample_count);
+    stats->avg_secondary = ctx->sum_system / ctx->sample_count;
     stats->last_secondary = ctx->last_system;
 
     return 1;
@@ -133,5 +158,6 @@ datasource_handler_t cpu_handler = {
     "cpu",
     "%",
     1,
-    100.0
+    100.0,
+    NULL
 };
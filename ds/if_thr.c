@@ -11,33 +11,41 @@
 #include <stdio.h>
 #include <time.h>
 
+/* Which counter pair a plot follows */
+#define IF_COUNT_BYTES   0
+#define IF_COUNT_PACKETS 1
+#define IF_COUNT_ERRORS  2
+#define IF_COUNT_DROPPED 3
+
 typedef struct {
     char *interface_name;
-    uint32_t prev_in_bytes;
-    uint32_t prev_out_bytes;
-    time_t prev_time;
+    int counter;
+#ifdef OS_HAVE_IF_STATS64
+    uint64_t prev_in;
+    uint64_t prev_out;
+    uint64_t prev_ns;
+#else
+    uint32_t prev_in;
+    uint32_t prev_out;
+    uint32_t prev_ms;
+#endif
     int first_sample;
-    uint32_t last_in_rate;
-    uint32_t last_out_rate;
-    uint32_t last_rate;
-
-    // Statistics tracking in native uint32_t
-    uint32_t min_in_rate;
-    uint32_t max_in_rate;
-    uint32_t min_out_rate;
-    uint32_t max_out_rate;
-    uint32_t min_combined_rate;
-    uint32_t max_combined_rate;
-    uint64_t sum_in_rate;
-    uint64_t sum_out_rate;
-    uint64_t sum_combined_rate;
+    double last_in_rate;
+    double last_out_rate;
+    double last_rate;
+
+    double min_in_rate;
+    double max_in_rate;
+    double min_out_rate;
+    double max_out_rate;
+    double min_combined_rate;
+    double max_combined_rate;
+    double sum_in_rate;
+    double sum_out_rate;
+    double sum_combined_rate;
     uint32_t sample_count;
 } if_thr_context_t;
 
-static int get_interface_stats(const char* interface_name, uint32_t* in_bytes, uint32_t* out_bytes) {
-    return os_get_interface_stats(interface_name, in_bytes, out_bytes);
-}
-
 static void format_rate_human_readable(double disp_bytes_per_sec, char* buffer, size_t buffer_size) {
     if (disp_bytes_per_sec >= 1073741824.0) {
         snprintf(buffer, buffer_size, "%.1f GB/s", disp_bytes_per_sec / 1073741824.0);
@@ -50,29 +58,44 @@ static void format_rate_human_readable(double disp_bytes_per_sec, char* buffer,
     }
 }
 
-static int parse_if_thr_target(const char* target, char** interface_name) {
+static int parse_if_thr_target(const char* target, char** interface_name, int* counter) {
     char* target_copy;
     char* type_str;
     char* interface_str;
+    char* counter_str;
 
     if (!target) return 0;
 
     target_copy = strdup(target);
     type_str = strtok(target_copy, ",");
     interface_str = strtok(NULL, ",");
+    counter_str = strtok(NULL, ",");
 
     if (!type_str || !interface_str || strcmp(type_str, "local") != 0) {
         free(target_copy);
         return 0;
     }
 
+    if (counter_str) {
+        if (strcmp(counter_str, "packets") == 0) {
+            *counter = IF_COUNT_PACKETS;
+        } else if (strcmp(counter_str, "errors") == 0) {
+            *counter = IF_COUNT_ERRORS;
+        } else if (strcmp(counter_str, "drops") == 0) {
+            *counter = IF_COUNT_DROPPED;
+        } else {
+            free(target_copy);
+            return 0;
+        }
+    }
+
     *interface_name = strdup(interface_str);
 
     free(target_copy);
     return (*interface_name != NULL);
 }
 
-static int if_thr_init(const char *target, void **context) {
+static int if_init_counter(const char *target, void **context, int counter) {
     if_thr_context_t *ctx;
 
     if (!target) return 0;
@@ -80,92 +103,177 @@ static int if_thr_init(const char *target, void **context) {
     ctx = malloc(sizeof(if_thr_context_t));
     if (!ctx) return 0;
 
-    if (!parse_if_thr_target(target, &ctx->interface_name)) {
+    ctx->counter = counter;
+    if (!parse_if_thr_target(target, &ctx->interface_name, &ctx->counter)) {
+        free(ctx);
+        return 0;
+    }
+    /* bw= shows bytes only; packet, error and drop rates belong to pps= */
+    if (counter == IF_COUNT_BYTES && ctx->counter != IF_COUNT_BYTES) {
+        free(ctx->interface_name);
         free(ctx);
         return 0;
     }
 
-    ctx->prev_in_bytes = 0;
-    ctx->prev_out_bytes = 0;
-    ctx->prev_time = 0;
+    ctx->prev_in = 0;
+    ctx->prev_out = 0;
+#ifdef OS_HAVE_IF_STATS64
+    ctx->prev_ns = 0;
+#else
+    /* only byte counters are portable */
+    if (ctx->counter != IF_COUNT_BYTES) {
+        free(ctx->interface_name);
+        free(ctx);
+        return 0;
+    }
+    ctx->prev_ms = 0;
+#endif
     ctx->first_sample = 1;
-    ctx->last_in_rate = 0;
-    ctx->last_out_rate = 0;
-    ctx->last_rate = 0;
-
-    ctx->min_in_rate = UINT32_MAX;
-    ctx->max_in_rate = 0;
-    ctx->min_out_rate = UINT32_MAX;
-    ctx->max_out_rate = 0;
-    ctx->min_combined_rate = UINT32_MAX;
-    ctx->max_combined_rate = 0;
-    ctx->sum_in_rate = 0;
-    ctx->sum_out_rate = 0;
-    ctx->sum_combined_rate = 0;
+    ctx->last_in_rate = 0.0;
+    ctx->last_out_rate = 0.0;
+    ctx->last_rate = 0.0;
+
+    ctx->min_in_rate = 0.0;
+    ctx->max_in_rate = 0.0;
+    ctx->min_out_rate = 0.0;
+    ctx->max_out_rate = 0.0;
+    ctx->min_combined_rate = 0.0;
+    ctx->max_combined_rate = 0.0;
+    ctx->sum_in_rate = 0.0;
+    ctx->sum_out_rate = 0.0;
+    ctx->sum_combined_rate = 0.0;
     ctx->sample_count = 0;
 
     *context = ctx;
     return 1;
 }
 
-static int if_thr_collect_internal(if_thr_context_t *ctx) {
-    uint32_t in_bytes, out_bytes;
-    time_t current_time;
-    time_t time_diff;
-    uint32_t in_diff, out_diff;
-    uint32_t in_rate_bps, out_rate_bps, combined_rate_bps;
+static int if_thr_init(const char *target, void **context) {
+    return if_init_counter(target, context, IF_COUNT_BYTES);
+}
+
+static int if_pps_init(const char *target, void **context) {
+    return if_init_counter(target, context, IF_COUNT_PACKETS);
+}
+
+static void if_record(if_thr_context_t *ctx, double in_rate, double out_rate) {
+    double combined_rate;
+
+    combined_rate = in_rate + out_rate;
+
+    if (ctx->sample_count == 0 || in_rate < ctx->min_in_rate) ctx->min_in_rate = in_rate;
+    if (in_rate > ctx->max_in_rate) ctx->max_in_rate = in_rate;
+    if (ctx->sample_count == 0 || out_rate < ctx->min_out_rate) ctx->min_out_rate = out_rate;
+    if (out_rate > ctx->max_out_rate) ctx->max_out_rate = out_rate;
+    if (ctx->sample_count == 0 || combined_rate < ctx->min_combined_rate) ctx->min_combined_rate = combined_rate;
+    if (combined_rate > ctx->max_combined_rate) ctx->max_combined_rate = combined_rate;
+
+    ctx->sum_in_rate += in_rate;
+    ctx->sum_out_rate += out_rate;
+    ctx->sum_combined_rate += combined_rate;
+    ctx->sample_count++;
 
-    current_time = time(NULL);
+    ctx->last_in_rate = in_rate;
+    ctx->last_out_rate = out_rate;
+    ctx->last_rate = combined_rate;
+}
+
+#ifdef OS_HAVE_IF_STATS64
+/* 64-bit counters over a nanosecond clock: no wrap at 10G+ and rates stay
+ * accurate when the plot refreshes faster than once a second */
+static int if_thr_collect_internal(if_thr_context_t *ctx) {
+    os_if_stats64_t stats;
+    uint64_t in, out;
+    double elapsed;
 
-    if (!get_interface_stats(ctx->interface_name, &in_bytes, &out_bytes)) {
+    if (!os_get_interface_stats64(ctx->interface_name, &stats)) {
         return 0;
     }
 
-    if (ctx->first_sample) {
-        ctx->prev_in_bytes = in_bytes;
-        ctx->prev_out_bytes = out_bytes;
-        ctx->prev_time = current_time;
+    switch (ctx->counter) {
+    case IF_COUNT_PACKETS:
+        in = stats.rx_packets;
+        out = stats.tx_packets;
+        break;
+    case IF_COUNT_ERRORS:
+        in = stats.rx_errors;
+        out = stats.tx_errors;
+        break;
+    case IF_COUNT_DROPPED:
+        in = stats.rx_dropped;
+        out = stats.tx_dropped;
+        break;
+    default:
+        in = stats.rx_bytes;
+        out = stats.tx_bytes;
+        break;
+    }
+
+    if (ctx->first_sample || in < ctx->prev_in || out < ctx->prev_out) {
+        /* first sample, or the counters were reset (link re-created) */
+        ctx->prev_in = in;
+        ctx->prev_out = out;
+        ctx->prev_ns = stats.time_ns;
         ctx->first_sample = 0;
-        ctx->last_in_rate = 0;
-        ctx->last_out_rate = 0;
-        ctx->last_rate = 0;
+        ctx->last_in_rate = 0.0;
+        ctx->last_out_rate = 0.0;
+        ctx->last_rate = 0.0;
         return 1;
     }
 
-    time_diff = current_time - ctx->prev_time;
-    if (time_diff <= 0) {
+    /* same snapshot as last time, keep the previous rate */
+    if (stats.time_ns <= ctx->prev_ns) {
         return 1;
     }
 
-    in_diff = in_bytes - ctx->prev_in_bytes;
-    out_diff = out_bytes - ctx->prev_out_bytes;
+    elapsed = (double)(stats.time_ns - ctx->prev_ns) / 1e9;
+    if_record(ctx, (double)(in - ctx->prev_in) / elapsed, (double)(out - ctx->prev_out) / elapsed);
 
-    in_rate_bps = in_diff / time_diff;
-    out_rate_bps = out_diff / time_diff;
-    combined_rate_bps = in_rate_bps + out_rate_bps;
+    ctx->prev_in = in;
+    ctx->prev_out = out;
+    ctx->prev_ns = stats.time_ns;
 
-    // Update statistics with uint32_t values
-    if (in_rate_bps < ctx->min_in_rate) ctx->min_in_rate = in_rate_bps;
-    if (in_rate_bps > ctx->max_in_rate) ctx->max_in_rate = in_rate_bps;
-    if (out_rate_bps < ctx->min_out_rate) ctx->min_out_rate = out_rate_bps;
-    if (out_rate_bps > ctx->max_out_rate) ctx->max_out_rate = out_rate_bps;
-    if (combined_rate_bps < ctx->min_combined_rate) ctx->min_combined_rate = combined_rate_bps;
-    if (combined_rate_bps > ctx->max_combined_rate) ctx->max_combined_rate = combined_rate_bps;
+    return 1;
+}
+#else
+static int if_thr_collect_internal(if_thr_context_t *ctx) {
+    uint32_t in_bytes, out_bytes;
+    uint32_t now_ms;
+    double elapsed;
 
-    ctx->sum_in_rate += in_rate_bps;
-    ctx->sum_out_rate += out_rate_bps;
-    ctx->sum_combined_rate += combined_rate_bps;
-    ctx->sample_count++;
+    now_ms = os_get_time_ms();
+
+    if (!os_get_interface_stats(ctx->interface_name, &in_bytes, &out_bytes)) {
+        return 0;
+    }
+
+    if (ctx->first_sample) {
+        ctx->prev_in = in_bytes;
+        ctx->prev_out = out_bytes;
+        ctx->prev_ms = now_ms;
+        ctx->first_sample = 0;
+        ctx->last_in_rate = 0.0;
+        ctx->last_out_rate = 0.0;
+        ctx->last_rate = 0.0;
+        return 1;
+    }
+
+    if (now_ms == ctx->prev_ms) {
+        return 1;
+    }
 
-    ctx->prev_in_bytes = in_bytes;
-    ctx->prev_out_bytes = out_bytes;
-    ctx->prev_time = current_time;
-    ctx->last_in_rate = in_rate_bps;
-    ctx->last_out_rate = out_rate_bps;
-    ctx->last_rate = combined_rate_bps;
+    /* unsigned subtraction handles a single 32-bit wrap */
+    elapsed = (double)(uint32_t)(now_ms - ctx->prev_ms) / 1000.0;
+    if_record(ctx, (double)(uint32_t)(in_bytes - ctx->prev_in) / elapsed,
+              (double)(uint32_t)(out_bytes - ctx->prev_out) / elapsed);
+
+    ctx->prev_in = in_bytes;
+    ctx->prev_out = out_bytes;
+    ctx->prev_ms = now_ms;
 
     return 1;
 }
+#endif
 
 static int if_thr_collect(void *context, double *disp_value) {
     if_thr_context_t *ctx = (if_thr_context_t *)context;
@@ -176,7 +284,7 @@ static int if_thr_collect(void *context, double *disp_value) {
         return 0;
     }
 
-    *disp_value = (double)ctx->last_rate;
+    *disp_value = ctx->last_rate;
     return 1;
 }
 
@@ -190,8 +298,8 @@ static int if_thr_collect_dual(void *context, double *disp_in_value, double *dis
         return 0;
     }
 
-    *disp_in_value = (double)ctx->last_in_rate;
-    *disp_out_value = (double)ctx->last_out_rate;
+    *disp_in_value = ctx->last_in_rate;
+    *disp_out_value = ctx->last_out_rate;
     return 1;
 }
 
@@ -211,15 +319,14 @@ static int if_thr_get_stats(void *context, datasource_stats_t *stats) {
         return 1;
     }
 
-    // Convert from uint32_t to double for display
-    stats->min = (double)ctx->min_in_rate;
-    stats->max = (double)ctx->max_in_rate;
-    stats->avg = (double)(ctx->sum_in_rate / ctx->sample_count);
-    stats->last = (double)ctx->last_in_rate;
-    stats->min_secondary = (double)ctx->min_out_rate;
-    stats->max_secondary = (double)ctx->max_out_rate;
-    stats->avg_secondary = (double)(ctx->sum_out_rate / ctx->sample_count);
-    stats->last_secondary = (double)ctx->last_out_rate;
+    stats->min = ctx->min_in_rate;
+    stats->max = ctx->max_in_rate;
+    stats->avg = ctx->sum_in_rate / ctx->sample_count;
+    stats->last = ctx->last_in_rate;
+    stats->min_secondary = ctx->min_out_rate;
+    stats->max_secondary = ctx->max_out_rate;
+    stats->avg_secondary = ctx->sum_out_rate / ctx->sample_count;
+    stats->last_secondary = ctx->last_out_rate;
 
     return 1;
 }
@@ -244,6 +351,28 @@ static void if_thr_format_dual_stats(double in_value, double out_value, char *bu
     snprintf(buffer, buffer_size, "%s/%s", in_str, out_str);
 }
 
+static void format_pps(double value, char *buffer, size_t buffer_size) {
+    if (value >= 1000000.0) {
+        snprintf(buffer, buffer_size, "%.1f Mp/s", value / 1000000.0);
+    } else if (value >= 1000.0) {
+        snprintf(buffer, buffer_size, "%.1f Kp/s", value / 1000.0);
+    } else {
+        snprintf(buffer, buffer_size, "%.1f p/s", value);
+    }
+}
+
+static void if_pps_format_value(double value, char *buffer, size_t buffer_size) {
+    format_pps(value, buffer, buffer_size);
+}
+
+static void if_pps_format_dual_stats(double in_value, double out_value, char *buffer, size_t buffer_size) {
+    char in_str[32];
+    char out_str[32];
+    format_pps(in_value, in_str, sizeof(in_str));
+    format_pps(out_value, out_str, sizeof(out_str));
+    snprintf(buffer, buffer_size, "%s/%s", in_str, out_str);
+}
+
 datasource_handler_t if_thr_handler = {
     if_thr_init,
     if_thr_collect,
@@ -256,5 +385,22 @@ datasource_handler_t if_thr_handler = {
     "if_thr",
     "B/s",
     1,
-    0.0
+    0.0,
+    NULL
+};
+
+datasource_handler_t if_pps_handler = {
+    if_pps_init,
+    if_thr_collect,
+    if_thr_collect_dual,
+    if_thr_get_stats,
+    if_pps_format_value,
+    if_pps_format_dual_stats,
+    NULL,
+    if_thr_cleanup,
+    "pps",
+    "p/s",
+    1,
+    0.0,
+    NULL
 };
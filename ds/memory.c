@@ -12,7 +12,7 @@
 typedef struct {
     double min;
     double max;
-    uint64_t sum;
+    double sum;
     uint32_t sample_count;
     double last;
 } memory_stats_t;
@@ -23,7 +23,7 @@ static int memory_init(const char *target, void **context) {
 
     ctx->min = 100.0;
     ctx->max = 0.0;
-    ctx->sum = 0;
+    ctx->sum = 0.0;
     ctx->sample_count = 0;
     ctx->last = 0.0;
 
@@ -43,7 +43,7 @@ static int memory_collect(void *context, double *value) {
 
     if (*value < ctx->min) ctx->min = *value;
     if (*value > ctx->max) ctx->max = *value;
-    ctx->sum += (uint64_t)*value;
+    ctx->sum += *value;
     ctx->last = *value;
     ctx->sample_count++;
 
@@ -68,7 +68,7 @@ static int memory_get_stats(void *context, datasource_stats_t *stats) {
 
     stats->min = ctx->min;
     stats->max = ctx->max;
-    stats->avg = (double)(ctx->sum / ctx->sample_count);
+    stats->avg = ctx->sum / ctx->sample_count;
     stats->last = ctx->last;
     stats->min_secondary = 0.0;
     stats->max_secondary = 0.0;
@@ -98,5 +98,6 @@ datasource_handler_t memory_handler = {
     "memory",
     "%",
     0,
-    100.0
+    100.0,
+    NULL
 };
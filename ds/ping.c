@@ -18,7 +18,7 @@ typedef struct {
     int permanent_error;
     double min;
     double max;
-    uint64_t sum;
+    double sum;
     uint32_t sample_count;
     double last;
     double prev_ping;
@@ -28,6 +28,8 @@ typedef struct {
     double jitter_max;
     double jitter_sum;
     uint32_t jitter_count;
+    datasource_done_fn done;
+    void *done_arg;
 } ping_context_t;
 
 static int ping_init(const char *target, void **context) {
@@ -50,7 +52,7 @@ static int ping_init(const char *target, void **context) {
     ctx->permanent_error = 0;
     ctx->min = 10000.0;
     ctx->max = 0.0;
-    ctx->sum = 0;
+    ctx->sum = 0.0;
     ctx->sample_count = 0;
     ctx->last = 0.0;
     ctx->prev_ping = 0.0;
@@ -60,6 +62,8 @@ static int ping_init(const char *target, void **context) {
     ctx->jitter_max = 0.0;
     ctx->jitter_sum = 0.0;
     ctx->jitter_count = 0;
+    ctx->done = NULL;
+    ctx->done_arg = NULL;
 
     if (strcmp(target, "0.0.0.0") == 0) {
         ctx->permanent_error = 1;
@@ -77,18 +81,11 @@ static int ping_init(const char *target, void **context) {
     return 1;
 }
 
-static int ping_collect_internal(ping_context_t *ctx, double *value) {
+/* Re-resolves the target after a DNS failure; returns 0 if it can't ping yet */
+static int ping_prepare(ping_context_t *ctx) {
     time_t now;
-    double ping_time;
-    int success;
-    double diff;
 
-    if (!ctx || !value) return 0;
-
-    if (ctx->permanent_error) {
-        *value = -1.0;
-        return 0;
-    }
+    if (ctx->permanent_error) return 0;
 
     if (ctx->dns_failed || !ctx->ping_ctx) {
         now = time(NULL);
@@ -105,29 +102,27 @@ static int ping_collect_internal(ping_context_t *ctx, double *value) {
                 ctx->dns_failed = 0;
             } else {
                 ctx->dns_failed = 1;
-                *value = -1.0;
                 return 0;
             }
         } else if (!ctx->ping_ctx) {
-            *value = -1.0;
             return 0;
         }
     }
 
-    success = os_ping_send(ctx->ping_ctx, &ping_time);
-
-    *value = success ? ping_time : -1.0;
+    return 1;
+}
 
-    if (!success || *value < 0.0) return success;
+static void ping_record(ping_context_t *ctx, double value) {
+    double diff;
 
-    if (*value < ctx->min) ctx->min = *value;
-    if (*value > ctx->max) ctx->max = *value;
-    ctx->sum += (uint64_t)*value;
-    ctx->last = *value;
+    if (value < ctx->min) ctx->min = value;
+    if (value > ctx->max) ctx->max = value;
+    ctx->sum += value;
+    ctx->last = value;
     ctx->sample_count++;
 
     if (ctx->has_prev_ping) {
-        diff = *value - ctx->prev_ping;
+        diff = value - ctx->prev_ping;
         if (diff < 0.0) diff = -diff;
         ctx->jitter = ctx->jitter + (diff - ctx->jitter) / 16.0;
         if (ctx->jitter < ctx->jitter_min) ctx->jitter_min = ctx->jitter;
@@ -135,8 +130,28 @@ static int ping_collect_internal(ping_context_t *ctx, double *value) {
         ctx->jitter_sum += ctx->jitter;
         ctx->jitter_count++;
     }
-    ctx->prev_ping = *value;
+    ctx->prev_ping = value;
     ctx->has_prev_ping = 1;
+}
+
+static int ping_collect_internal(ping_context_t *ctx, double *value) {
+    double ping_time;
+    int success;
+
+    if (!ctx || !value) return 0;
+
+    if (!ping_prepare(ctx)) {
+        *value = -1.0;
+        return 0;
+    }
+
+    success = os_ping_send(ctx->ping_ctx, &ping_time);
+
+    *value = success ? ping_time : -1.0;
+
+    if (!success || *value < 0.0) return success;
+
+    ping_record(ctx, *value);
 
     return success;
 }
@@ -163,6 +178,31 @@ static int ping_collect_dual(void *context, double *latency, double *jitter) {
     return success;
 }
 
+static void ping_async_done(void *arg, int success, double ping_time_ms) {
+    ping_context_t *ctx = (ping_context_t *)arg;
+
+    if (!success || ping_time_ms < 0.0) {
+        ctx->done(ctx->done_arg, 0, -1.0, -1.0);
+        return;
+    }
+
+    ping_record(ctx, ping_time_ms);
+    ctx->done(ctx->done_arg, 1, ping_time_ms, ctx->jitter);
+}
+
+/* The collector keeps at most one sample in flight per source, so the
+ * completion target can live in the context. */
+static int ping_collect_async(void *context, datasource_done_fn done, void *arg) {
+    ping_context_t *ctx = (ping_context_t *)context;
+
+    if (!ctx || !done) return 0;
+    if (!ping_prepare(ctx)) return 0;
+
+    ctx->done = done;
+    ctx->done_arg = arg;
+    return os_ping_submit(ctx->ping_ctx, ping_async_done, ctx);
+}
+
 static int ping_get_stats(void *context, datasource_stats_t *stats) {
     ping_context_t *ctx = (ping_context_t *)context;
     if (!ctx || !stats) return 0;
@@ -181,7 +221,7 @@ static int ping_get_stats(void *context, datasource_stats_t *stats) {
 
     stats->min = ctx->min;
     stats->max = ctx->max;
-    stats->avg = (double)(ctx->sum / ctx->sample_count);
+    stats->avg = ctx->sum / ctx->sample_count;
     stats->last = ctx->last;
 
     if (ctx->jitter_count == 0) {
@@ -231,5 +271,6 @@ datasource_handler_t ping_handler = {
     "ping",
     "ms",
     1,
-    0.0
+    0.0,
+    ping_collect_async
 };
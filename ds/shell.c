@@ -19,7 +19,7 @@ typedef struct {
     FILE *fp;
     double min;
     double max;
-    uint64_t sum;
+    double sum;
     uint32_t sample_count;
     double last;
     int32_t refresh_interval_ms;
@@ -67,7 +67,7 @@ static int shell_init(const char *target, void **context) {
 
     ctx->min = 1000000.0;
     ctx->max = 0.0;
-    ctx->sum = 0;
+    ctx->sum = 0.0;
     ctx->sample_count = 0;
     ctx->last = 0.0;
     ctx->refresh_interval_ms = 0;
@@ -183,7 +183,7 @@ static int shell_collect(void *context, double *value) {
     if (got_value) {
         if (*value < ctx->min) ctx->min = *value;
         if (*value > ctx->max) ctx->max = *value;
-        ctx->sum += (uint64_t)*value;
+        ctx->sum += *value;
         ctx->last = *value;
         ctx->sample_count++;
         clearerr(ctx->fp);
@@ -211,7 +211,7 @@ static int shell_get_stats(void *context, datasource_stats_t *stats) {
 
     stats->min = ctx->min;
     stats->max = ctx->max;
-    stats->avg = (double)(ctx->sum / ctx->sample_count);
+    stats->avg = ctx->sum / ctx->sample_count;
     stats->last = ctx->last;
     stats->min_secondary = 0.0;
     stats->max_secondary = 0.0;
@@ -1,44 +1,334 @@
 #ifdef __VMS
 #include "datasource.h"
+#include "os/os_interface.h"
 #else
 #include "../datasource.h"
+#include "../os/os_interface.h"
 #endif
 #include "snmp_client.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
-#include <time.h>
 
-typedef struct {
+/* Varbinds per GetRequest when an agent is polled for several plots */
+#define SNMP_MAX_GET_VARBINDS 32
+/* Rows per GetBulk; Counter64 rows of two columns still fit one datagram */
+#define SNMP_BULK_MAX_ROWS 24
+#define SNMP_DEFAULT_INTERVAL_MS 1000
+
+struct snmp_agent_s;
+
+typedef struct snmp_context_s {
     char *hostname;
     char *community;
     int interface_index;
-    uint32_t prev_in_octets;
-    uint32_t prev_out_octets;
-    time_t prev_time;
+    int version;
+    struct snmp_agent_s *agent;
+    struct snmp_context_s *agent_next;
+    int32_t refresh_interval_ms;
+    /* Latest counters fanned out by the agent poll, under agent->mutex */
+    snmp_varbind_t cur[2];
+    uint32_t cur_seq;
+    uint32_t seen_seq;
+    uint32_t prev_in_hi;
+    uint32_t prev_in_lo;
+    uint32_t prev_out_hi;
+    uint32_t prev_out_lo;
+    uint32_t prev_time_ms;
     int first_sample;
-    uint32_t last_in_rate;
-    uint32_t last_out_rate;
-    uint32_t last_rate;
-    uint32_t min_in_rate;
-    uint32_t max_in_rate;
-    uint32_t min_out_rate;
-    uint32_t max_out_rate;
-    uint32_t min_combined_rate;
-    uint32_t max_combined_rate;
-    uint64_t sum_in_rate;
-    uint64_t sum_out_rate;
-    uint64_t sum_combined_rate;
+    double last_in_rate;
+    double last_out_rate;
+    double last_rate;
+    double min_in_rate;
+    double max_in_rate;
+    double min_out_rate;
+    double max_out_rate;
+    double min_combined_rate;
+    double max_combined_rate;
+    double sum_in_rate;
+    double sum_out_rate;
+    double sum_combined_rate;
     uint32_t sample_count;
 } snmp_context_t;
 
-static int getcntr32(const char *host, const char *community, int dir, int inst, uint32_t *result) {
-    uint32_t iftable_oid[] = { 1,3,6,1,2,1,2,2,1,0,0 };
+/* All plots of one host+community+version share an agent: one session and
+ * one poll per tick, whose counters are fanned out to every member. */
+typedef struct snmp_agent_s {
+    char *hostname;
+    char *community;
+    int version;
+    snmp_session_t *session;
+    plot_mutex_t *mutex;        /* members, counters and poll state */
+    plot_mutex_t *poll_lock;    /* held by the poller across the network round trip */
+    snmp_context_t *members;
+    int refcount;
+    int polling;                /* a poll is in flight, under mutex */
+    uint32_t poll_seq;
+    uint32_t poll_ms;           /* when the last poll finished */
+    struct snmp_agent_s *next;
+} snmp_agent_t;
+
+/* Plots are created and destroyed from the main thread */
+static snmp_agent_t *snmp_agents = NULL;
+
+/* ifTable (v1, Counter32) and ifXTable (v2c, Counter64) octet columns */
+static const uint32_t iftable_oid[] = { 1,3,6,1,2,1,2,2,1 };
+static const uint32_t ifxtable_oid[] = { 1,3,6,1,2,1,31,1,1,1 };
+#define IF_IN_OCTETS 10
+#define IF_OUT_OCTETS 16
+#define IF_HC_IN_OCTETS 6
+#define IF_HC_OUT_OCTETS 10
+
+static void set_column_oid(snmp_varbind_t *vb, const uint32_t *table, int table_len,
+                           int column, uint32_t inst) {
+    memcpy(vb->oid, table, table_len * sizeof(uint32_t));
+    vb->oid[table_len] = column;
+    vb->oid[table_len + 1] = inst;
+    vb->oid_len = table_len + 2;
+}
+
+static int same_oid(const snmp_varbind_t *a, const snmp_varbind_t *b) {
+    return a->oid_len == b->oid_len &&
+           memcmp(a->oid, b->oid, a->oid_len * sizeof(uint32_t)) == 0;
+}
+
+/* Wrap-safe difference: Counter32 wraps at 2^32, Counter64 at 2^64 */
+static double counter_diff(const snmp_varbind_t *cur, uint32_t prev_hi, uint32_t prev_lo) {
+    uint32_t lo, hi;
+
+    lo = cur->value - prev_lo;
+    if (cur->type != ASN_COUNTER64) return (double)lo;
+    hi = cur->value_hi - prev_hi - (cur->value < prev_lo ? 1 : 0);
+    return (double)hi * 4294967296.0 + (double)lo;
+}
+
+static void member_oids(snmp_context_t *ctx, snmp_varbind_t *vbs) {
+    if (ctx->version == SNMP_VERSION_1) {
+        set_column_oid(&vbs[0], iftable_oid, 9, IF_IN_OCTETS, ctx->interface_index);
+        set_column_oid(&vbs[1], iftable_oid, 9, IF_OUT_OCTETS, ctx->interface_index);
+    } else {
+        set_column_oid(&vbs[0], ifxtable_oid, 10, IF_HC_IN_OCTETS, ctx->interface_index);
+        set_column_oid(&vbs[1], ifxtable_oid, 10, IF_HC_OUT_OCTETS, ctx->interface_index);
+    }
+}
+
+/* Hands a returned varbind to every member that asked for that OID */
+static void agent_fan_out(snmp_agent_t *agent, const snmp_varbind_t *vb) {
+    snmp_context_t *m;
+    int want, col;
+
+    want = (agent->version == SNMP_VERSION_1) ? ASN_COUNTER32 : ASN_COUNTER64;
+    if (vb->type != want) return;
+
+    for (m = agent->members; m; m = m->agent_next) {
+        for (col = 0; col < 2; col++) {
+            if (same_oid(&m->cur[col], vb)) {
+                m->cur[col].type = vb->type;
+                m->cur[col].value = vb->value;
+                m->cur[col].value_hi = vb->value_hi;
+            }
+        }
+    }
+}
+
+/* Asks for every varbind in GetRequests of up to SNMP_MAX_GET_VARBINDS;
+ * those the agent could not answer are left without a type. v1 fails a
+ * whole request over one unknown OID, so the varbind its error-index
+ * blames is moved to the end of the chunk and the rest asked again. */
+static void agent_poll_get(snmp_agent_t *agent, snmp_varbind_t *vbs, int count) {
+    snmp_varbind_t swap;
+    int n, ask, bad, i, j;
+
+    for (i = 0; i < count; i += n) {
+        n = count - i;
+        if (n > SNMP_MAX_GET_VARBINDS) n = SNMP_MAX_GET_VARBINDS;
+        for (ask = n; ask > 0 && !snmp_session_get(agent->session, &vbs[i], ask, &bad); ask--) {
+            if (bad < 1 || bad > ask) {
+                for (j = 0; j < ask; j++) vbs[i + j].type = 0;
+                break;
+            }
+            swap = vbs[i + bad - 1];
+            vbs[i + bad - 1] = vbs[i + ask - 1];
+            vbs[i + ask - 1] = swap;
+            vbs[i + ask - 1].type = 0;
+        }
+    }
+}
+
+/* v2c with closely packed indexes: one GetBulk walks the whole range.
+ * Returns the rows stored, 0 when the range does not suit or it failed. */
+static int agent_poll_bulk(snmp_agent_t *agent, int lo, int hi, int members, snmp_varbind_t *rows) {
+    snmp_varbind_t start[2];
+    int n;
+
+    if (lo < 1 || hi - lo + 1 > SNMP_BULK_MAX_ROWS || hi - lo + 1 > members * 2) return 0;
+
+    set_column_oid(&start[0], ifxtable_oid, 10, IF_HC_IN_OCTETS, lo - 1);
+    set_column_oid(&start[1], ifxtable_oid, 10, IF_HC_OUT_OCTETS, lo - 1);
+    n = snmp_session_bulk(agent->session, start, 2, hi - lo + 1, rows, SNMP_BULK_MAX_ROWS * 2);
+    return (n > 0) ? n : 0;
+}
+
+/* Copies the GetBulk rows into the matching varbinds and moves those the
+ * rows left out, e.g. when the agent cut its reply short, to the front.
+ * Returns how many were left out. */
+static int agent_take_rows(snmp_varbind_t *vbs, int count, const snmp_varbind_t *rows, int row_count) {
+    snmp_varbind_t swap;
+    int missing, i, j;
+
+    missing = 0;
+    for (i = 0; i < count; i++) {
+        vbs[i].type = 0;
+        for (j = 0; j < row_count; j++) {
+            if (rows[j].type == ASN_COUNTER64 && same_oid(&rows[j], &vbs[i])) {
+                vbs[i].type = rows[j].type;
+                vbs[i].value = rows[j].value;
+                vbs[i].value_hi = rows[j].value_hi;
+                break;
+            }
+        }
+        if (vbs[i].type) continue;
+        swap = vbs[missing];
+        vbs[missing] = vbs[i];
+        vbs[i] = swap;
+        missing++;
+    }
+    return missing;
+}
+
+/* Polls for every member at once. Called with agent->mutex held, which is
+ * dropped for the network round trip: the OIDs are copied out first and
+ * the answers fanned out after, while siblings wait on poll_lock. Returns
+ * with agent->mutex held again. */
+static void agent_poll(snmp_agent_t *agent) {
+    snmp_varbind_t rows[SNMP_BULK_MAX_ROWS * 2];
+    snmp_varbind_t *vbs;
+    snmp_context_t *m;
+    int members, lo, hi, n, i, rest;
+
+    members = 0;
+    lo = agent->members ? agent->members->interface_index : 0;
+    hi = lo;
+    for (m = agent->members; m; m = m->agent_next) {
+        if (m->interface_index < lo) lo = m->interface_index;
+        if (m->interface_index > hi) hi = m->interface_index;
+        members++;
+    }
+
+    vbs = (members > 0) ? calloc((size_t)members * 2, sizeof(snmp_varbind_t)) : NULL;
+    n = 0;
+    if (vbs) {
+        for (m = agent->members; m; m = m->agent_next) {
+            member_oids(m, &vbs[n]);
+            n += 2;
+        }
+    }
+
+    agent->polling = 1;
+    os_plot_mutex_lock(agent->poll_lock);
+    os_plot_mutex_unlock(agent->mutex);
+
+    if (n > 0) {
+        i = 0;
+        if (members > 1 && agent->version == SNMP_VERSION_2C) {
+            i = agent_poll_bulk(agent, lo, hi, members, rows);
+        }
+        /* whatever the walk did not bring back is asked for directly */
+        rest = (i > 0) ? agent_take_rows(vbs, n, rows, i) : n;
+        if (rest > 0) agent_poll_get(agent, vbs, rest);
+    }
+
+    os_plot_mutex_lock(agent->mutex);
+    for (m = agent->members; m; m = m->agent_next) {
+        member_oids(m, m->cur);
+        m->cur[0].type = 0;
+        m->cur[1].type = 0;
+    }
+    for (i = 0; i < n; i++) agent_fan_out(agent, &vbs[i]);
+
+    /* stamped after the round trip, so a poll that timed out is still
+     * fresh for the siblings that waited on it */
+    agent->poll_ms = os_get_time_ms();
+    agent->poll_seq++;
+    for (m = agent->members; m; m = m->agent_next) {
+        if (m->cur[0].type && m->cur[1].type) m->cur_seq = agent->poll_seq;
+    }
+
+    agent->polling = 0;
+    os_plot_mutex_unlock(agent->poll_lock);
+    free(vbs);
+}
+
+/* A poll is reused by the other members within half of the shortest
+ * member interval, so plots that fire on the same tick share it. */
+static uint32_t agent_window_ms(snmp_agent_t *agent) {
+    snmp_context_t *m;
+    int32_t shortest;
+
+    shortest = 0;
+    for (m = agent->members; m; m = m->agent_next) {
+        if (shortest == 0 || (m->refresh_interval_ms > 0 && m->refresh_interval_ms < shortest)) {
+            shortest = m->refresh_interval_ms;
+        }
+    }
+    if (shortest <= 0) shortest = SNMP_DEFAULT_INTERVAL_MS;
+    return (uint32_t)shortest / 2;
+}
+
+static snmp_agent_t *agent_acquire(const char *hostname, const char *community, int version) {
+    snmp_agent_t *agent;
+
+    for (agent = snmp_agents; agent; agent = agent->next) {
+        if (agent->version == version && strcmp(agent->hostname, hostname) == 0 &&
+            strcmp(agent->community, community) == 0) {
+            agent->refcount++;
+            return agent;
+        }
+    }
 
-    iftable_oid[9] = dir;
-    iftable_oid[10] = inst;
+    agent = calloc(1, sizeof(snmp_agent_t));
+    if (!agent) return NULL;
+
+    agent->hostname = strdup(hostname);
+    agent->community = strdup(community);
+    agent->version = version;
+    agent->session = snmp_session_create(hostname, community, version);
+    agent->mutex = os_plot_mutex_create();
+    agent->poll_lock = os_plot_mutex_create();
+    if (!agent->hostname || !agent->community || !agent->session || !agent->mutex || !agent->poll_lock) {
+        snmp_session_destroy(agent->session);
+        if (agent->mutex) os_plot_mutex_destroy(agent->mutex);
+        if (agent->poll_lock) os_plot_mutex_destroy(agent->poll_lock);
+        free(agent->hostname);
+        free(agent->community);
+        free(agent);
+        return NULL;
+    }
 
-    return snmp_get_counter32(host, community, iftable_oid, 11, result);
+    agent->refcount = 1;
+    agent->next = snmp_agents;
+    snmp_agents = agent;
+    return agent;
+}
+
+static void agent_release(snmp_agent_t *agent) {
+    snmp_agent_t **pp;
+
+    if (--agent->refcount > 0) return;
+
+    for (pp = &snmp_agents; *pp; pp = &(*pp)->next) {
+        if (*pp == agent) {
+            *pp = agent->next;
+            break;
+        }
+    }
+
+    snmp_session_destroy(agent->session);
+    os_plot_mutex_destroy(agent->mutex);
+    os_plot_mutex_destroy(agent->poll_lock);
+    free(agent->hostname);
+    free(agent->community);
+    free(agent);
 }
 
 static void format_rate_human_readable(double disp_bytes_per_sec, char* buffer, size_t buffer_size) {
@@ -79,7 +369,7 @@ static int parse_snmp_target(const char* target, char** hostname, char** communi
     return (*hostname && *community);
 }
 
-static int snmp_init(const char *target, void **context) {
+static int snmp_init_version(const char *target, void **context, int version) {
     snmp_context_t *ctx;
 
     if (!target) return 0;
@@ -92,71 +382,116 @@ static int snmp_init(const char *target, void **context) {
         return 0;
     }
 
-    ctx->prev_in_octets = 0;
-    ctx->prev_out_octets = 0;
-    ctx->prev_time = 0;
+    ctx->version = version;
+    ctx->agent = agent_acquire(ctx->hostname, ctx->community, version);
+    if (!ctx->agent) {
+        free(ctx->hostname);
+        free(ctx->community);
+        free(ctx);
+        return 0;
+    }
+
+    ctx->refresh_interval_ms = 0;
+    memset(ctx->cur, 0, sizeof(ctx->cur));
+    ctx->cur_seq = 0;
+    ctx->seen_seq = 0;
+
+    ctx->prev_in_hi = 0;
+    ctx->prev_in_lo = 0;
+    ctx->prev_out_hi = 0;
+    ctx->prev_out_lo = 0;
+    ctx->prev_time_ms = 0;
     ctx->first_sample = 1;
-    ctx->last_in_rate = 0;
-    ctx->last_out_rate = 0;
-    ctx->last_rate = 0;
-    ctx->min_in_rate = UINT32_MAX;
-    ctx->max_in_rate = 0;
-    ctx->min_out_rate = UINT32_MAX;
-    ctx->max_out_rate = 0;
-    ctx->min_combined_rate = UINT32_MAX;
-    ctx->max_combined_rate = 0;
-    ctx->sum_in_rate = 0;
-    ctx->sum_out_rate = 0;
-    ctx->sum_combined_rate = 0;
+    ctx->last_in_rate = 0.0;
+    ctx->last_out_rate = 0.0;
+    ctx->last_rate = 0.0;
+    ctx->min_in_rate = -1.0;
+    ctx->max_in_rate = 0.0;
+    ctx->min_out_rate = -1.0;
+    ctx->max_out_rate = 0.0;
+    ctx->min_combined_rate = -1.0;
+    ctx->max_combined_rate = 0.0;
+    ctx->sum_in_rate = 0.0;
+    ctx->sum_out_rate = 0.0;
+    ctx->sum_combined_rate = 0.0;
     ctx->sample_count = 0;
 
+    os_plot_mutex_lock(ctx->agent->mutex);
+    ctx->agent_next = ctx->agent->members;
+    ctx->agent->members = ctx;
+    os_plot_mutex_unlock(ctx->agent->mutex);
+
     *context = ctx;
     return 1;
 }
 
-static int snmp_collect_internal(snmp_context_t *ctx) {
-    uint32_t in_octets, out_octets;
-    time_t current_time;
-    time_t time_diff;
-    uint32_t in_diff, out_diff;
-    uint32_t in_rate_bps, out_rate_bps, combined_rate_bps;
-
-    current_time = time(NULL);
+static int snmp_init(const char *target, void **context) {
+    return snmp_init_version(target, context, SNMP_VERSION_1);
+}
 
-    if (!getcntr32(ctx->hostname, ctx->community, 10, ctx->interface_index, &in_octets))
-        return 0;
+static int snmp2c_init(const char *target, void **context) {
+    return snmp_init_version(target, context, SNMP_VERSION_2C);
+}
 
-    if (!getcntr32(ctx->hostname, ctx->community, 16, ctx->interface_index, &out_octets))
+static int snmp_collect_internal(snmp_context_t *ctx) {
+    snmp_agent_t *agent;
+    snmp_varbind_t vbs[2];
+    int ok;
+    uint32_t current_time;
+    uint32_t time_diff;
+    double in_rate_bps, out_rate_bps, combined_rate_bps;
+
+    agent = ctx->agent;
+    os_plot_mutex_lock(agent->mutex);
+    if (agent->polling) {
+        /* a sibling is polling: wait for it and take its result, even a
+         * failed one, rather than timing out again in turn */
+        os_plot_mutex_unlock(agent->mutex);
+        os_plot_mutex_lock(agent->poll_lock);
+        os_plot_mutex_unlock(agent->poll_lock);
+        os_plot_mutex_lock(agent->mutex);
+    } else if (agent->poll_seq == 0 || ctx->seen_seq == agent->poll_seq ||
+               os_get_time_ms() - agent->poll_ms >= agent_window_ms(agent)) {
+        /* reuse a sibling's poll unless it is stale or we already consumed it */
+        agent_poll(agent);
+    }
+    ctx->seen_seq = agent->poll_seq;
+    ok = (ctx->cur_seq == agent->poll_seq);
+    vbs[0] = ctx->cur[0];
+    vbs[1] = ctx->cur[1];
+    current_time = agent->poll_ms;
+    os_plot_mutex_unlock(agent->mutex);
+
+    if (!ok)
         return 0;
 
     if (ctx->first_sample) {
-        ctx->prev_in_octets = in_octets;
-        ctx->prev_out_octets = out_octets;
-        ctx->prev_time = current_time;
+        ctx->prev_in_hi = vbs[0].value_hi;
+        ctx->prev_in_lo = vbs[0].value;
+        ctx->prev_out_hi = vbs[1].value_hi;
+        ctx->prev_out_lo = vbs[1].value;
+        ctx->prev_time_ms = current_time;
         ctx->first_sample = 0;
-        ctx->last_in_rate = 0;
-        ctx->last_out_rate = 0;
-        ctx->last_rate = 0;
+        ctx->last_in_rate = 0.0;
+        ctx->last_out_rate = 0.0;
+        ctx->last_rate = 0.0;
         return 1;
     }
 
-    time_diff = current_time - ctx->prev_time;
-    if (time_diff <= 0) {
+    time_diff = current_time - ctx->prev_time_ms;
+    if (time_diff == 0) {
         return 1;
     }
 
-    in_diff = in_octets - ctx->prev_in_octets;
-    out_diff = out_octets - ctx->prev_out_octets;
-
-    in_rate_bps = in_diff / (uint32_t)time_diff;
-    out_rate_bps = out_diff / (uint32_t)time_diff;
+    in_rate_bps = counter_diff(&vbs[0], ctx->prev_in_hi, ctx->prev_in_lo) * 1000.0 / time_diff;
+    out_rate_bps = counter_diff(&vbs[1], ctx->prev_out_hi, ctx->prev_out_lo) * 1000.0 / time_diff;
     combined_rate_bps = in_rate_bps + out_rate_bps;
 
-    if (in_rate_bps < ctx->min_in_rate) ctx->min_in_rate = in_rate_bps;
+    if (ctx->min_in_rate < 0.0 || in_rate_bps < ctx->min_in_rate) ctx->min_in_rate = in_rate_bps;
     if (in_rate_bps > ctx->max_in_rate) ctx->max_in_rate = in_rate_bps;
-    if (out_rate_bps < ctx->min_out_rate) ctx->min_out_rate = out_rate_bps;
+    if (ctx->min_out_rate < 0.0 || out_rate_bps < ctx->min_out_rate) ctx->min_out_rate = out_rate_bps;
     if (out_rate_bps > ctx->max_out_rate) ctx->max_out_rate = out_rate_bps;
-    if (combined_rate_bps < ctx->min_combined_rate) ctx->min_combined_rate = combined_rate_bps;
+    if (ctx->min_combined_rate < 0.0 || combined_rate_bps < ctx->min_combined_rate) ctx->min_combined_rate = combined_rate_bps;
     if (combined_rate_bps > ctx->max_combined_rate) ctx->max_combined_rate = combined_rate_bps;
 
     ctx->sum_in_rate += in_rate_bps;
@@ -164,9 +499,11 @@ static int snmp_collect_internal(snmp_context_t *ctx) {
     ctx->sum_combined_rate += combined_rate_bps;
     ctx->sample_count++;
 
-    ctx->prev_in_octets = in_octets;
-    ctx->prev_out_octets = out_octets;
-    ctx->prev_time = current_time;
+    ctx->prev_in_hi = vbs[0].value_hi;
+    ctx->prev_in_lo = vbs[0].value;
+    ctx->prev_out_hi = vbs[1].value_hi;
+    ctx->prev_out_lo = vbs[1].value;
+    ctx->prev_time_ms = current_time;
     ctx->last_in_rate = in_rate_bps;
     ctx->last_out_rate = out_rate_bps;
     ctx->last_rate = combined_rate_bps;
@@ -183,7 +520,7 @@ static int snmp_collect(void *context, double *disp_value) {
         return 0;
     }
 
-    *disp_value = (double)ctx->last_rate;
+    *disp_value = ctx->last_rate;
     return 1;
 }
 
@@ -197,8 +534,8 @@ static int snmp_collect_dual(void *context, double *disp_in_value, double *disp_
         return 0;
     }
 
-    *disp_in_value = (double)ctx->last_in_rate;
-    *disp_out_value = (double)ctx->last_out_rate;
+    *disp_in_value = ctx->last_in_rate;
+    *disp_out_value = ctx->last_out_rate;
     return 1;
 }
 
@@ -218,28 +555,48 @@ static int snmp_get_stats(void *context, datasource_stats_t *stats) {
         return 1;
     }
 
-    // Convert from uint32_t to double for display
-    stats->min = (double)ctx->min_in_rate;
-    stats->max = (double)ctx->max_in_rate;
-    stats->avg = (double)(ctx->sum_in_rate / ctx->sample_count);
-    stats->last = (double)ctx->last_in_rate;
-    stats->min_secondary = (double)ctx->min_out_rate;
-    stats->max_secondary = (double)ctx->max_out_rate;
-    stats->avg_secondary = (double)(ctx->sum_out_rate / ctx->sample_count);
-    stats->last_secondary = (double)ctx->last_out_rate;
+    stats->min = ctx->min_in_rate;
+    stats->max = ctx->max_in_rate;
+    stats->avg = ctx->sum_in_rate / ctx->sample_count;
+    stats->last = ctx->last_in_rate;
+    stats->min_secondary = ctx->min_out_rate;
+    stats->max_secondary = ctx->max_out_rate;
+    stats->avg_secondary = ctx->sum_out_rate / ctx->sample_count;
+    stats->last_secondary = ctx->last_out_rate;
 
     return 1;
 }
 
 static void snmp_cleanup(void *context) {
     snmp_context_t *ctx = (snmp_context_t *)context;
+    snmp_context_t **pp;
+
     if (!ctx) return;
 
+    os_plot_mutex_lock(ctx->agent->mutex);
+    for (pp = &ctx->agent->members; *pp; pp = &(*pp)->agent_next) {
+        if (*pp == ctx) {
+            *pp = ctx->agent_next;
+            break;
+        }
+    }
+    os_plot_mutex_unlock(ctx->agent->mutex);
+    agent_release(ctx->agent);
+
     free(ctx->hostname);
     free(ctx->community);
     free(ctx);
 }
 
+void snmp_set_refresh_interval(void *context, int32_t refresh_interval_ms) {
+    snmp_context_t *ctx = (snmp_context_t *)context;
+    if (!ctx) return;
+
+    os_plot_mutex_lock(ctx->agent->mutex);
+    ctx->refresh_interval_ms = refresh_interval_ms;
+    os_plot_mutex_unlock(ctx->agent->mutex);
+}
+
 static void snmp_format_value(double value, char *buffer, size_t buffer_size) {
     format_rate_human_readable(value, buffer, buffer_size);
 }
@@ -264,5 +621,22 @@ datasource_handler_t snmp_handler = {
     "snmp",
     "B/s",
     1,
-    0.0
+    0.0,
+    NULL
+};
+
+datasource_handler_t snmp2c_handler = {
+    snmp2c_init,
+    snmp_collect,
+    snmp_collect_dual,
+    snmp_get_stats,
+    snmp_format_value,
+    snmp_format_dual_stats,
+    NULL,
+    snmp_cleanup,
+    "snmp2c",
+    "B/s",
+    1,
+    0.0,
+    NULL
 };
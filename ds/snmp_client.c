@@ -1,4 +1,5 @@
 #include "snmp_client.h"
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 #ifdef _WIN32
@@ -26,12 +27,28 @@ typedef int socklen_t;
 #endif
 
 #define ASN_SEQUENCE 0x30
-#define ASN_INTEGER 0x02
 #define ASN_OCTET_STRING 0x04
 #define ASN_NULL 0x05
 #define ASN_OID 0x06
-#define ASN_COUNTER32 0x41
 #define SNMP_GET 0xA0
+#define SNMP_RESPONSE 0xA2
+#define SNMP_GETBULK 0xA5
+
+#define SNMP_TIMEOUT_SEC 5
+#define SNMP_RESOLVE_RETRY_SEC 30
+/* late replies to timed-out requests are discarded by req_id */
+#define SNMP_MAX_STALE 8
+
+struct snmp_session_s {
+    char *host;
+    char *community;
+    int version;
+    int sock;
+    struct sockaddr_in addr;
+    int resolved;
+    time_t last_resolve;
+    uint32_t req_id;
+};
 
 static int encode_length(unsigned char *buf, int len) {
     if (len < 128) {
@@ -175,200 +192,347 @@ static int decode_length(const unsigned char *buf, int *len_size) {
     return 0;
 }
 
-static int decode_counter32(const unsigned char *buf, int len, uint32_t *result) {
-    uint32_t val;
-    int i;
+static int wrap_tlv(unsigned char *buf, unsigned char tag, const unsigned char *data, int len) {
+    int hlen;
 
-    val = 0;
-    for (i = 0; i < len; i++) {
-        val = (val << 8) | buf[i];
-    }
-    *result = val;
-    return 1;
+    buf[0] = tag;
+    hlen = encode_length(buf + 1, len);
+    memmove(buf + 1 + hlen, data, len);
+    return 1 + hlen + len;
 }
 
-static int build_get_request(unsigned char *buf, const char *community,
-                              const uint32_t *oid, int oid_len, uint32_t req_id) {
+/* For GetBulk, arg1/arg2 are non-repeaters and max-repetitions; for the
+ * other PDUs they are the zero error-status and error-index. */
+static int build_request(unsigned char *buf, int version, const char *community,
+                         unsigned char pdu_type, uint32_t req_id, uint32_t arg1, uint32_t arg2,
+                         const snmp_varbind_t *vbs, int count) {
     unsigned char varbind[128];
-    unsigned char varbind_seq[256];
-    unsigned char varbind_list[256];
-    unsigned char pdu_data[512];
-    unsigned char pdu[512];
-    unsigned char message[1024];
-    int pos, len, hlen;
-
-    pos = 0;
-    pos += encode_oid(varbind + pos, oid, oid_len);
-    pos += encode_null(varbind + pos);
-    len = pos;
+    unsigned char list[SNMP_MAX_MSG_SIZE];
+    unsigned char pdu[SNMP_MAX_MSG_SIZE * 2];
+    unsigned char message[SNMP_MAX_MSG_SIZE * 2];
+    int i, pos, len;
 
-    varbind_seq[0] = ASN_SEQUENCE;
-    hlen = encode_length(varbind_seq + 1, len);
-    memcpy(varbind_seq + 1 + hlen, varbind, len);
-    len = 1 + hlen + len;
+    if (strlen(community) > 255) return 0;
 
-    varbind_list[0] = ASN_SEQUENCE;
-    hlen = encode_length(varbind_list + 1, len);
-    memcpy(varbind_list + 1 + hlen, varbind_seq, len);
-    len = 1 + hlen + len;
+    pos = 0;
+    for (i = 0; i < count; i++) {
+        len = encode_oid(varbind, vbs[i].oid, vbs[i].oid_len);
+        len += encode_null(varbind + len);
+        if (pos + len + 4 > (int)sizeof(list)) return 0;
+        pos += wrap_tlv(list + pos, ASN_SEQUENCE, varbind, len);
+    }
+    len = wrap_tlv(message, ASN_SEQUENCE, list, pos);
 
     pos = 0;
-    pos += encode_integer(pdu_data + pos, req_id);
-    pos += encode_integer(pdu_data + pos, 0);
-    pos += encode_integer(pdu_data + pos, 0);
-    memcpy(pdu_data + pos, varbind_list, len);
+    pos += encode_integer(pdu + pos, req_id);
+    pos += encode_integer(pdu + pos, arg1);
+    pos += encode_integer(pdu + pos, arg2);
+    memcpy(pdu + pos, message, len);
     pos += len;
-    len = pos;
-
-    pdu[0] = SNMP_GET;
-    hlen = encode_length(pdu + 1, len);
-    memcpy(pdu + 1 + hlen, pdu_data, len);
-    len = 1 + hlen + len;
+    len = wrap_tlv(message, pdu_type, pdu, pos);
 
     pos = 0;
-    pos += encode_integer(message + pos, 0);
-    pos += encode_string(message + pos, community);
-    memcpy(message + pos, pdu, len);
+    pos += encode_integer(pdu + pos, version);
+    pos += encode_string(pdu + pos, community);
+    if (pos + len + 4 > SNMP_MAX_MSG_SIZE) return 0;
+    memcpy(pdu + pos, message, len);
     pos += len;
-    len = pos;
 
-    buf[0] = ASN_SEQUENCE;
-    hlen = encode_length(buf + 1, len);
-    memcpy(buf + 1 + hlen, message, len);
-    return 1 + hlen + len;
+    return wrap_tlv(buf, ASN_SEQUENCE, pdu, pos);
 }
 
-static int parse_get_response(const unsigned char *buf, int buf_len, uint32_t *result) {
-    const unsigned char *p;
-    int len;
+/* Reads one TLV header; returns the content or NULL if it overruns end */
+static const unsigned char *read_tlv(const unsigned char *p, const unsigned char *end,
+                                     int *tag, int *len) {
     int hlen;
+
+    if (end - p < 2) return NULL;
+    *tag = p[0];
+    *len = decode_length(p + 1, &hlen);
+    p += 1 + hlen;
+    if (*len < 0 || end - p < *len) return NULL;
+    return p;
+}
+
+static uint32_t decode_unsigned(const unsigned char *buf, int len) {
+    uint32_t val;
     int i;
-    int val_len;
-
-    p = buf;
-
-    if (p[0] != ASN_SEQUENCE) return 0;
-    p++;
-    len = decode_length(p, &hlen);
-    p += hlen;
-
-    if (p[0] != ASN_INTEGER) return 0;
-    p++;
-    len = decode_length(p, &hlen);
-    p += hlen + len;
-
-    if (p[0] != ASN_OCTET_STRING) return 0;
-    p++;
-    len = decode_length(p, &hlen);
-    p += hlen + len;
-
-    if (p[0] != 0xA2) return 0;
-    p++;
-    len = decode_length(p, &hlen);
-    p += hlen;
-
-    if (p[0] != ASN_INTEGER) return 0;
-    p++;
-    len = decode_length(p, &hlen);
-    p += hlen + len;
-
-    if (p[0] != ASN_INTEGER) return 0;
-    p++;
-    len = decode_length(p, &hlen);
-    p += hlen + len;
-
-    if (p[0] != ASN_INTEGER) return 0;
-    p++;
-    len = decode_length(p, &hlen);
-    p += hlen + len;
-
-    if (p[0] != ASN_SEQUENCE) return 0;
-    p++;
-    len = decode_length(p, &hlen);
-    p += hlen;
-
-    if (p[0] != ASN_SEQUENCE) return 0;
-    p++;
-    len = decode_length(p, &hlen);
-    p += hlen;
-
-    if (p[0] != ASN_OID) return 0;
-    p++;
-    len = decode_length(p, &hlen);
-    p += hlen + len;
-
-    if (p[0] != ASN_COUNTER32) return 0;
-    p++;
-    val_len = decode_length(p, &hlen);
-    p += hlen;
-
-    return decode_counter32(p, val_len, result);
+
+    val = 0;
+    for (i = 0; i < len; i++) {
+        val = (val << 8) | buf[i];
+    }
+    return val;
 }
 
-int snmp_get_counter32(const char *host, const char *community,
-                       const uint32_t *oid, int oid_len, uint32_t *result) {
-    int sock;
-    struct sockaddr_in addr;
-    struct sockaddr_in from;
-    socklen_t fromlen;
-    unsigned char req_buf[SNMP_MAX_MSG_SIZE];
-    unsigned char resp_buf[SNMP_MAX_MSG_SIZE];
-    int req_len;
-    int resp_len;
+static int decode_oid(const unsigned char *buf, int len, uint32_t *oid, int max_len) {
+    int i, n;
+    uint32_t val;
+
+    if (len < 1 || max_len < 2) return 0;
+    oid[0] = buf[0] / 40;
+    oid[1] = buf[0] % 40;
+    n = 2;
+
+    val = 0;
+    for (i = 1; i < len; i++) {
+        val = (val << 7) | (buf[i] & 0x7F);
+        if (!(buf[i] & 0x80)) {
+            if (n >= max_len) return 0;
+            oid[n++] = val;
+            val = 0;
+        }
+    }
+    return n;
+}
+
+static void decode_counter64(const unsigned char *buf, int len, uint32_t *hi, uint32_t *lo) {
+    int i;
+
+    *hi = 0;
+    *lo = 0;
+    for (i = 0; i < len; i++) {
+        *hi = (*hi << 8) | (*lo >> 24);
+        *lo = (*lo << 8) | buf[i];
+    }
+}
+
+/* Parses a Response into out[]. With match set, the reply must carry exactly
+ * the requested OIDs in order (Get); otherwise the returned OIDs are stored
+ * (GetBulk). Returns the varbind count, 0 on error, -1 if not our reply.
+ * An error-status reply sets *error_index to the varbind it blames. */
+static int parse_response(const unsigned char *buf, int buf_len, uint32_t req_id,
+                          snmp_varbind_t *out, int out_max, int match, int *error_index) {
+    const unsigned char *p, *end, *vb, *vb_end;
+    uint32_t oid[SNMP_MAX_OID_LEN];
+    uint32_t status;
+    int tag, len, oid_len, n;
+
+    end = buf + buf_len;
+
+    if (!(p = read_tlv(buf, end, &tag, &len)) || tag != ASN_SEQUENCE) return -1;
+    end = p + len;
+    if (!(p = read_tlv(p, end, &tag, &len)) || tag != ASN_INTEGER) return -1;
+    p += len;
+    if (!(p = read_tlv(p, end, &tag, &len)) || tag != ASN_OCTET_STRING) return -1;
+    p += len;
+    if (!(p = read_tlv(p, end, &tag, &len)) || tag != SNMP_RESPONSE) return -1;
+    end = p + len;
+
+    if (!(p = read_tlv(p, end, &tag, &len)) || tag != ASN_INTEGER) return -1;
+    if (decode_unsigned(p, len) != req_id) return -1;
+    p += len;
+    if (!(p = read_tlv(p, end, &tag, &len)) || tag != ASN_INTEGER) return 0;
+    status = decode_unsigned(p, len);
+    p += len;
+    if (!(p = read_tlv(p, end, &tag, &len)) || tag != ASN_INTEGER) return 0;
+    if (status != 0) {
+        *error_index = (int)decode_unsigned(p, len);
+        return 0;
+    }
+    p += len;
+
+    if (!(p = read_tlv(p, end, &tag, &len)) || tag != ASN_SEQUENCE) return 0;
+    end = p + len;
+
+    for (n = 0; n < out_max && p < end; n++) {
+        if (!(vb = read_tlv(p, end, &tag, &len)) || tag != ASN_SEQUENCE) return 0;
+        vb_end = vb + len;
+        p = vb_end;
+
+        if (!(vb = read_tlv(vb, vb_end, &tag, &len)) || tag != ASN_OID) return 0;
+        oid_len = decode_oid(vb, len, oid, SNMP_MAX_OID_LEN);
+        if (!oid_len) return 0;
+        if (match) {
+            if (oid_len != out[n].oid_len ||
+                memcmp(oid, out[n].oid, oid_len * sizeof(uint32_t)) != 0) return 0;
+        } else {
+            memcpy(out[n].oid, oid, oid_len * sizeof(uint32_t));
+            out[n].oid_len = oid_len;
+        }
+        vb += len;
+
+        if (!(vb = read_tlv(vb, vb_end, &tag, &len))) return 0;
+        out[n].type = tag;
+        out[n].value = 0;
+        out[n].value_hi = 0;
+        if (tag == ASN_COUNTER32 || tag == ASN_GAUGE32 || tag == ASN_TIMETICKS ||
+            tag == ASN_INTEGER) {
+            if (len > 5) return 0;
+            out[n].value = decode_unsigned(vb, len);
+        } else if (tag == ASN_COUNTER64) {
+            if (len > 9) return 0;
+            decode_counter64(vb, len, &out[n].value_hi, &out[n].value);
+        }
+    }
+
+    if (match && n != out_max) return 0;
+    return n;
+}
+
+static int session_resolve(snmp_session_t *s) {
     struct hostent *he;
     unsigned long addr_num;
-    uint32_t req_id;
+
+    memset(&s->addr, 0, sizeof(s->addr));
+    s->addr.sin_family = AF_INET;
+    s->addr.sin_port = htons(SNMP_PORT);
+    s->last_resolve = time(NULL);
+
+    /* numeric address first: gethostbyname can't parse dotted quads
+     * on systems without a resolver (e.g. VMS with BIND disabled) */
+    addr_num = inet_addr(s->host);
+    if (addr_num != INADDR_NONE) {
+        s->addr.sin_addr.s_addr = (uint32_t)addr_num;
+    } else {
+        he = gethostbyname(s->host);
+        if (!he) return 0;
+        memcpy(&s->addr.sin_addr, he->h_addr, he->h_length);
+    }
+    return 1;
+}
+
+static int session_open(snmp_session_t *s) {
 #ifdef _WIN32
     DWORD tv_ms;
 #else
     struct timeval tv;
 #endif
 
-    sock = socket(AF_INET, SOCK_DGRAM, 0);
-    if (sock < 0) return 0;
+    s->sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s->sock < 0) return 0;
 
 #ifdef _WIN32
-    tv_ms = 5000;
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&tv_ms, sizeof(tv_ms));
+    tv_ms = SNMP_TIMEOUT_SEC * 1000;
+    setsockopt(s->sock, SOL_SOCKET, SO_RCVTIMEO, (const char *)&tv_ms, sizeof(tv_ms));
 #else
-    tv.tv_sec = 5;
+    tv.tv_sec = SNMP_TIMEOUT_SEC;
     tv.tv_usec = 0;
-    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(s->sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
 #endif
+    return 1;
+}
 
-    memset(&addr, 0, sizeof(addr));
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(SNMP_PORT);
+snmp_session_t *snmp_session_create(const char *host, const char *community, int version) {
+    snmp_session_t *s;
+#ifdef _WIN32
+    WSADATA wsa;
 
-    /* numeric address first: gethostbyname can't parse dotted quads
-     * on systems without a resolver (e.g. VMS with BIND disabled) */
-    addr_num = inet_addr(host);
-    if (addr_num != INADDR_NONE) {
-        addr.sin_addr.s_addr = (uint32_t)addr_num;
-    } else {
-        he = gethostbyname(host);
-        if (!he) {
-            close(sock);
-            return 0;
+    WSAStartup(MAKEWORD(1, 1), &wsa);
+#endif
+
+    if (!host || !community) return NULL;
+
+    s = malloc(sizeof(snmp_session_t));
+    if (!s) return NULL;
+
+    s->host = malloc(strlen(host) + 1);
+    s->community = malloc(strlen(community) + 1);
+    if (!s->host || !s->community) {
+        free(s->host);
+        free(s->community);
+        free(s);
+        return NULL;
+    }
+    strcpy(s->host, host);
+    strcpy(s->community, community);
+
+    s->version = version;
+    s->sock = -1;
+    s->req_id = (uint32_t)time(NULL) & 0x3FFFFFFF;
+    s->resolved = session_resolve(s);
+    return s;
+}
+
+void snmp_session_destroy(snmp_session_t *s) {
+    if (!s) return;
+    if (s->sock >= 0) close(s->sock);
+    free(s->host);
+    free(s->community);
+    free(s);
+}
+
+/* A reply cut to the receive buffer claims more bytes than arrived */
+static int reply_truncated(const unsigned char *buf, int len) {
+    int hlen, content;
+
+    if (len < SNMP_MAX_MSG_SIZE || buf[0] != ASN_SEQUENCE) return 0;
+    content = decode_length(buf + 1, &hlen);
+    return 1 + hlen + content > len;
+}
+
+static int session_transact(snmp_session_t *s, unsigned char pdu_type, uint32_t arg1, uint32_t arg2,
+                            const snmp_varbind_t *req, int req_count,
+                            snmp_varbind_t *out, int out_max, int match, int *error_index) {
+    struct sockaddr_in from;
+    socklen_t fromlen;
+    unsigned char req_buf[SNMP_MAX_MSG_SIZE];
+    unsigned char resp_buf[SNMP_MAX_MSG_SIZE];
+    int req_len;
+    int resp_len;
+    int attempts;
+    int r;
+
+    *error_index = 0;
+
+    /* after a failure the name is looked up again, at most every 30s */
+    if (!s->resolved || s->sock < 0) {
+        if (time(NULL) - s->last_resolve >= SNMP_RESOLVE_RETRY_SEC) {
+            s->resolved = session_resolve(s);
         }
-        memcpy(&addr.sin_addr, he->h_addr, he->h_length);
+        if (!s->resolved) return 0;
     }
 
-    req_id = (uint32_t)time(NULL);
-    req_len = build_get_request(req_buf, community, oid, oid_len, req_id);
+    if (s->sock < 0 && !session_open(s)) return 0;
+
+    /* keep req_id positive: it is encoded as a signed INTEGER */
+    s->req_id = (s->req_id + 1) & 0x3FFFFFFF;
+    req_len = build_request(req_buf, s->version, s->community, pdu_type, s->req_id,
+                            arg1, arg2, req, req_count);
+    if (req_len <= 0) return 0;
 
-    if (sendto(sock, req_buf, req_len, 0, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        close(sock);
+    if (sendto(s->sock, req_buf, req_len, 0, (struct sockaddr *)&s->addr, sizeof(s->addr)) < 0) {
+        close(s->sock);
+        s->sock = -1;
         return 0;
     }
 
-    /* VMS recvfrom returns EINVAL for NULL from/fromlen */
-    fromlen = sizeof(from);
-    resp_len = recvfrom(sock, resp_buf, SNMP_MAX_MSG_SIZE, 0,
-                        (struct sockaddr *)&from, &fromlen);
-    close(sock);
+    for (attempts = 0; attempts < SNMP_MAX_STALE; attempts++) {
+        /* VMS recvfrom returns EINVAL for NULL from/fromlen */
+        fromlen = sizeof(from);
+        resp_len = recvfrom(s->sock, resp_buf, SNMP_MAX_MSG_SIZE, 0,
+                            (struct sockaddr *)&from, &fromlen);
+        if (resp_len <= 0) break;
+        if (from.sin_addr.s_addr != s->addr.sin_addr.s_addr) continue;
+        /* too big for the buffer: fail now rather than wait out the timeout */
+        if (reply_truncated(resp_buf, resp_len)) return 0;
+
+        r = parse_response(resp_buf, resp_len, s->req_id, out, out_max, match, error_index);
+        if (r >= 0) return r;
+    }
+
+    /* timed out: drop the socket so the next poll re-resolves and reopens */
+    close(s->sock);
+    s->sock = -1;
+    return 0;
+}
+
+int snmp_session_get(snmp_session_t *s, snmp_varbind_t *vbs, int count, int *error_index) {
+    int unused;
+
+    if (!error_index) error_index = &unused;
+    *error_index = 0;
+    if (!s || !vbs || count <= 0) return 0;
+
+    return session_transact(s, SNMP_GET, 0, 0, vbs, count, vbs, count, 1, error_index) == count;
+}
+
+int snmp_session_bulk(snmp_session_t *s, const snmp_varbind_t *start, int count,
+                      int max_rep, snmp_varbind_t *out, int out_max) {
+    int error_index;
 
-    if (resp_len <= 0) return 0;
+    if (!s || !start || !out || count <= 0 || max_rep <= 0) return 0;
+    if (s->version < SNMP_VERSION_2C) return 0;
 
-    return parse_get_response(resp_buf, resp_len, result);
+    return session_transact(s, SNMP_GETBULK, 0, max_rep, start, count, out, out_max, 0, &error_index);
 }
@@ -10,7 +10,41 @@
 #define SNMP_PORT 161
 #define SNMP_MAX_MSG_SIZE 1500
 
-int snmp_get_counter32(const char *host, const char *community,
-                       const uint32_t *oid, int oid_len, uint32_t *result);
+#define ASN_INTEGER 0x02
+#define ASN_COUNTER32 0x41
+#define ASN_GAUGE32 0x42
+#define ASN_TIMETICKS 0x43
+#define ASN_COUNTER64 0x46
+#define ASN_END_OF_MIB_VIEW 0x82
+
+#define SNMP_VERSION_1 0
+#define SNMP_VERSION_2C 1
+
+#define SNMP_MAX_OID_LEN 16
+
+/* Counter64 is split in two words: uint64_t is only 32 bits on VAX */
+typedef struct {
+    uint32_t oid[SNMP_MAX_OID_LEN];
+    int oid_len;
+    int type;           /* ASN.1 tag of the returned value */
+    uint32_t value;
+    uint32_t value_hi;
+} snmp_varbind_t;
+
+/* One agent: long-lived UDP socket and cached address */
+typedef struct snmp_session_s snmp_session_t;
+
+snmp_session_t *snmp_session_create(const char *host, const char *community, int version);
+void snmp_session_destroy(snmp_session_t *s);
+
+/* Single GetRequest carrying all varbinds; fills type/value in place. When
+ * the agent answers with an error, *error_index (may be NULL) is the
+ * 1-based varbind it blames, 0 if none or there was no answer. */
+int snmp_session_get(snmp_session_t *s, snmp_varbind_t *vbs, int count, int *error_index);
+
+/* v2c GetBulk: walks max_rep rows past each start OID, returned row-major
+ * into out[]. Returns the number of varbinds stored, 0 on failure. */
+int snmp_session_bulk(snmp_session_t *s, const snmp_varbind_t *start, int count,
+                      int max_rep, snmp_varbind_t *out, int out_max);
 
 #endif
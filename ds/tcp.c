@@ -1,7 +1,9 @@
 #ifdef __VMS
 #include "datasource.h"
+#include "os/os_interface.h"
 #else
 #include "../datasource.h"
+#include "../os/os_interface.h"
 #endif
 #include <stdlib.h>
 #include <string.h>
@@ -41,6 +43,14 @@ typedef int sock_t;
 #define ERR_INTR EINTR
 #endif
 
+/* Linux probes every target from one epoll set instead of a select() per call */
+#if defined(__linux__)
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#define TCP_HAVE_ENGINE
+#endif
+
 #ifndef INADDR_NONE
 #define INADDR_NONE 0xffffffff
 #endif
@@ -48,7 +58,7 @@ typedef int sock_t;
 #define TCP_TIMEOUT_MS 3000
 #define TCP_RESOLVE_RETRY_SEC 30
 
-typedef struct {
+typedef struct tcp_context_s {
     char *host;
     struct sockaddr_in dst;
     int resolved;
@@ -58,6 +68,16 @@ typedef struct {
     double sum;
     double last;
     uint32_t sample_count;
+#ifdef TCP_HAVE_ENGINE
+    /* Probe in flight, owned by the engine while fd >= 0 */
+    int fd;
+    uint64_t t0;
+    uint64_t deadline;
+    datasource_done_fn done;
+    void *done_arg;
+    struct tcp_context_s *prev;
+    struct tcp_context_s *next;
+#endif
 } tcp_context_t;
 
 static uint64_t tcp_now_us(void) {
@@ -122,6 +142,9 @@ static int tcp_init(const char *target, void **context) {
     ctx->dst.sin_family = AF_INET;
     ctx->dst.sin_port = htons((uint16_t)port);
     ctx->min = 10000.0;
+#ifdef TCP_HAVE_ENGINE
+    ctx->fd = -1;
+#endif
 
 #ifdef _WIN32
     WSAStartup(MAKEWORD(1, 1), &wsa);
@@ -134,13 +157,34 @@ static int tcp_init(const char *target, void **context) {
     return 1;
 }
 
+/* Retries a failed lookup every TCP_RESOLVE_RETRY_SEC */
+static int tcp_ready(tcp_context_t *ctx) {
+    time_t now;
+
+    if (!ctx->resolved) {
+        now = time(NULL);
+        if (now - ctx->last_retry < TCP_RESOLVE_RETRY_SEC) return 0;
+        ctx->last_retry = now;
+        ctx->resolved = tcp_resolve(ctx);
+        if (!ctx->resolved) return 0;
+    }
+    return 1;
+}
+
+static void tcp_record(tcp_context_t *ctx, double value) {
+    if (value < ctx->min) ctx->min = value;
+    if (value > ctx->max) ctx->max = value;
+    ctx->sum += value;
+    ctx->last = value;
+    ctx->sample_count++;
+}
+
 static int tcp_collect(void *context, double *value) {
     tcp_context_t *ctx;
     sock_t fd;
     fd_set wfds, efds;
     struct timeval tv;
     uint64_t t0, elapsed_us, timeout_us;
-    time_t now;
     int r, err;
     socklen_t elen;
 #ifdef _WIN32
@@ -151,13 +195,7 @@ static int tcp_collect(void *context, double *value) {
     if (!ctx || !value) return 0;
     *value = -1.0;
 
-    if (!ctx->resolved) {
-        now = time(NULL);
-        if (now - ctx->last_retry < TCP_RESOLVE_RETRY_SEC) return 0;
-        ctx->last_retry = now;
-        ctx->resolved = tcp_resolve(ctx);
-        if (!ctx->resolved) return 0;
-    }
+    if (!tcp_ready(ctx)) return 0;
 
     fd = socket(AF_INET, SOCK_STREAM, 0);
     if (fd == INVALID_SOCKET) return 0;
@@ -214,14 +252,225 @@ static int tcp_collect(void *context, double *value) {
     *value = (double)(tcp_now_us() - t0) / 1000.0;
     close(fd);
 
-    if (*value < ctx->min) ctx->min = *value;
-    if (*value > ctx->max) ctx->max = *value;
-    ctx->sum += *value;
-    ctx->last = *value;
-    ctx->sample_count++;
+    tcp_record(ctx, *value);
+    return 1;
+}
+
+#ifdef TCP_HAVE_ENGINE
+#define TCP_ENGINE_EVENTS 64
+
+typedef struct {
+    int epfd;
+    int wakefd;
+    int started;
+    plot_thread_t *thread;
+    tcp_context_t *head;    /* probes in flight, ordered by deadline */
+    tcp_context_t *tail;
+} tcp_engine_t;
+
+static tcp_engine_t tcp_engine;
+static pthread_mutex_t tcp_engine_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void tcp_probe_link(tcp_context_t *ctx) {
+    tcp_context_t *after;
+
+    after = tcp_engine.tail;
+    while (after && after->deadline > ctx->deadline) {
+        after = after->prev;
+    }
+
+    ctx->prev = after;
+    ctx->next = after ? after->next : tcp_engine.head;
+    if (ctx->next) ctx->next->prev = ctx;
+    else tcp_engine.tail = ctx;
+    if (after) after->next = ctx;
+    else tcp_engine.head = ctx;
+}
+
+static void tcp_probe_unlink(tcp_context_t *ctx) {
+    if (ctx->prev) ctx->prev->next = ctx->next;
+    else tcp_engine.head = ctx->next;
+    if (ctx->next) ctx->next->prev = ctx->prev;
+    else tcp_engine.tail = ctx->prev;
+    ctx->prev = NULL;
+    ctx->next = NULL;
+
+    epoll_ctl(tcp_engine.epfd, EPOLL_CTL_DEL, ctx->fd, NULL);
+    close(ctx->fd);
+    ctx->fd = -1;
+}
 
+/* Called with tcp_engine_lock held; drops it around the callback */
+static void tcp_probe_complete(tcp_context_t *ctx, int success, double value) {
+    datasource_done_fn done;
+    void *arg;
+
+    done = ctx->done;
+    arg = ctx->done_arg;
+    tcp_probe_unlink(ctx);
+    if (success) tcp_record(ctx, value);
+
+    pthread_mutex_unlock(&tcp_engine_lock);
+    done(arg, success, success ? value : -1.0, 0.0);
+    pthread_mutex_lock(&tcp_engine_lock);
+}
+
+static void tcp_engine_thread(void *arg) {
+    struct epoll_event events[TCP_ENGINE_EVENTS];
+    tcp_context_t *ctx;
+    uint64_t now, counter;
+    socklen_t elen;
+    int timeout_ms;
+    int n, i, err;
+
+    (void)arg;
+
+    pthread_mutex_lock(&tcp_engine_lock);
+    for (;;) {
+        now = tcp_now_us();
+        while (tcp_engine.head && tcp_engine.head->deadline <= now) {
+            tcp_probe_complete(tcp_engine.head, 0, -1.0);
+        }
+
+        timeout_ms = -1;
+        if (tcp_engine.head) {
+            timeout_ms = (int)((tcp_engine.head->deadline - now + 999) / 1000);
+        }
+        pthread_mutex_unlock(&tcp_engine_lock);
+
+        n = epoll_wait(tcp_engine.epfd, events, TCP_ENGINE_EVENTS, timeout_ms);
+        now = tcp_now_us();
+
+        pthread_mutex_lock(&tcp_engine_lock);
+        for (i = 0; i < n; i++) {
+            ctx = (tcp_context_t *)events[i].data.ptr;
+            if (!ctx) {
+                while (read(tcp_engine.wakefd, &counter, sizeof(counter)) > 0) {
+                }
+                continue;
+            }
+            /* expired or cancelled while we were waiting */
+            if (ctx->fd < 0) continue;
+
+            err = 0;
+            elen = sizeof(err);
+            if (getsockopt(ctx->fd, SOL_SOCKET, SO_ERROR, (char *)&err, &elen) < 0 || err != 0) {
+                tcp_probe_complete(ctx, 0, -1.0);
+            } else {
+                tcp_probe_complete(ctx, 1, (double)(now - ctx->t0) / 1000.0);
+            }
+        }
+    }
+}
+
+static int tcp_engine_start(void) {
+    struct epoll_event ev;
+
+    pthread_mutex_lock(&tcp_engine_lock);
+    if (tcp_engine.started) {
+        pthread_mutex_unlock(&tcp_engine_lock);
+        return 1;
+    }
+
+    tcp_engine.epfd = epoll_create(TCP_ENGINE_EVENTS);
+    if (tcp_engine.epfd < 0) {
+        pthread_mutex_unlock(&tcp_engine_lock);
+        return 0;
+    }
+
+    tcp_engine.wakefd = eventfd(0, EFD_NONBLOCK);
+    if (tcp_engine.wakefd < 0) {
+        close(tcp_engine.epfd);
+        pthread_mutex_unlock(&tcp_engine_lock);
+        return 0;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(tcp_engine.epfd, EPOLL_CTL_ADD, tcp_engine.wakefd, &ev);
+
+    tcp_engine.head = NULL;
+    tcp_engine.tail = NULL;
+    tcp_engine.thread = os_plot_thread_create(tcp_engine_thread, NULL);
+    if (!tcp_engine.thread) {
+        close(tcp_engine.wakefd);
+        close(tcp_engine.epfd);
+        pthread_mutex_unlock(&tcp_engine_lock);
+        return 0;
+    }
+
+    tcp_engine.started = 1;
+    pthread_mutex_unlock(&tcp_engine_lock);
+    return 1;
+}
+
+/* Starts the connect and hands it to the engine. The collector keeps at most
+ * one sample in flight per source, so the probe lives in the context. */
+static int tcp_collect_async(void *context, datasource_done_fn done, void *arg) {
+    tcp_context_t *ctx;
+    struct epoll_event ev;
+    uint64_t one;
+    double value;
+    int fd, r, wake;
+
+    ctx = (tcp_context_t *)context;
+    if (!ctx || !done) return 0;
+
+    if (!tcp_engine_start()) {
+        r = tcp_collect(ctx, &value);
+        done(arg, r, r ? value : -1.0, 0.0);
+        return 1;
+    }
+
+    if (!tcp_ready(ctx)) return 0;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) return 0;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+    ctx->t0 = tcp_now_us();
+    r = connect(fd, (struct sockaddr *)&ctx->dst, sizeof(ctx->dst));
+    if (r == 0) {
+        value = (double)(tcp_now_us() - ctx->t0) / 1000.0;
+        close(fd);
+        tcp_record(ctx, value);
+        done(arg, 1, value, 0.0);
+        return 1;
+    }
+    if (errno != EINPROGRESS) {
+        close(fd);
+        return 0;
+    }
+
+    pthread_mutex_lock(&tcp_engine_lock);
+    ctx->fd = fd;
+    ctx->deadline = ctx->t0 + (uint64_t)TCP_TIMEOUT_MS * 1000;
+    ctx->done = done;
+    ctx->done_arg = arg;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLOUT;
+    ev.data.ptr = ctx;
+    if (epoll_ctl(tcp_engine.epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        ctx->fd = -1;
+        pthread_mutex_unlock(&tcp_engine_lock);
+        close(fd);
+        return 0;
+    }
+    tcp_probe_link(ctx);
+
+    /* the engine only needs to re-arm its timeout if this is the earliest */
+    wake = (tcp_engine.head == ctx);
+    pthread_mutex_unlock(&tcp_engine_lock);
+
+    if (wake) {
+        one = 1;
+        write(tcp_engine.wakefd, &one, sizeof(one));
+    }
     return 1;
 }
+#endif
 
 static int tcp_get_stats(void *context, datasource_stats_t *stats) {
     tcp_context_t *ctx = (tcp_context_t *)context;
@@ -250,6 +499,11 @@ static int tcp_get_stats(void *context, datasource_stats_t *stats) {
 static void tcp_cleanup(void *context) {
     tcp_context_t *ctx = (tcp_context_t *)context;
     if (!ctx) return;
+#ifdef TCP_HAVE_ENGINE
+    pthread_mutex_lock(&tcp_engine_lock);
+    if (ctx->fd >= 0) tcp_probe_unlink(ctx);
+    pthread_mutex_unlock(&tcp_engine_lock);
+#endif
     free(ctx->host);
     free(ctx);
 }
@@ -270,5 +524,10 @@ datasource_handler_t tcp_handler = {
     "tcp",
     "ms",
     0,
-    0.0
+    0.0,
+#ifdef TCP_HAVE_ENGINE
+    tcp_collect_async
+#else
+    NULL
+#endif
 };
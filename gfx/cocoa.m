@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
+#include <unistd.h>
 
 #ifndef MAC_OS_X_VERSION_10_12
 #define MAC_OS_X_VERSION_10_12 101200
@@ -15,6 +16,7 @@
 #define NSWindowStyleMaskResizable NSResizableWindowMask
 #define NSEventMaskAny NSAnyEventMask
 #define NSCompositingOperationCopy NSCompositeCopy
+#define NSEventTypeApplicationDefined NSApplicationDefined
 #endif
 
 extern int config_get_max_fps(void);
@@ -27,6 +29,8 @@ static int32_t mouse_y = 0;
 static uint32_t frame_count = 0;
 static double fps_last_time = 0.0;
 static float current_fps = 0.0f;
+static volatile int wakeup_pending = 0;     /* an application event is queued */
+static double last_wait_time = 0.0;
 
 @interface SNGView : NSView {
     NSImage *backing;
@@ -399,6 +403,31 @@ void renderer_present(renderer_t *renderer) {
     [cr->cw->view displayIfNeeded];
 }
 
+int renderer_keeps_frame(renderer_t *renderer) {
+    (void)renderer;
+    return 1;
+}
+
+void renderer_present_rects(renderer_t *renderer, const rect_t *rects, uint32_t count) {
+    cocoa_renderer_t *cr;
+    uint32_t i;
+    if (!renderer) return;
+    cr = (cocoa_renderer_t *)renderer->handle;
+    if (cr->focused) {
+        flush_line_batch(cr);
+        [cr->image unlockFocus];
+        cr->cg_ctx = NULL;
+        cr->focused = 0;
+    }
+    /* the view is not flipped */
+    for (i = 0; i < count; i++) {
+        if (rects[i].w <= 0 || rects[i].h <= 0) continue;
+        [cr->cw->view setNeedsDisplayInRect:NSMakeRect(rects[i].x, cr->height - rects[i].y - rects[i].h,
+                                                       rects[i].w, rects[i].h)];
+    }
+    [cr->cw->view displayIfNeeded];
+}
+
 void renderer_set_color(renderer_t *renderer, color_t color) {
     cocoa_renderer_t *cr;
     if (!renderer) return;
@@ -454,6 +483,69 @@ void renderer_fill_rect(renderer_t *renderer, rect_t rect) {
                           (CGFloat)rect.w, (CGFloat)rect.h));
 }
 
+/* Lines join the segment batch stroked at the next flush */
+void renderer_draw_lines(renderer_t *renderer, const line_t *lines, uint32_t count) {
+    uint32_t i;
+    if (!renderer || !lines) return;
+    for (i = 0; i < count; i++) {
+        renderer_draw_line(renderer, lines[i].x1, lines[i].y1, lines[i].x2, lines[i].y2);
+    }
+}
+
+#define COCOA_RECT_BATCH 256
+
+void renderer_fill_rects(renderer_t *renderer, const rect_t *rects, uint32_t count) {
+    cocoa_renderer_t *cr;
+    NSRect ns_rects[COCOA_RECT_BATCH];
+    uint32_t i, n;
+    if (!renderer || !rects) return;
+    cr = (cocoa_renderer_t *)renderer->handle;
+    if (!cr->focused) begin_draw(cr);
+    flush_line_batch(cr);
+    while (count > 0) {
+        n = (count < COCOA_RECT_BATCH) ? count : COCOA_RECT_BATCH;
+        for (i = 0; i < n; i++) {
+            ns_rects[i] = NSMakeRect((CGFloat)rects[i].x,
+                                     (CGFloat)cr->height - (CGFloat)rects[i].y - (CGFloat)rects[i].h,
+                                     (CGFloat)rects[i].w, (CGFloat)rects[i].h);
+        }
+        NSRectFillList(ns_rects, (NSInteger)n);
+        rects += n;
+        count -= n;
+    }
+}
+
+/* Drawing goes straight into the view; plots draw directly */
+surface_t *surface_create(renderer_t *renderer, int32_t width, int32_t height) {
+    (void)renderer;
+    (void)width;
+    (void)height;
+    return NULL;
+}
+
+void surface_destroy(renderer_t *renderer, surface_t *surface) {
+    (void)renderer;
+    (void)surface;
+}
+
+void surface_scroll(renderer_t *renderer, surface_t *surface, int32_t dx) {
+    (void)renderer;
+    (void)surface;
+    (void)dx;
+}
+
+void renderer_set_target(renderer_t *renderer, surface_t *surface) {
+    (void)renderer;
+    (void)surface;
+}
+
+void renderer_draw_surface(renderer_t *renderer, surface_t *surface, int32_t x, int32_t y) {
+    (void)renderer;
+    (void)surface;
+    (void)x;
+    (void)y;
+}
+
 font_t *font_create(const char *path, int32_t size) {
     font_t *f;
     cocoa_font_t *cf;
@@ -569,26 +661,57 @@ int graphics_wait_events(void) {
     NSEvent *event;
     int fps;
     NSDate *until;
+    double interval, elapsed;
 
     fps = config_get_max_fps();
     if (fps <= 0) fps = 1;
+    interval = 1.0 / (double)fps;
 
     pool = [[NSAutoreleasePool alloc] init];
-    until = [NSDate dateWithTimeIntervalSinceNow:1.0 / (double)fps];
+
+    /* block until input, a graphics_wakeup() or the idle time */
+    until = [NSDate dateWithTimeIntervalSinceNow:GRAPHICS_IDLE_MS / 1000.0];
     event = [NSApp nextEventMatchingMask:NSEventMaskAny
                                untilDate:until
                                   inMode:NSDefaultRunLoopMode
                                  dequeue:YES];
-    if (event) {
-        [NSApp sendEvent:event];
-        pump_pending();
+    if (event) [NSApp sendEvent:event];
+
+    /* coalesce bursts of samples to max_fps */
+    elapsed = now_seconds() - last_wait_time;
+    if (elapsed >= 0.0 && elapsed < interval) {
+        usleep((useconds_t)((interval - elapsed) * 1e6));
     }
+    last_wait_time = now_seconds();
+    wakeup_pending = 0;
+
+    pump_pending();
     [pool release];
 
     if (pending_event.type == GRAPHICS_EVENT_QUIT) return 0;
     return 1;
 }
 
+void graphics_wakeup(void) {
+    NSAutoreleasePool *pool;
+    NSEvent *event;
+
+    if (!__sync_bool_compare_and_swap(&wakeup_pending, 0, 1)) return;
+
+    pool = [[NSAutoreleasePool alloc] init];
+    event = [NSEvent otherEventWithType:NSEventTypeApplicationDefined
+                               location:NSMakePoint(0, 0)
+                          modifierFlags:0
+                              timestamp:0
+                           windowNumber:0
+                                context:nil
+                                subtype:0
+                                  data1:0
+                                  data2:0];
+    [NSApp postEvent:event atStart:NO];
+    [pool release];
+}
+
 int graphics_get_event(graphics_event_t *event) {
     if (!event) return 0;
     if (pending_event.type != GRAPHICS_EVENT_NONE) {
@@ -1,5 +1,6 @@
 #include "../graphics.h"
 #include <GLFW/glfw3.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -25,6 +26,39 @@ static float current_fps = 0.0f;
 static FT_Library ft_library;
 static int ft_initialized = 0;
 
+/* Printable ASCII is rasterized once into a per-font atlas; strings are
+ * laid out into vertex arrays once and cached by text, so a label is one
+ * draw call. Other bytes are drawn as '?'. */
+#define GLYPH_FIRST 32
+#define GLYPH_COUNT 95
+#define GLYPH_COLUMNS 16
+#define GLYPH_BASELINE 8        /* below the y text is drawn at */
+#define TEXT_CACHE_SIZE 128
+
+typedef struct {
+    float s0, t0, s1, t1;
+    int32_t left, top, width, rows;
+    int32_t advance;
+} glfw_glyph_t;
+
+typedef struct {
+    char *text;
+    uint32_t hash;
+    uint32_t quads;
+    GLfloat *vertices;          /* x, y, s, t, two triangles a glyph, from the origin */
+    int32_t width;
+} glfw_text_layout_t;
+
+typedef struct {
+    FT_Face face;
+    GLuint atlas;               /* uploaded on first draw, with a context */
+    unsigned char *atlas_pixels;
+    int32_t atlas_width, atlas_height;
+    glfw_glyph_t glyphs[GLYPH_COUNT];
+    int32_t height;
+    glfw_text_layout_t cache[TEXT_CACHE_SIZE];
+} glfw_font_t;
+
 static void error_callback(int error, const char* description) {
     fprintf(stderr, "GLFW Error %d: %s\n", error, description);
 }
@@ -36,6 +70,13 @@ static void window_size_callback(GLFWwindow* window, int width, int height) {
     window_resized = 1;
 }
 
+static void window_refresh_callback(GLFWwindow* window) {
+    (void)window;
+    if (pending_event.type == GRAPHICS_EVENT_NONE) {
+        pending_event.type = GRAPHICS_EVENT_REFRESH;
+    }
+}
+
 static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
     (void)window;
     (void)scancode;
@@ -124,6 +165,7 @@ window_t *window_create(const char *title, int32_t width, int32_t height) {
     }
 
     glfwSetWindowSizeCallback(glfw_window, window_size_callback);
+    glfwSetWindowRefreshCallback(glfw_window, window_refresh_callback);
     glfwSetKeyCallback(glfw_window, key_callback);
     glfwSetCursorPosCallback(glfw_window, cursor_position_callback);
     glfwMakeContextCurrent(glfw_window);
@@ -181,26 +223,297 @@ void window_get_size(window_t *window, int32_t *width, int32_t *height) {
     glfwGetWindowSize((GLFWwindow*)window->handle, width, height);
 }
 
+/* Geometry and text are drawn by one GLSL 1.20 program from one vertex
+ * buffer, so a batch of bars, lines or glyphs is a copy and a single
+ * glDrawArrays. GL 2.1 entry points past 1.1 are loaded through GLFW. */
+#ifdef _WIN32
+#define GLFW_GL_CALL __stdcall
+#else
+#define GLFW_GL_CALL
+#endif
+
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_FRAGMENT_SHADER
+#define GL_FRAGMENT_SHADER 0x8B30
+#endif
+#ifndef GL_VERTEX_SHADER
+#define GL_VERTEX_SHADER 0x8B31
+#endif
+#ifndef GL_COMPILE_STATUS
+#define GL_COMPILE_STATUS 0x8B81
+#endif
+#ifndef GL_LINK_STATUS
+#define GL_LINK_STATUS 0x8B82
+#endif
+#ifndef GL_CLAMP_TO_EDGE
+#define GL_CLAMP_TO_EDGE 0x812F
+#endif
+
+static struct {
+    GLuint (GLFW_GL_CALL *CreateShader)(GLenum type);
+    void (GLFW_GL_CALL *ShaderSource)(GLuint shader, GLsizei count, const char *const *string, const GLint *length);
+    void (GLFW_GL_CALL *CompileShader)(GLuint shader);
+    void (GLFW_GL_CALL *GetShaderiv)(GLuint shader, GLenum pname, GLint *params);
+    void (GLFW_GL_CALL *GetShaderInfoLog)(GLuint shader, GLsizei size, GLsizei *length, char *log);
+    void (GLFW_GL_CALL *DeleteShader)(GLuint shader);
+    GLuint (GLFW_GL_CALL *CreateProgram)(void);
+    void (GLFW_GL_CALL *AttachShader)(GLuint program, GLuint shader);
+    void (GLFW_GL_CALL *BindAttribLocation)(GLuint program, GLuint index, const char *name);
+    void (GLFW_GL_CALL *LinkProgram)(GLuint program);
+    void (GLFW_GL_CALL *GetProgramiv)(GLuint program, GLenum pname, GLint *params);
+    void (GLFW_GL_CALL *GetProgramInfoLog)(GLuint program, GLsizei size, GLsizei *length, char *log);
+    void (GLFW_GL_CALL *DeleteProgram)(GLuint program);
+    void (GLFW_GL_CALL *UseProgram)(GLuint program);
+    GLint (GLFW_GL_CALL *GetUniformLocation)(GLuint program, const char *name);
+    void (GLFW_GL_CALL *Uniform1i)(GLint location, GLint v0);
+    void (GLFW_GL_CALL *Uniform1f)(GLint location, GLfloat v0);
+    void (GLFW_GL_CALL *Uniform2f)(GLint location, GLfloat v0, GLfloat v1);
+    void (GLFW_GL_CALL *Uniform4f)(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+    void (GLFW_GL_CALL *GenBuffers)(GLsizei n, GLuint *buffers);
+    void (GLFW_GL_CALL *DeleteBuffers)(GLsizei n, const GLuint *buffers);
+    void (GLFW_GL_CALL *BindBuffer)(GLenum target, GLuint buffer);
+    void (GLFW_GL_CALL *BufferData)(GLenum target, ptrdiff_t size, const void *data, GLenum usage);
+    void (GLFW_GL_CALL *BufferSubData)(GLenum target, ptrdiff_t offset, ptrdiff_t size, const void *data);
+    void (GLFW_GL_CALL *EnableVertexAttribArray)(GLuint index);
+    void (GLFW_GL_CALL *DisableVertexAttribArray)(GLuint index);
+    void (GLFW_GL_CALL *VertexAttribPointer)(GLuint index, GLint size, GLenum type, GLboolean normalized,
+                                            GLsizei stride, const void *pointer);
+} gl;
+
+#define GLFW_GL_LOAD(name) do { \
+        GLFWglproc proc = glfwGetProcAddress("gl" #name); \
+        if (!proc) return 0; \
+        memcpy(&gl.name, &proc, sizeof(proc)); \
+    } while (0)
+
+static int glfw_gl_load(void) {
+    GLFW_GL_LOAD(CreateShader);
+    GLFW_GL_LOAD(ShaderSource);
+    GLFW_GL_LOAD(CompileShader);
+    GLFW_GL_LOAD(GetShaderiv);
+    GLFW_GL_LOAD(GetShaderInfoLog);
+    GLFW_GL_LOAD(DeleteShader);
+    GLFW_GL_LOAD(CreateProgram);
+    GLFW_GL_LOAD(AttachShader);
+    GLFW_GL_LOAD(BindAttribLocation);
+    GLFW_GL_LOAD(LinkProgram);
+    GLFW_GL_LOAD(GetProgramiv);
+    GLFW_GL_LOAD(GetProgramInfoLog);
+    GLFW_GL_LOAD(DeleteProgram);
+    GLFW_GL_LOAD(UseProgram);
+    GLFW_GL_LOAD(GetUniformLocation);
+    GLFW_GL_LOAD(Uniform1i);
+    GLFW_GL_LOAD(Uniform1f);
+    GLFW_GL_LOAD(Uniform2f);
+    GLFW_GL_LOAD(Uniform4f);
+    GLFW_GL_LOAD(GenBuffers);
+    GLFW_GL_LOAD(DeleteBuffers);
+    GLFW_GL_LOAD(BindBuffer);
+    GLFW_GL_LOAD(BufferData);
+    GLFW_GL_LOAD(BufferSubData);
+    GLFW_GL_LOAD(EnableVertexAttribArray);
+    GLFW_GL_LOAD(DisableVertexAttribArray);
+    GLFW_GL_LOAD(VertexAttribPointer);
+    return 1;
+}
+
+/* Positions are in window pixels, y down, moved by offset; texturing
+ * takes coverage from the glyph atlas' alpha */
+static const char *glfw_vertex_shader =
+    "#version 120\n"
+    "attribute vec2 position;\n"
+    "attribute vec2 texcoord;\n"
+    "uniform vec2 viewport;\n"
+    "uniform vec2 offset;\n"
+    "varying vec2 uv;\n"
+    "void main() {\n"
+    "    vec2 p = (position + offset) / viewport * 2.0 - 1.0;\n"
+    "    gl_Position = vec4(p.x, -p.y, 0.0, 1.0);\n"
+    "    uv = texcoord;\n"
+    "}\n";
+
+static const char *glfw_fragment_shader =
+    "#version 120\n"
+    "uniform vec4 color;\n"
+    "uniform float textured;\n"
+    "uniform sampler2D atlas;\n"
+    "varying vec2 uv;\n"
+    "void main() {\n"
+    "    float coverage = textured > 0.5 ? texture2D(atlas, uv).a : 1.0;\n"
+    "    gl_FragColor = vec4(color.rgb, color.a * coverage);\n"
+    "}\n";
+
+#define ATTRIB_POSITION 0
+#define ATTRIB_TEXCOORD 1
+
+/* The vertex buffer is filled front to back and orphaned when full, so
+ * a copy never waits for a draw still reading the old storage. Batches
+ * go through in chunks that always fit. */
+#define STREAM_BYTES (1 << 20)
+#define BATCH_VERTICES 6144     /* 1024 rects or 3072 lines */
+
+typedef struct {
+    GLFWwindow *window;
+    GLuint program;
+    GLint u_viewport, u_offset, u_color, u_textured;
+    GLuint stream;
+    size_t stream_used;
+    int32_t viewport_width, viewport_height;
+    GLfloat color[4];
+} glfw_renderer_t;
+
+static GLfloat glfw_batch[BATCH_VERTICES * 2];
+
+static GLuint glfw_compile(GLenum type, const char *source) {
+    GLuint shader = gl.CreateShader(type);
+    GLint ok = 0;
+    char log[512];
+
+    gl.ShaderSource(shader, 1, &source, NULL);
+    gl.CompileShader(shader);
+    gl.GetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        gl.GetShaderInfoLog(shader, sizeof(log), NULL, log);
+        fprintf(stderr, "GLFW shader compile failed: %s\n", log);
+        gl.DeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+static int glfw_renderer_init(glfw_renderer_t *r) {
+    GLuint vs, fs;
+    GLint ok = 0;
+    char log[512];
+
+    if (!glfw_gl_load()) {
+        fprintf(stderr, "GLFW: OpenGL 2.1 entry points not available\n");
+        return 0;
+    }
+
+    vs = glfw_compile(GL_VERTEX_SHADER, glfw_vertex_shader);
+    fs = glfw_compile(GL_FRAGMENT_SHADER, glfw_fragment_shader);
+    if (!vs || !fs) {
+        if (vs) gl.DeleteShader(vs);
+        if (fs) gl.DeleteShader(fs);
+        return 0;
+    }
+
+    r->program = gl.CreateProgram();
+    gl.AttachShader(r->program, vs);
+    gl.AttachShader(r->program, fs);
+    gl.BindAttribLocation(r->program, ATTRIB_POSITION, "position");
+    gl.BindAttribLocation(r->program, ATTRIB_TEXCOORD, "texcoord");
+    gl.LinkProgram(r->program);
+    gl.DeleteShader(vs);
+    gl.DeleteShader(fs);
+    gl.GetProgramiv(r->program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        gl.GetProgramInfoLog(r->program, sizeof(log), NULL, log);
+        fprintf(stderr, "GLFW shader link failed: %s\n", log);
+        gl.DeleteProgram(r->program);
+        return 0;
+    }
+
+    r->u_viewport = gl.GetUniformLocation(r->program, "viewport");
+    r->u_offset = gl.GetUniformLocation(r->program, "offset");
+    r->u_color = gl.GetUniformLocation(r->program, "color");
+    r->u_textured = gl.GetUniformLocation(r->program, "textured");
+    gl.UseProgram(r->program);
+    gl.Uniform1i(gl.GetUniformLocation(r->program, "atlas"), 0);
+
+    gl.GenBuffers(1, &r->stream);
+    gl.BindBuffer(GL_ARRAY_BUFFER, r->stream);
+    gl.BufferData(GL_ARRAY_BUFFER, STREAM_BYTES, NULL, GL_STREAM_DRAW);
+    r->stream_used = 0;
+    return 1;
+}
+
+/* Copies vertices of stride floats each into the stream and draws them,
+ * moved by (x, y) and colored by the current color or, with a texture,
+ * by its alpha in that color */
+static void glfw_draw(glfw_renderer_t *r, GLenum mode, const GLfloat *vertices, uint32_t count,
+                      int stride, GLuint texture, int32_t x, int32_t y, const GLfloat *color) {
+    size_t bytes = sizeof(GLfloat) * (size_t)stride * count;
+    int32_t width, height;
+
+    if (count == 0 || bytes > STREAM_BYTES) return;
+
+    glfwGetWindowSize(r->window, &width, &height);
+    if (width != r->viewport_width || height != r->viewport_height) {
+        r->viewport_width = width;
+        r->viewport_height = height;
+        glViewport(0, 0, width, height);
+        gl.Uniform2f(r->u_viewport, (GLfloat)(width > 0 ? width : 1), (GLfloat)(height > 0 ? height : 1));
+    }
+
+    if (r->stream_used + bytes > STREAM_BYTES) {
+        gl.BufferData(GL_ARRAY_BUFFER, STREAM_BYTES, NULL, GL_STREAM_DRAW);
+        r->stream_used = 0;
+    }
+    gl.BufferSubData(GL_ARRAY_BUFFER, (ptrdiff_t)r->stream_used, (ptrdiff_t)bytes, vertices);
+
+    gl.Uniform2f(r->u_offset, (GLfloat)x, (GLfloat)y);
+    gl.Uniform4f(r->u_color, color[0], color[1], color[2], color[3]);
+    gl.Uniform1f(r->u_textured, texture ? 1.0f : 0.0f);
+
+    gl.EnableVertexAttribArray(ATTRIB_POSITION);
+    gl.VertexAttribPointer(ATTRIB_POSITION, 2, GL_FLOAT, GL_FALSE, stride * sizeof(GLfloat),
+                           (const void *)r->stream_used);
+    if (texture) {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        gl.EnableVertexAttribArray(ATTRIB_TEXCOORD);
+        gl.VertexAttribPointer(ATTRIB_TEXCOORD, 2, GL_FLOAT, GL_FALSE, stride * sizeof(GLfloat),
+                               (const void *)(r->stream_used + 2 * sizeof(GLfloat)));
+    } else {
+        gl.DisableVertexAttribArray(ATTRIB_TEXCOORD);
+    }
+
+    glDrawArrays(mode, 0, (GLsizei)count);
+    r->stream_used += (bytes + 15) & ~(size_t)15;
+}
+
 renderer_t *renderer_create(window_t *window) {
     renderer_t *renderer = malloc(sizeof(renderer_t));
     if (!renderer) return NULL;
 
-    GLFWwindow* glfw_window = (GLFWwindow*)window->handle;
-    glfwMakeContextCurrent(glfw_window);
+    glfw_renderer_t *r = calloc(1, sizeof(glfw_renderer_t));
+    if (!r) {
+        free(renderer);
+        return NULL;
+    }
 
-    int32_t width, height;
-    glfwGetFramebufferSize(glfw_window, &width, &height);
-    glViewport(0, 0, width, height);
+    r->window = (GLFWwindow*)window->handle;
+    glfwMakeContextCurrent(r->window);
+
+    if (!glfw_renderer_init(r)) {
+        free(r);
+        free(renderer);
+        return NULL;
+    }
 
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    r->color[3] = 1.0f;
 
-    renderer->handle = glfw_window;
+    renderer->handle = r;
     return renderer;
 }
 
 void renderer_destroy(renderer_t *renderer) {
     if (!renderer) return;
+
+    glfw_renderer_t *r = (glfw_renderer_t*)renderer->handle;
+    if (r) {
+        gl.DeleteBuffers(1, &r->stream);
+        gl.DeleteProgram(r->program);
+        free(r);
+    }
     free(renderer);
 }
 
@@ -214,77 +527,172 @@ void renderer_clear(renderer_t *renderer, color_t color) {
 void renderer_present(renderer_t *renderer) {
     if (!renderer) return;
 
-    GLFWwindow* glfw_window = (GLFWwindow*)renderer->handle;
-    glfwSwapBuffers(glfw_window);
+    glfw_renderer_t *r = (glfw_renderer_t*)renderer->handle;
+    glfwSwapBuffers(r->window);
+}
+
+/* glfwSwapBuffers leaves the back buffer undefined, so frames are whole */
+int renderer_keeps_frame(renderer_t *renderer) {
+    (void)renderer;
+    return 0;
+}
+
+void renderer_present_rects(renderer_t *renderer, const rect_t *rects, uint32_t count) {
+    (void)rects;
+    (void)count;
+    renderer_present(renderer);
 }
 
 void renderer_set_color(renderer_t *renderer, color_t color) {
     if (!renderer) return;
-    glColor4f(color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f);
+
+    glfw_renderer_t *r = (glfw_renderer_t*)renderer->handle;
+    r->color[0] = color.r / 255.0f;
+    r->color[1] = color.g / 255.0f;
+    r->color[2] = color.b / 255.0f;
+    r->color[3] = color.a / 255.0f;
 }
 
 void renderer_draw_line(renderer_t *renderer, int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
+    line_t line = {x1, y1, x2, y2};
+    renderer_draw_lines(renderer, &line, 1);
+}
+
+void renderer_draw_rect(renderer_t *renderer, rect_t rect) {
     if (!renderer) return;
 
-    GLFWwindow* glfw_window = (GLFWwindow*)renderer->handle;
-    int32_t win_width, win_height;
-    glfwGetWindowSize(glfw_window, &win_width, &win_height);
-    glViewport(0, 0, win_width, win_height);
+    glfw_renderer_t *r = (glfw_renderer_t*)renderer->handle;
+    GLfloat v[8];
+    v[0] = (GLfloat)rect.x;            v[1] = (GLfloat)rect.y;
+    v[2] = (GLfloat)(rect.x + rect.w); v[3] = (GLfloat)rect.y;
+    v[4] = (GLfloat)(rect.x + rect.w); v[5] = (GLfloat)(rect.y + rect.h);
+    v[6] = (GLfloat)rect.x;            v[7] = (GLfloat)(rect.y + rect.h);
+    glfw_draw(r, GL_LINE_LOOP, v, 4, 2, 0, 0, 0, r->color);
+}
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, win_width, win_height, 0, -1, 1);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+void renderer_fill_rect(renderer_t *renderer, rect_t rect) {
+    renderer_fill_rects(renderer, &rect, 1);
+}
 
-    glBegin(GL_LINES);
-    glVertex2i(x1, y1);
-    glVertex2i(x2, y2);
-    glEnd();
+/* One buffer copy and one draw per chunk of the batch */
+void renderer_draw_lines(renderer_t *renderer, const line_t *lines, uint32_t count) {
+    if (!renderer || !lines || count == 0) return;
+
+    glfw_renderer_t *r = (glfw_renderer_t*)renderer->handle;
+    uint32_t i, n = 0;
+    for (i = 0; i < count; i++) {
+        GLfloat *v = glfw_batch + n * 2;
+        v[0] = (GLfloat)lines[i].x1; v[1] = (GLfloat)lines[i].y1;
+        v[2] = (GLfloat)lines[i].x2; v[3] = (GLfloat)lines[i].y2;
+        n += 2;
+        if (n == BATCH_VERTICES) {
+            glfw_draw(r, GL_LINES, glfw_batch, n, 2, 0, 0, 0, r->color);
+            n = 0;
+        }
+    }
+    glfw_draw(r, GL_LINES, glfw_batch, n, 2, 0, 0, 0, r->color);
 }
 
-void renderer_draw_rect(renderer_t *renderer, rect_t rect) {
-    if (!renderer) return;
+void renderer_fill_rects(renderer_t *renderer, const rect_t *rects, uint32_t count) {
+    if (!renderer || !rects || count == 0) return;
+
+    glfw_renderer_t *r = (glfw_renderer_t*)renderer->handle;
+    uint32_t i, n = 0;
+    for (i = 0; i < count; i++) {
+        GLfloat x0 = (GLfloat)rects[i].x, y0 = (GLfloat)rects[i].y;
+        GLfloat x1 = x0 + rects[i].w, y1 = y0 + rects[i].h;
+        GLfloat *v = glfw_batch + n * 2;
+        v[0] = x0;  v[1] = y0;
+        v[2] = x1;  v[3] = y0;
+        v[4] = x1;  v[5] = y1;
+        v[6] = x0;  v[7] = y0;
+        v[8] = x1;  v[9] = y1;
+        v[10] = x0; v[11] = y1;
+        n += 6;
+        if (n == BATCH_VERTICES) {
+            glfw_draw(r, GL_TRIANGLES, glfw_batch, n, 2, 0, 0, 0, r->color);
+            n = 0;
+        }
+    }
+    glfw_draw(r, GL_TRIANGLES, glfw_batch, n, 2, 0, 0, 0, r->color);
+}
 
-    GLFWwindow* glfw_window = (GLFWwindow*)renderer->handle;
-    int32_t win_width, win_height;
-    glfwGetWindowSize(glfw_window, &win_width, &win_height);
-    glViewport(0, 0, win_width, win_height);
+/* Plots draw directly: GL 2.1 has no framebuffer objects without an
+ * extension */
+surface_t *surface_create(renderer_t *renderer, int32_t width, int32_t height) {
+    (void)renderer;
+    (void)width;
+    (void)height;
+    return NULL;
+}
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, win_width, win_height, 0, -1, 1);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+void surface_destroy(renderer_t *renderer, surface_t *surface) {
+    (void)renderer;
+    (void)surface;
+}
 
-    glBegin(GL_LINE_LOOP);
-    glVertex2i(rect.x, rect.y);
-    glVertex2i(rect.x + rect.w, rect.y);
-    glVertex2i(rect.x + rect.w, rect.y + rect.h);
-    glVertex2i(rect.x, rect.y + rect.h);
-    glEnd();
+void surface_scroll(renderer_t *renderer, surface_t *surface, int32_t dx) {
+    (void)renderer;
+    (void)surface;
+    (void)dx;
 }
 
-void renderer_fill_rect(renderer_t *renderer, rect_t rect) {
-    if (!renderer) return;
+void renderer_set_target(renderer_t *renderer, surface_t *surface) {
+    (void)renderer;
+    (void)surface;
+}
 
-    GLFWwindow* glfw_window = (GLFWwindow*)renderer->handle;
-    int32_t win_width, win_height;
-    glfwGetWindowSize(glfw_window, &win_width, &win_height);
-    glViewport(0, 0, win_width, win_height);
+void renderer_draw_surface(renderer_t *renderer, surface_t *surface, int32_t x, int32_t y) {
+    (void)renderer;
+    (void)surface;
+    (void)x;
+    (void)y;
+}
+
+/* Renders the glyphs into one alpha bitmap, a pixel apart so filtering
+ * never reaches a neighbour */
+static int glfw_font_rasterize(glfw_font_t *ctx) {
+    FT_Face face = ctx->face;
+    int32_t cell_w = 1, cell_h = 1;
+    int i;
+
+    for (i = 0; i < GLYPH_COUNT; i++) {
+        if (FT_Load_Char(face, GLYPH_FIRST + i, FT_LOAD_RENDER)) continue;
+        if ((int32_t)face->glyph->bitmap.width > cell_w) cell_w = face->glyph->bitmap.width;
+        if ((int32_t)face->glyph->bitmap.rows > cell_h) cell_h = face->glyph->bitmap.rows;
+    }
+    cell_w++;
+    cell_h++;
+
+    ctx->atlas_width = cell_w * GLYPH_COLUMNS;
+    ctx->atlas_height = cell_h * ((GLYPH_COUNT + GLYPH_COLUMNS - 1) / GLYPH_COLUMNS);
+    ctx->atlas_pixels = calloc((size_t)ctx->atlas_width * ctx->atlas_height, 1);
+    if (!ctx->atlas_pixels) return 0;
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, win_width, win_height, 0, -1, 1);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    for (i = 0; i < GLYPH_COUNT; i++) {
+        glfw_glyph_t *glyph = &ctx->glyphs[i];
+        if (FT_Load_Char(face, GLYPH_FIRST + i, FT_LOAD_RENDER)) continue;
 
-    glBegin(GL_QUADS);
-    glVertex2i(rect.x, rect.y);
-    glVertex2i(rect.x + rect.w, rect.y);
-    glVertex2i(rect.x + rect.w, rect.y + rect.h);
-    glVertex2i(rect.x, rect.y + rect.h);
-    glEnd();
+        FT_GlyphSlot slot = face->glyph;
+        int32_t x0 = (i % GLYPH_COLUMNS) * cell_w;
+        int32_t y0 = (i / GLYPH_COLUMNS) * cell_h;
+        uint32_t row;
+        for (row = 0; row < slot->bitmap.rows; row++) {
+            memcpy(ctx->atlas_pixels + (size_t)(y0 + row) * ctx->atlas_width + x0,
+                   slot->bitmap.buffer + (int)row * slot->bitmap.pitch, slot->bitmap.width);
+        }
+
+        glyph->left = slot->bitmap_left;
+        glyph->top = slot->bitmap_top;
+        glyph->width = slot->bitmap.width;
+        glyph->rows = slot->bitmap.rows;
+        glyph->advance = slot->advance.x >> 6;
+        glyph->s0 = (float)x0 / ctx->atlas_width;
+        glyph->t0 = (float)y0 / ctx->atlas_height;
+        glyph->s1 = (float)(x0 + glyph->width) / ctx->atlas_width;
+        glyph->t1 = (float)(y0 + glyph->rows) / ctx->atlas_height;
+    }
+    return 1;
 }
 
 font_t *font_create(const char *path, int32_t size) {
@@ -325,86 +733,133 @@ font_t *font_create(const char *path, int32_t size) {
         return NULL;
     }
 
-    font->handle = face;
+    glfw_font_t *ctx = calloc(1, sizeof(glfw_font_t));
+    if (!ctx) {
+        FT_Done_Face(face);
+        free(font);
+        return NULL;
+    }
+    ctx->face = face;
+    ctx->height = face->size->metrics.height >> 6;
+    if (!glfw_font_rasterize(ctx)) {
+        FT_Done_Face(face);
+        free(ctx);
+        free(font);
+        return NULL;
+    }
+
+    font->handle = ctx;
     return font;
 }
 
 void font_destroy(font_t *font) {
     if (!font) return;
     if (font->handle) {
-        FT_Done_Face((FT_Face)font->handle);
+        glfw_font_t *ctx = (glfw_font_t*)font->handle;
+        int i;
+        for (i = 0; i < TEXT_CACHE_SIZE; i++) {
+            free(ctx->cache[i].text);
+            free(ctx->cache[i].vertices);
+        }
+        if (ctx->atlas) glDeleteTextures(1, &ctx->atlas);
+        free(ctx->atlas_pixels);
+        FT_Done_Face(ctx->face);
+        free(ctx);
     }
     free(font);
 }
 
-void font_draw_text(renderer_t *renderer, font_t *font, color_t color,
-                    int32_t x, int32_t y, const char *text) {
-    if (!renderer || !font || !text || !font->handle) return;
-
-    GLFWwindow* glfw_window = (GLFWwindow*)renderer->handle;
-    int32_t win_width, win_height;
-    glfwGetWindowSize(glfw_window, &win_width, &win_height);
-    glViewport(0, 0, win_width, win_height);
+static const glfw_glyph_t *glfw_font_glyph(const glfw_font_t *ctx, unsigned char c) {
+    if (c < GLYPH_FIRST || c >= GLYPH_FIRST + GLYPH_COUNT) c = '?';
+    return &ctx->glyphs[c - GLYPH_FIRST];
+}
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    glOrtho(0, win_width, 0, win_height, -1, 1);
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+/* The cached layout of text, one slot per hash, or NULL without memory */
+static const glfw_text_layout_t *glfw_font_layout(glfw_font_t *ctx, const char *text) {
+    uint32_t hash = 2166136261U;
+    uint32_t length, i, quads;
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_TEXTURE_2D);
+    for (length = 0; text[length]; length++) {
+        hash = (hash ^ (unsigned char)text[length]) * 16777619U;
+    }
 
-    FT_Face face = (FT_Face)font->handle;
-    float pen_x = (float)x;
-    float pen_y = (float)(win_height - y - 8);
+    glfw_text_layout_t *layout = &ctx->cache[hash % TEXT_CACHE_SIZE];
+    if (layout->text && layout->hash == hash && strcmp(layout->text, text) == 0) {
+        return layout;
+    }
 
-    for (const char* c = text; *c; c++) {
-        if (FT_Load_Char(face, *c, FT_LOAD_RENDER)) {
-            continue;
+    free(layout->text);
+    free(layout->vertices);
+    layout->text = malloc(length + 1);
+    layout->vertices = malloc(sizeof(GLfloat) * 24 * (length + 1));
+    if (!layout->text || !layout->vertices) {
+        free(layout->text);
+        free(layout->vertices);
+        layout->text = NULL;
+        layout->vertices = NULL;
+        return NULL;
+    }
+    memcpy(layout->text, text, length + 1);
+
+    int32_t pen = 0;
+    quads = 0;
+    for (i = 0; i < length; i++) {
+        const glfw_glyph_t *glyph = glfw_font_glyph(ctx, (unsigned char)text[i]);
+        if (glyph->width > 0 && glyph->rows > 0) {
+            GLfloat x0 = (GLfloat)(pen + glyph->left);
+            GLfloat y0 = (GLfloat)(GLYPH_BASELINE - glyph->top);
+            GLfloat x1 = x0 + glyph->width;
+            GLfloat y1 = y0 + glyph->rows;
+            GLfloat *v = layout->vertices + quads * 24;
+
+            v[0] = x0;  v[1] = y0;  v[2] = glyph->s0;  v[3] = glyph->t0;
+            v[4] = x1;  v[5] = y0;  v[6] = glyph->s1;  v[7] = glyph->t0;
+            v[8] = x1;  v[9] = y1;  v[10] = glyph->s1; v[11] = glyph->t1;
+            v[12] = x0; v[13] = y0; v[14] = glyph->s0; v[15] = glyph->t0;
+            v[16] = x1; v[17] = y1; v[18] = glyph->s1; v[19] = glyph->t1;
+            v[20] = x0; v[21] = y1; v[22] = glyph->s0; v[23] = glyph->t1;
+            quads++;
         }
+        pen += glyph->advance;
+    }
 
-        FT_GlyphSlot slot = face->glyph;
-        FT_Bitmap bitmap = slot->bitmap;
+    layout->hash = hash;
+    layout->quads = quads;
+    layout->width = pen;
+    return layout;
+}
 
-        if (bitmap.width == 0 || bitmap.rows == 0) {
-            pen_x += slot->advance.x >> 6;
-            continue;
-        }
+void font_draw_text(renderer_t *renderer, font_t *font, color_t color,
+                    int32_t x, int32_t y, const char *text) {
+    if (!renderer || !font || !text || !font->handle) return;
 
-        GLuint texture;
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
+    glfw_font_t *ctx = (glfw_font_t*)font->handle;
+    const glfw_text_layout_t *layout = glfw_font_layout(ctx, text);
+    if (!layout || layout->quads == 0) return;
+
+    if (!ctx->atlas) {
+        glGenTextures(1, &ctx->atlas);
+        glBindTexture(GL_TEXTURE_2D, ctx->atlas);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
         glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, bitmap.width, bitmap.rows, 0,
-                     GL_ALPHA, GL_UNSIGNED_BYTE, bitmap.buffer);
-
-        float xpos = pen_x + slot->bitmap_left;
-        float ypos = pen_y - (bitmap.rows - slot->bitmap_top);
-        float w = (float)bitmap.width;
-        float h = (float)bitmap.rows;
-
-        glColor4f(color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f);
-
-        glBegin(GL_QUADS);
-        glTexCoord2f(0.0f, 0.0f); glVertex2f(xpos, ypos + h);
-        glTexCoord2f(1.0f, 0.0f); glVertex2f(xpos + w, ypos + h);
-        glTexCoord2f(1.0f, 1.0f); glVertex2f(xpos + w, ypos);
-        glTexCoord2f(0.0f, 1.0f); glVertex2f(xpos, ypos);
-        glEnd();
-
-        glDeleteTextures(1, &texture);
-        pen_x += slot->advance.x >> 6;
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, ctx->atlas_width, ctx->atlas_height, 0,
+                     GL_ALPHA, GL_UNSIGNED_BYTE, ctx->atlas_pixels);
+        free(ctx->atlas_pixels);
+        ctx->atlas_pixels = NULL;
     }
 
-    glDisable(GL_TEXTURE_2D);
+    GLfloat tint[4];
+    tint[0] = color.r / 255.0f;
+    tint[1] = color.g / 255.0f;
+    tint[2] = color.b / 255.0f;
+    tint[3] = color.a / 255.0f;
+    glfw_draw((glfw_renderer_t*)renderer->handle, GL_TRIANGLES, layout->vertices, layout->quads * 6,
+              4, ctx->atlas, x, y, tint);
 }
 
 void font_get_text_size(font_t *font, const char *text, int32_t *width, int32_t *height) {
@@ -414,26 +869,11 @@ void font_get_text_size(font_t *font, const char *text, int32_t *width, int32_t
         return;
     }
 
-    FT_Face face = (FT_Face)font->handle;
-    int total_width = 0;
-    int max_height = 0;
-
-    for (const char* c = text; *c; c++) {
-        if (FT_Load_Char(face, *c, FT_LOAD_DEFAULT)) {
-            continue;
-        }
-
-        FT_GlyphSlot slot = face->glyph;
-        total_width += slot->advance.x >> 6;
-
-        int char_height = slot->bitmap_top + (slot->bitmap.rows - slot->bitmap_top);
-        if (char_height > max_height) {
-            max_height = char_height;
-        }
-    }
+    glfw_font_t *ctx = (glfw_font_t*)font->handle;
+    const glfw_text_layout_t *layout = glfw_font_layout(ctx, text);
 
-    if (width) *width = total_width;
-    if (height) *height = max_height > 0 ? max_height : face->size->metrics.height >> 6;
+    if (width) *width = layout ? layout->width : 0;
+    if (height) *height = ctx->height;
 }
 
 int graphics_poll_events(void) {
@@ -453,19 +893,15 @@ int graphics_wait_events(void) {
     if (fps <= 0) fps = 60;
     target_fps = fps;
 
-    double current_time = glfwGetTime();
+    /* block until input, a graphics_wakeup() or the idle time */
+    glfwWaitEventsTimeout(GRAPHICS_IDLE_MS / 1000.0);
+
+    /* coalesce bursts of samples to max_fps, still handling input */
     double target_frame_time = 1.0 / target_fps;
-    double elapsed = current_time - last_frame_time;
-
-    if (elapsed < target_frame_time) {
-        double wait_time = target_frame_time - elapsed;
-        if (wait_time > 0.001) {
-            glfwWaitEventsTimeout(wait_time);
-        } else {
-            glfwPollEvents();
-        }
-    } else {
-        glfwPollEvents();
+    double remaining = last_frame_time + target_frame_time - glfwGetTime();
+    while (remaining > 0.001) {
+        glfwWaitEventsTimeout(remaining);
+        remaining = last_frame_time + target_frame_time - glfwGetTime();
     }
 
     GLFWwindow* current_window = glfwGetCurrentContext();
@@ -473,12 +909,15 @@ int graphics_wait_events(void) {
         return 0;
     }
 
-    current_time = glfwGetTime();
-    last_frame_time = current_time;
+    last_frame_time = glfwGetTime();
 
     return 1;
 }
 
+void graphics_wakeup(void) {
+    glfwPostEmptyEvent();
+}
+
 int graphics_get_event(graphics_event_t *event) {
     if (!event) return 0;
 
@@ -2,6 +2,7 @@
 #include <gtk/gtk.h>
 #include <cairo.h>
 #include <pango/pangocairo.h>
+#include <string.h>
 #include <sys/time.h>
 #include <unistd.h>
 
@@ -31,7 +32,8 @@ static gtk_window_context_t *gtk_active_window = NULL;
 
 static graphics_event_t pending_event = {GRAPHICS_EVENT_NONE, 0, 0, 0};
 static int fullscreen_state = 0;
-static guint gtk_render_timer_id = 0;
+static guint gtk_idle_timer_id = 0;
+static volatile gint wakeup_pending = 0;
 static int window_resized = 0;
 static int32_t current_mouse_x = 0;
 static int32_t current_mouse_y = 0;
@@ -50,14 +52,10 @@ static uint64_t gtk_get_time_ms(void) {
     return g_get_monotonic_time() / 1000;
 }
 
-static gboolean gtk_render_timer_callback(gpointer user_data) {
+static gboolean gtk_idle_timer_callback(gpointer user_data) {
     (void)user_data;
-
-    if (gtk_active_window && gtk_active_window->drawing_area) {
-        gtk_widget_queue_draw(gtk_active_window->drawing_area);
-    }
-
-    return TRUE;
+    gtk_idle_timer_id = 0;
+    return FALSE;
 }
 
 static gboolean gtk_key_press_callback(GtkWidget *widget, GdkEventKey *event, gpointer user_data) {
@@ -236,6 +234,11 @@ void window_get_size(window_t *window, int32_t *width, int32_t *height) {
     *height = ctx->height;
 }
 
+/* Where drawing goes: a surface's context while one is the target */
+static cairo_t *gtk_target(gtk_renderer_context_t *ctx) {
+    return ctx->cr ? ctx->cr : ctx->window_context->cr;
+}
+
 renderer_t *renderer_create(window_t *window) {
     renderer_t *renderer;
     gtk_renderer_context_t *ctx;
@@ -286,7 +289,35 @@ void renderer_clear(renderer_t *renderer, color_t color) {
 }
 
 void renderer_present(renderer_t *renderer) {
+    gtk_renderer_context_t *ctx;
+
     if (!renderer) return;
+
+    ctx = (gtk_renderer_context_t*)renderer->handle;
+    if (ctx->window_context && ctx->window_context->drawing_area) {
+        gtk_widget_queue_draw(ctx->window_context->drawing_area);
+    }
+}
+
+int renderer_keeps_frame(renderer_t *renderer) {
+    (void)renderer;
+    return 1;
+}
+
+void renderer_present_rects(renderer_t *renderer, const rect_t *rects, uint32_t count) {
+    gtk_renderer_context_t *ctx;
+    uint32_t i;
+
+    if (!renderer) return;
+
+    ctx = (gtk_renderer_context_t*)renderer->handle;
+    if (!ctx->window_context || !ctx->window_context->drawing_area) return;
+
+    for (i = 0; i < count; i++) {
+        if (rects[i].w <= 0 || rects[i].h <= 0) continue;
+        gtk_widget_queue_draw_area(ctx->window_context->drawing_area,
+                                   rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+    }
 }
 
 void renderer_set_color(renderer_t *renderer, color_t color) {
@@ -300,51 +331,195 @@ void renderer_set_color(renderer_t *renderer, color_t color) {
 
 void renderer_draw_line(renderer_t *renderer, int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
     gtk_renderer_context_t *ctx;
+    cairo_t *cr;
 
     if (!renderer) return;
 
     ctx = (gtk_renderer_context_t*)renderer->handle;
-    if (ctx->window_context->cr) {
-        cairo_set_source_rgba(ctx->window_context->cr,
+    cr = gtk_target(ctx);
+    if (cr) {
+        cairo_set_source_rgba(cr,
                              ctx->current_color.r / 255.0, ctx->current_color.g / 255.0,
                              ctx->current_color.b / 255.0, ctx->current_color.a / 255.0);
-        cairo_set_line_width(ctx->window_context->cr, 1.0);
-        cairo_set_antialias(ctx->window_context->cr, CAIRO_ANTIALIAS_NONE);
-        cairo_move_to(ctx->window_context->cr, x1 + 0.5, y1 + 0.5);
-        cairo_line_to(ctx->window_context->cr, x2 + 0.5, y2 + 0.5);
-        cairo_stroke(ctx->window_context->cr);
+        cairo_set_line_width(cr, 1.0);
+        cairo_set_antialias(cr, CAIRO_ANTIALIAS_NONE);
+        cairo_move_to(cr, x1 + 0.5, y1 + 0.5);
+        cairo_line_to(cr, x2 + 0.5, y2 + 0.5);
+        cairo_stroke(cr);
     }
 }
 
 void renderer_draw_rect(renderer_t *renderer, rect_t rect) {
     gtk_renderer_context_t *ctx;
+    cairo_t *cr;
 
     if (!renderer) return;
 
     ctx = (gtk_renderer_context_t*)renderer->handle;
-    if (ctx->window_context->cr) {
-        cairo_set_source_rgba(ctx->window_context->cr,
+    cr = gtk_target(ctx);
+    if (cr) {
+        cairo_set_source_rgba(cr,
                              ctx->current_color.r / 255.0, ctx->current_color.g / 255.0,
                              ctx->current_color.b / 255.0, ctx->current_color.a / 255.0);
-        cairo_set_line_width(ctx->window_context->cr, 1.0);
-        cairo_set_antialias(ctx->window_context->cr, CAIRO_ANTIALIAS_NONE);
-        cairo_rectangle(ctx->window_context->cr, rect.x + 0.5, rect.y + 0.5, rect.w - 1, rect.h - 1);
-        cairo_stroke(ctx->window_context->cr);
+        cairo_set_line_width(cr, 1.0);
+        cairo_set_antialias(cr, CAIRO_ANTIALIAS_NONE);
+        cairo_rectangle(cr, rect.x + 0.5, rect.y + 0.5, rect.w - 1, rect.h - 1);
+        cairo_stroke(cr);
     }
 }
 
 void renderer_fill_rect(renderer_t *renderer, rect_t rect) {
     gtk_renderer_context_t *ctx;
+    cairo_t *cr;
 
     if (!renderer) return;
 
     ctx = (gtk_renderer_context_t*)renderer->handle;
-    if (ctx->window_context->cr) {
-        cairo_set_source_rgba(ctx->window_context->cr,
+    cr = gtk_target(ctx);
+    if (cr) {
+        cairo_set_source_rgba(cr,
+                             ctx->current_color.r / 255.0, ctx->current_color.g / 255.0,
+                             ctx->current_color.b / 255.0, ctx->current_color.a / 255.0);
+        cairo_rectangle(cr, rect.x, rect.y, rect.w, rect.h);
+        cairo_fill(cr);
+    }
+}
+
+/* The whole batch is one path, stroked or filled once */
+void renderer_draw_lines(renderer_t *renderer, const line_t *lines, uint32_t count) {
+    gtk_renderer_context_t *ctx;
+    cairo_t *cr;
+    uint32_t i;
+
+    if (!renderer || !lines || count == 0) return;
+
+    ctx = (gtk_renderer_context_t*)renderer->handle;
+    cr = gtk_target(ctx);
+    if (cr) {
+        cairo_set_source_rgba(cr,
                              ctx->current_color.r / 255.0, ctx->current_color.g / 255.0,
                              ctx->current_color.b / 255.0, ctx->current_color.a / 255.0);
-        cairo_rectangle(ctx->window_context->cr, rect.x, rect.y, rect.w, rect.h);
-        cairo_fill(ctx->window_context->cr);
+        cairo_set_line_width(cr, 1.0);
+        cairo_set_antialias(cr, CAIRO_ANTIALIAS_NONE);
+        for (i = 0; i < count; i++) {
+            cairo_move_to(cr, lines[i].x1 + 0.5, lines[i].y1 + 0.5);
+            cairo_line_to(cr, lines[i].x2 + 0.5, lines[i].y2 + 0.5);
+        }
+        cairo_stroke(cr);
+    }
+}
+
+void renderer_fill_rects(renderer_t *renderer, const rect_t *rects, uint32_t count) {
+    gtk_renderer_context_t *ctx;
+    cairo_t *cr;
+    uint32_t i;
+
+    if (!renderer || !rects || count == 0) return;
+
+    ctx = (gtk_renderer_context_t*)renderer->handle;
+    cr = gtk_target(ctx);
+    if (cr) {
+        cairo_set_source_rgba(cr,
+                             ctx->current_color.r / 255.0, ctx->current_color.g / 255.0,
+                             ctx->current_color.b / 255.0, ctx->current_color.a / 255.0);
+        for (i = 0; i < count; i++) {
+            cairo_rectangle(cr, rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+        }
+        cairo_fill(cr);
+    }
+}
+
+typedef struct {
+    cairo_surface_t *image;
+    cairo_t *cr;
+} gtk_surface_t;
+
+surface_t *surface_create(renderer_t *renderer, int32_t width, int32_t height) {
+    surface_t *surface;
+    gtk_surface_t *ctx;
+
+    if (!renderer || width <= 0 || height <= 0) return NULL;
+
+    surface = malloc(sizeof(surface_t));
+    if (!surface) return NULL;
+
+    ctx = malloc(sizeof(gtk_surface_t));
+    if (!ctx) {
+        free(surface);
+        return NULL;
+    }
+
+    ctx->image = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+    if (cairo_surface_status(ctx->image) != CAIRO_STATUS_SUCCESS) {
+        cairo_surface_destroy(ctx->image);
+        free(ctx);
+        free(surface);
+        return NULL;
+    }
+    ctx->cr = cairo_create(ctx->image);
+
+    surface->handle = ctx;
+    surface->width = width;
+    surface->height = height;
+    return surface;
+}
+
+void surface_destroy(renderer_t *renderer, surface_t *surface) {
+    gtk_renderer_context_t *rctx;
+    gtk_surface_t *ctx;
+
+    if (!renderer || !surface) return;
+
+    rctx = (gtk_renderer_context_t*)renderer->handle;
+    ctx = (gtk_surface_t*)surface->handle;
+    if (rctx->cr == ctx->cr) rctx->cr = NULL;
+
+    cairo_destroy(ctx->cr);
+    cairo_surface_destroy(ctx->image);
+    free(ctx);
+    free(surface);
+}
+
+/* Moves the rows in place rather than painting the image onto itself */
+void surface_scroll(renderer_t *renderer, surface_t *surface, int32_t dx) {
+    gtk_surface_t *ctx;
+    unsigned char *data;
+    int stride, y;
+
+    if (!renderer || !surface || dx <= 0 || dx >= surface->width) return;
+
+    ctx = (gtk_surface_t*)surface->handle;
+    cairo_surface_flush(ctx->image);
+    data = cairo_image_surface_get_data(ctx->image);
+    stride = cairo_image_surface_get_stride(ctx->image);
+    for (y = 0; y < surface->height; y++) {
+        memmove(data + y * stride, data + y * stride + dx * 4, (size_t)(surface->width - dx) * 4);
+    }
+    cairo_surface_mark_dirty(ctx->image);
+}
+
+void renderer_set_target(renderer_t *renderer, surface_t *surface) {
+    gtk_renderer_context_t *ctx;
+
+    if (!renderer) return;
+
+    ctx = (gtk_renderer_context_t*)renderer->handle;
+    ctx->cr = surface ? ((gtk_surface_t*)surface->handle)->cr : NULL;
+}
+
+void renderer_draw_surface(renderer_t *renderer, surface_t *surface, int32_t x, int32_t y) {
+    gtk_surface_t *ctx;
+    cairo_t *cr;
+
+    if (!renderer || !surface) return;
+
+    ctx = (gtk_surface_t*)surface->handle;
+    cr = gtk_target((gtk_renderer_context_t*)renderer->handle);
+    if (cr) {
+        cairo_surface_flush(ctx->image);
+        cairo_set_source_surface(cr, ctx->image, x, y);
+        cairo_rectangle(cr, x, y, surface->width, surface->height);
+        cairo_fill(cr);
     }
 }
 
@@ -395,11 +570,13 @@ void font_destroy(font_t *font) {
 void font_draw_text(renderer_t *renderer, font_t *font, color_t color,
                     int32_t x, int32_t y, const char *text) {
     gtk_renderer_context_t *rctx;
+    cairo_t *cr;
     gtk_font_context_t *fctx;
 
     if (!renderer || !font || !text) return;
 
     rctx = (gtk_renderer_context_t*)renderer->handle;
+    cr = gtk_target(rctx);
     fctx = (gtk_font_context_t*)font->handle;
 
     if (rctx->window_context->cr) {
@@ -409,10 +586,10 @@ void font_draw_text(renderer_t *renderer, font_t *font, color_t color,
         }
 
         pango_layout_set_text(fctx->layout, text, -1);
-        cairo_set_source_rgba(rctx->window_context->cr,
+        cairo_set_source_rgba(cr,
                              color.r / 255.0, color.g / 255.0, color.b / 255.0, color.a / 255.0);
-        cairo_move_to(rctx->window_context->cr, x, y);
-        pango_cairo_show_layout(rctx->window_context->cr, fctx->layout);
+        cairo_move_to(cr, x, y);
+        pango_cairo_show_layout(cr, fctx->layout);
     }
 }
 
@@ -461,12 +638,15 @@ int graphics_wait_events(void) {
     fps = config_get_max_fps();
     if (fps <= 0) fps = 1;
 
-    while (gtk_events_pending()) {
-        gtk_main_iteration();
-    }
-
-    if (gtk_active_window && gtk_active_window->should_quit) {
-        return 0;
+    /* sleep in the main loop until GTK has work, a collector calls
+     * graphics_wakeup() or the idle time passes */
+    if (!gtk_events_pending() && !g_atomic_int_get(&wakeup_pending)) {
+        gtk_idle_timer_id = g_timeout_add(GRAPHICS_IDLE_MS, gtk_idle_timer_callback, NULL);
+        g_main_context_iteration(NULL, TRUE);
+        if (gtk_idle_timer_id != 0) {
+            g_source_remove(gtk_idle_timer_id);
+            gtk_idle_timer_id = 0;
+        }
     }
 
     current_time_ms = gtk_get_time_ms();
@@ -489,7 +669,16 @@ int graphics_wait_events(void) {
     }
 
     last_frame_time = gtk_get_time_us();
-    return 1;
+
+    /* samples landing from here on wake the next wait */
+    g_atomic_int_set(&wakeup_pending, 0);
+    return graphics_poll_events();
+}
+
+void graphics_wakeup(void) {
+    if (g_atomic_int_compare_and_exchange(&wakeup_pending, 0, 1)) {
+        g_main_context_wakeup(NULL);
+    }
 }
 
 int graphics_get_event(graphics_event_t *event) {
@@ -506,21 +695,10 @@ int graphics_get_event(graphics_event_t *event) {
 }
 
 void graphics_start_render_timer(int fps) {
-    guint interval;
-
-    if (gtk_render_timer_id != 0) {
-        g_source_remove(gtk_render_timer_id);
-    }
-
-    interval = 1000 / fps;
-    gtk_render_timer_id = g_timeout_add(interval, gtk_render_timer_callback, NULL);
+    (void)fps;
 }
 
 void graphics_stop_render_timer(void) {
-    if (gtk_render_timer_id != 0) {
-        g_source_remove(gtk_render_timer_id);
-        gtk_render_timer_id = 0;
-    }
 }
 
 static gboolean gtk_expose_callback(GtkWidget *widget, GdkEventExpose *event, gpointer data) {
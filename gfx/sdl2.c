@@ -1,4 +1,5 @@
 #include "../graphics.h"
+#include <string.h>
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <fontconfig/fontconfig.h>
@@ -14,6 +15,35 @@ static graphics_event_t pending_event = {GRAPHICS_EVENT_NONE, 0, 0, 0};
 static int fullscreen_state = 0;
 static int32_t current_mouse_x = 0;
 static int32_t current_mouse_y = 0;
+static uint32_t device_resets = 0;      /* textures are lost on each */
+static SDL_atomic_t wakeup_pending;     /* an SDL_USEREVENT is queued */
+static Uint32 last_wait_time = 0;
+
+/* Printable ASCII is drawn from a per-font atlas texture, in strings laid
+ * out once and cached by text; anything else is rendered by SDL_ttf */
+#define GLYPH_FIRST 32
+#define GLYPH_COUNT 95
+#define GLYPH_COLUMNS 16
+#define TEXT_CACHE_SIZE 128
+
+typedef struct {
+    char *text;
+    uint32_t hash;
+    uint32_t length;
+    int32_t *pen_x;
+    int32_t width;
+} sdl_text_layout_t;
+
+typedef struct {
+    TTF_Font *ttf;
+    SDL_Texture *atlas;         /* built on first draw, for that renderer */
+    SDL_Renderer *atlas_renderer;
+    uint32_t atlas_resets;
+    SDL_Rect cells[GLYPH_COUNT];
+    int32_t advances[GLYPH_COUNT];
+    int32_t height;
+    sdl_text_layout_t cache[TEXT_CACHE_SIZE];
+} sdl_font_t;
 
 int graphics_init(void) {
     if (sdl_initialized) {
@@ -135,6 +165,18 @@ void renderer_present(renderer_t *renderer) {
     SDL_RenderPresent((SDL_Renderer*)renderer->handle);
 }
 
+/* SDL_RenderPresent leaves the back buffer undefined */
+int renderer_keeps_frame(renderer_t *renderer) {
+    (void)renderer;
+    return 0;
+}
+
+void renderer_present_rects(renderer_t *renderer, const rect_t *rects, uint32_t count) {
+    (void)rects;
+    (void)count;
+    renderer_present(renderer);
+}
+
 void renderer_set_color(renderer_t *renderer, color_t color) {
     if (!renderer) return;
     SDL_SetRenderDrawColor((SDL_Renderer*)renderer->handle,
@@ -158,6 +200,128 @@ void renderer_fill_rect(renderer_t *renderer, rect_t rect) {
     SDL_RenderFillRect((SDL_Renderer*)renderer->handle, &sdl_rect);
 }
 
+/* SDL_RenderDrawLines draws a polyline, so segments go one by one into
+ * SDL's own render batch; rects go as one call per chunk */
+#define SDL_BATCH 256
+
+void renderer_draw_lines(renderer_t *renderer, const line_t *lines, uint32_t count) {
+    if (!renderer || !lines) return;
+
+    SDL_Renderer *sdl_renderer = (SDL_Renderer*)renderer->handle;
+    uint32_t i;
+    for (i = 0; i < count; i++) {
+        SDL_RenderDrawLine(sdl_renderer, lines[i].x1, lines[i].y1, lines[i].x2, lines[i].y2);
+    }
+}
+
+void renderer_fill_rects(renderer_t *renderer, const rect_t *rects, uint32_t count) {
+    if (!renderer || !rects) return;
+
+    SDL_Rect sdl_rects[SDL_BATCH];
+    uint32_t i, n;
+    while (count > 0) {
+        n = (count < SDL_BATCH) ? count : SDL_BATCH;
+        for (i = 0; i < n; i++) {
+            sdl_rects[i].x = rects[i].x;
+            sdl_rects[i].y = rects[i].y;
+            sdl_rects[i].w = rects[i].w;
+            sdl_rects[i].h = rects[i].h;
+        }
+        SDL_RenderFillRects((SDL_Renderer*)renderer->handle, sdl_rects, (int)n);
+        rects += n;
+        count -= n;
+    }
+}
+
+typedef struct {
+    SDL_Texture *textures[2];   /* a scroll copies one into the other */
+    int current;
+} sdl_surface_t;
+
+surface_t *surface_create(renderer_t *renderer, int32_t width, int32_t height) {
+    if (!renderer || width <= 0 || height <= 0) return NULL;
+
+    SDL_Renderer *sdl_renderer = (SDL_Renderer*)renderer->handle;
+    if (!SDL_RenderTargetSupported(sdl_renderer)) return NULL;
+
+    surface_t *surface = malloc(sizeof(surface_t));
+    if (!surface) return NULL;
+
+    sdl_surface_t *ctx = malloc(sizeof(sdl_surface_t));
+    if (!ctx) {
+        free(surface);
+        return NULL;
+    }
+
+    int i;
+    for (i = 0; i < 2; i++) {
+        ctx->textures[i] = SDL_CreateTexture(sdl_renderer, SDL_PIXELFORMAT_RGBA8888,
+                                             SDL_TEXTUREACCESS_TARGET, width, height);
+        if (ctx->textures[i]) SDL_SetTextureBlendMode(ctx->textures[i], SDL_BLENDMODE_NONE);
+    }
+    if (!ctx->textures[0] || !ctx->textures[1]) {
+        if (ctx->textures[0]) SDL_DestroyTexture(ctx->textures[0]);
+        if (ctx->textures[1]) SDL_DestroyTexture(ctx->textures[1]);
+        free(ctx);
+        free(surface);
+        return NULL;
+    }
+    ctx->current = 0;
+
+    surface->handle = ctx;
+    surface->width = width;
+    surface->height = height;
+    return surface;
+}
+
+void surface_destroy(renderer_t *renderer, surface_t *surface) {
+    if (!renderer || !surface) return;
+
+    SDL_Renderer *sdl_renderer = (SDL_Renderer*)renderer->handle;
+    sdl_surface_t *ctx = (sdl_surface_t*)surface->handle;
+    if (SDL_GetRenderTarget(sdl_renderer) == ctx->textures[ctx->current]) {
+        SDL_SetRenderTarget(sdl_renderer, NULL);
+    }
+
+    SDL_DestroyTexture(ctx->textures[0]);
+    SDL_DestroyTexture(ctx->textures[1]);
+    free(ctx);
+    free(surface);
+}
+
+/* A texture cannot be copied onto itself, so the shifted pixels go into
+ * the other one, which becomes current */
+void surface_scroll(renderer_t *renderer, surface_t *surface, int32_t dx) {
+    if (!renderer || !surface || dx <= 0 || dx >= surface->width) return;
+
+    SDL_Renderer *sdl_renderer = (SDL_Renderer*)renderer->handle;
+    sdl_surface_t *ctx = (sdl_surface_t*)surface->handle;
+    SDL_Texture *previous = SDL_GetRenderTarget(sdl_renderer);
+    SDL_Rect src = {dx, 0, surface->width - dx, surface->height};
+    SDL_Rect dest = {0, 0, surface->width - dx, surface->height};
+
+    SDL_SetRenderTarget(sdl_renderer, ctx->textures[!ctx->current]);
+    SDL_RenderCopy(sdl_renderer, ctx->textures[ctx->current], &src, &dest);
+    if (previous == ctx->textures[ctx->current]) previous = ctx->textures[!ctx->current];
+    ctx->current = !ctx->current;
+    SDL_SetRenderTarget(sdl_renderer, previous);
+}
+
+void renderer_set_target(renderer_t *renderer, surface_t *surface) {
+    if (!renderer) return;
+
+    sdl_surface_t *ctx = surface ? (sdl_surface_t*)surface->handle : NULL;
+    SDL_SetRenderTarget((SDL_Renderer*)renderer->handle, ctx ? ctx->textures[ctx->current] : NULL);
+}
+
+void renderer_draw_surface(renderer_t *renderer, surface_t *surface, int32_t x, int32_t y) {
+    if (!renderer || !surface) return;
+
+    sdl_surface_t *ctx = (sdl_surface_t*)surface->handle;
+    SDL_Rect dest = {x, y, surface->width, surface->height};
+    SDL_RenderCopy((SDL_Renderer*)renderer->handle, ctx->textures[ctx->current], NULL, &dest);
+}
+
 font_t *font_create(const char *path, int32_t size) {
     font_t *font = malloc(sizeof(font_t));
     if (!font) return NULL;
@@ -191,32 +355,170 @@ font_t *font_create(const char *path, int32_t size) {
         return NULL;
     }
 
-    font->handle = ttf_font;
+    sdl_font_t *ctx = calloc(1, sizeof(sdl_font_t));
+    if (!ctx) {
+        TTF_CloseFont(ttf_font);
+        free(font);
+        return NULL;
+    }
+    ctx->ttf = ttf_font;
+    ctx->height = TTF_FontHeight(ttf_font);
+
+    int i, advance;
+    for (i = 0; i < GLYPH_COUNT; i++) {
+        if (TTF_GlyphMetrics(ttf_font, (Uint16)(GLYPH_FIRST + i), NULL, NULL, NULL, NULL, &advance) != 0) {
+            advance = 0;
+        }
+        ctx->advances[i] = advance;
+    }
+
+    font->handle = ctx;
     return font;
 }
 
 void font_destroy(font_t *font) {
     if (!font) return;
-    TTF_CloseFont((TTF_Font*)font->handle);
+
+    sdl_font_t *ctx = (sdl_font_t*)font->handle;
+    int i;
+    for (i = 0; i < TEXT_CACHE_SIZE; i++) {
+        free(ctx->cache[i].text);
+        free(ctx->cache[i].pen_x);
+    }
+    if (ctx->atlas) SDL_DestroyTexture(ctx->atlas);
+    TTF_CloseFont(ctx->ttf);
+    free(ctx);
     free(font);
 }
 
+/* Lays text out against the atlas, or returns NULL when it has glyphs
+ * the atlas does not */
+static const sdl_text_layout_t *sdl_font_layout(sdl_font_t *ctx, const char *text) {
+    sdl_text_layout_t *layout;
+    uint32_t hash, length, i;
+    int32_t pen;
+    unsigned char c;
+
+    hash = 2166136261U;
+    for (length = 0; text[length]; length++) {
+        c = (unsigned char)text[length];
+        if (c < GLYPH_FIRST || c >= GLYPH_FIRST + GLYPH_COUNT) return NULL;
+        hash = (hash ^ c) * 16777619U;
+    }
+
+    layout = &ctx->cache[hash % TEXT_CACHE_SIZE];
+    if (layout->text && layout->hash == hash && strcmp(layout->text, text) == 0) {
+        return layout;
+    }
+
+    free(layout->text);
+    free(layout->pen_x);
+    layout->text = malloc(length + 1);
+    layout->pen_x = malloc(sizeof(int32_t) * (length + 1));
+    if (!layout->text || !layout->pen_x) {
+        free(layout->text);
+        free(layout->pen_x);
+        layout->text = NULL;
+        layout->pen_x = NULL;
+        return NULL;
+    }
+
+    memcpy(layout->text, text, length + 1);
+    pen = 0;
+    for (i = 0; i < length; i++) {
+        layout->pen_x[i] = pen;
+        pen += ctx->advances[(unsigned char)text[i] - GLYPH_FIRST];
+    }
+    layout->hash = hash;
+    layout->length = length;
+    layout->width = pen;
+    return layout;
+}
+
+/* Renders every glyph once, white, so draws only tint the texture */
+static int sdl_font_build_atlas(sdl_font_t *ctx, SDL_Renderer *sdl_renderer) {
+    SDL_Surface *glyphs[GLYPH_COUNT];
+    SDL_Color white = {255, 255, 255, 255};
+    char glyph_text[2];
+    int i, cell_w, cell_h;
+
+    if (ctx->atlas) SDL_DestroyTexture(ctx->atlas);
+    ctx->atlas = NULL;
+
+    cell_w = 1;
+    cell_h = 1;
+    glyph_text[1] = '\0';
+    for (i = 0; i < GLYPH_COUNT; i++) {
+        glyph_text[0] = (char)(GLYPH_FIRST + i);
+        glyphs[i] = TTF_RenderUTF8_Blended(ctx->ttf, glyph_text, white);
+        if (glyphs[i] && glyphs[i]->w > cell_w) cell_w = glyphs[i]->w;
+        if (glyphs[i] && glyphs[i]->h > cell_h) cell_h = glyphs[i]->h;
+    }
+
+    SDL_Surface *atlas = SDL_CreateRGBSurfaceWithFormat(0, cell_w * GLYPH_COLUMNS,
+                                                        cell_h * ((GLYPH_COUNT + GLYPH_COLUMNS - 1) / GLYPH_COLUMNS),
+                                                        32, SDL_PIXELFORMAT_RGBA32);
+    for (i = 0; i < GLYPH_COUNT; i++) {
+        ctx->cells[i].x = (i % GLYPH_COLUMNS) * cell_w;
+        ctx->cells[i].y = (i / GLYPH_COLUMNS) * cell_h;
+        ctx->cells[i].w = glyphs[i] ? glyphs[i]->w : 0;
+        ctx->cells[i].h = glyphs[i] ? glyphs[i]->h : 0;
+        if (!glyphs[i]) continue;
+        if (atlas) {
+            SDL_SetSurfaceBlendMode(glyphs[i], SDL_BLENDMODE_NONE);
+            SDL_BlitSurface(glyphs[i], NULL, atlas, &ctx->cells[i]);
+        }
+        SDL_FreeSurface(glyphs[i]);
+    }
+    if (!atlas) return 0;
+
+    ctx->atlas = SDL_CreateTextureFromSurface(sdl_renderer, atlas);
+    SDL_FreeSurface(atlas);
+    if (!ctx->atlas) return 0;
+
+    SDL_SetTextureBlendMode(ctx->atlas, SDL_BLENDMODE_BLEND);
+    ctx->atlas_renderer = sdl_renderer;
+    ctx->atlas_resets = device_resets;
+    return 1;
+}
+
 void font_draw_text(renderer_t *renderer, font_t *font, color_t color,
                     int32_t x, int32_t y, const char *text) {
     if (!renderer || !font || !text) return;
 
+    SDL_Renderer *sdl_renderer = (SDL_Renderer*)renderer->handle;
+    sdl_font_t *ctx = (sdl_font_t*)font->handle;
+    const sdl_text_layout_t *layout = sdl_font_layout(ctx, text);
+
+    if (layout && (!ctx->atlas || ctx->atlas_renderer != sdl_renderer || ctx->atlas_resets != device_resets)) {
+        if (!sdl_font_build_atlas(ctx, sdl_renderer)) layout = NULL;
+    }
+    if (layout) {
+        SDL_SetTextureColorMod(ctx->atlas, color.r, color.g, color.b);
+        SDL_SetTextureAlphaMod(ctx->atlas, color.a);
+
+        uint32_t i;
+        for (i = 0; i < layout->length; i++) {
+            const SDL_Rect *cell = &ctx->cells[(unsigned char)text[i] - GLYPH_FIRST];
+            if (cell->w == 0) continue;
+            SDL_Rect dest = {x + layout->pen_x[i], y, cell->w, cell->h};
+            SDL_RenderCopy(sdl_renderer, ctx->atlas, cell, &dest);
+        }
+        return;
+    }
+
     SDL_Color sdl_color = {color.r, color.g, color.b, color.a};
-    SDL_Surface *surface = TTF_RenderUTF8_Blended((TTF_Font*)font->handle, text, sdl_color);
+    SDL_Surface *surface = TTF_RenderUTF8_Blended(ctx->ttf, text, sdl_color);
     if (!surface) return;
 
-    SDL_Texture *texture = SDL_CreateTextureFromSurface((SDL_Renderer*)renderer->handle, surface);
+    SDL_Texture *texture = SDL_CreateTextureFromSurface(sdl_renderer, surface);
     if (!texture) {
         SDL_FreeSurface(surface);
         return;
     }
 
     SDL_Rect dest = {x, y, surface->w, surface->h};
-    SDL_RenderCopy((SDL_Renderer*)renderer->handle, texture, NULL, &dest);
+    SDL_RenderCopy(sdl_renderer, texture, NULL, &dest);
 
     SDL_DestroyTexture(texture);
     SDL_FreeSurface(surface);
@@ -225,8 +527,16 @@ void font_draw_text(renderer_t *renderer, font_t *font, color_t color,
 void font_get_text_size(font_t *font, const char *text, int32_t *width, int32_t *height) {
     if (!font || !text) return;
 
+    sdl_font_t *ctx = (sdl_font_t*)font->handle;
+    const sdl_text_layout_t *layout = sdl_font_layout(ctx, text);
+    if (layout) {
+        if (width) *width = layout->width;
+        if (height) *height = ctx->height;
+        return;
+    }
+
     int w, h;
-    if (TTF_SizeUTF8((TTF_Font*)font->handle, text, &w, &h) == 0) {
+    if (TTF_SizeUTF8(ctx->ttf, text, &w, &h) == 0) {
         if (width) *width = w;
         if (height) *height = h;
     }
@@ -248,9 +558,20 @@ int graphics_wait_events(void) {
     extern int config_get_max_fps(void);
     int fps = config_get_max_fps();
     if (fps <= 0) fps = 1;
-    Uint32 timeout_ms = 1000 / fps;
+    Uint32 interval_ms = 1000 / fps;
+
+    /* block until input, a graphics_wakeup() or the idle time */
+    int have_event = SDL_WaitEventTimeout(&event, GRAPHICS_IDLE_MS);
 
-    if (SDL_WaitEventTimeout(&event, timeout_ms)) {
+    /* coalesce bursts of samples to max_fps */
+    Uint32 elapsed_ms = SDL_GetTicks() - last_wait_time;
+    if (elapsed_ms < interval_ms) {
+        SDL_Delay(interval_ms - elapsed_ms);
+    }
+    last_wait_time = SDL_GetTicks();
+    SDL_AtomicSet(&wakeup_pending, 0);
+
+    if (have_event) {
         do {
             switch (event.type) {
                 case SDL_QUIT:
@@ -258,8 +579,18 @@ int graphics_wait_events(void) {
                 case SDL_WINDOWEVENT:
                     if (event.window.event == SDL_WINDOWEVENT_RESIZED) {
                         window_resized = 1;
+                    } else if (event.window.event == SDL_WINDOWEVENT_EXPOSED &&
+                               pending_event.type == GRAPHICS_EVENT_NONE) {
+                        pending_event.type = GRAPHICS_EVENT_REFRESH;
                     }
                     break;
+                case SDL_RENDER_DEVICE_RESET:
+                    device_resets++;
+                    /* fall through */
+                case SDL_RENDER_TARGETS_RESET:
+                    /* surfaces lost their pixels, so redraw as after a resize */
+                    window_resized = 1;
+                    break;
                 case SDL_KEYDOWN:
                     switch (event.key.keysym.sym) {
                         case SDLK_q:
@@ -293,6 +624,16 @@ int graphics_wait_events(void) {
     return 1;
 }
 
+void graphics_wakeup(void) {
+    SDL_Event event;
+
+    if (!SDL_AtomicCAS(&wakeup_pending, 0, 1)) return;
+
+    SDL_zero(event);
+    event.type = SDL_USEREVENT;
+    SDL_PushEvent(&event);
+}
+
 int graphics_get_event(graphics_event_t *event) {
     if (!event) return 0;
 
@@ -17,6 +17,8 @@ typedef struct {
     HDC mem_dc;
     HBITMAP mem_bitmap;
     HBITMAP old_bitmap;
+    HBITMAP target;         /* surface bitmap selected into mem_dc, or NULL */
+    HDC blit_dc;            /* scratch DC for copying from surfaces */
     int width;
     int height;
     HWND hwnd;
@@ -36,6 +38,8 @@ static int32_t current_mouse_x = 0;
 static int32_t current_mouse_y = 0;
 static unsigned int timer_id = 0;
 static int current_fps = 60;
+static HANDLE wakeup_event = NULL;     /* auto-reset, set by graphics_wakeup() */
+static DWORD last_wait_time = 0;
 
 static uint32_t frame_count = 0;
 static uint32_t fps_last_time = 0;
@@ -88,6 +92,10 @@ static LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM l
             PAINTSTRUCT ps;
             BeginPaint(hwnd, &ps);
             EndPaint(hwnd, &ps);
+            /* uncovered: present the frame again */
+            if (pending_event.type == GRAPHICS_EVENT_NONE) {
+                pending_event.type = GRAPHICS_EVENT_REFRESH;
+            }
             return 0;
         }
 
@@ -119,6 +127,8 @@ int graphics_init(void) {
     frame_count = 0;
     fps_value = 0.0f;
 
+    wakeup_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+
     gdi_initialized = 1;
     return 1;
 }
@@ -126,6 +136,10 @@ int graphics_init(void) {
 void graphics_cleanup(void) {
     if (!gdi_initialized) return;
     UnregisterClass(WINDOW_CLASS_NAME, GetModuleHandle(NULL));
+    if (wakeup_event) {
+        CloseHandle(wakeup_event);
+        wakeup_event = NULL;
+    }
     gdi_initialized = 0;
 }
 
@@ -273,6 +287,8 @@ renderer_t *renderer_create(window_t *window) {
     renderer->height = rect.bottom - rect.top;
     renderer->mem_bitmap = CreateCompatibleBitmap(hdc, renderer->width, renderer->height);
     renderer->old_bitmap = (HBITMAP)SelectObject(renderer->mem_dc, renderer->mem_bitmap);
+    renderer->target = NULL;
+    renderer->blit_dc = CreateCompatibleDC(hdc);
     renderer->hwnd = win->hwnd;
     renderer->current_pen = NULL;
     renderer->current_brush = NULL;
@@ -292,6 +308,7 @@ void renderer_destroy(renderer_t *renderer) {
     if (r->old_bitmap) SelectObject(r->mem_dc, r->old_bitmap);
     if (r->mem_bitmap) DeleteObject(r->mem_bitmap);
     if (r->mem_dc) DeleteDC(r->mem_dc);
+    if (r->blit_dc) DeleteDC(r->blit_dc);
     if (r->hdc) ReleaseDC(r->hwnd, r->hdc);
 
     free(r);
@@ -339,6 +356,34 @@ void renderer_present(renderer_t *renderer) {
     BitBlt(r->hdc, 0, 0, r->width, r->height, r->mem_dc, 0, 0, SRCCOPY);
 }
 
+int renderer_keeps_frame(renderer_t *renderer) {
+    (void)renderer;
+    return 1;
+}
+
+void renderer_present_rects(renderer_t *renderer, const rect_t *rects, uint32_t count) {
+    win32_renderer_t *r;
+    RECT rect;
+    uint32_t i;
+
+    if (!renderer) return;
+
+    r = (win32_renderer_t*)renderer;
+
+    /* a resized client area needs the back buffer resized with it */
+    GetClientRect(r->hwnd, &rect);
+    if (rect.right != r->width || rect.bottom != r->height) {
+        renderer_present(renderer);
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (rects[i].w <= 0 || rects[i].h <= 0) continue;
+        BitBlt(r->hdc, rects[i].x, rects[i].y, rects[i].w, rects[i].h,
+               r->mem_dc, rects[i].x, rects[i].y, SRCCOPY);
+    }
+}
+
 void renderer_set_color(renderer_t *renderer, color_t color) {
     win32_renderer_t *r;
 
@@ -396,6 +441,134 @@ void renderer_fill_rect(renderer_t *renderer, rect_t rect) {
     FillRect(r->mem_dc, &r_rect, r->current_brush);
 }
 
+/* GDI has no batch fill for brushes, but segments go as one PolyPolyline */
+#define WIN32_BATCH 256
+
+void renderer_draw_lines(renderer_t *renderer, const line_t *lines, uint32_t count) {
+    win32_renderer_t *r;
+    POINT points[WIN32_BATCH * 2];
+    DWORD counts[WIN32_BATCH];
+    uint32_t i, n;
+
+    if (!renderer || !lines) return;
+
+    r = (win32_renderer_t*)renderer;
+
+    while (count > 0) {
+        n = (count < WIN32_BATCH) ? count : WIN32_BATCH;
+        for (i = 0; i < n; i++) {
+            points[i * 2].x = lines[i].x1;
+            points[i * 2].y = lines[i].y1;
+            points[i * 2 + 1].x = lines[i].x2;
+            points[i * 2 + 1].y = lines[i].y2;
+            counts[i] = 2;
+        }
+        PolyPolyline(r->mem_dc, points, counts, (DWORD)n);
+        lines += n;
+        count -= n;
+    }
+}
+
+void renderer_fill_rects(renderer_t *renderer, const rect_t *rects, uint32_t count) {
+    win32_renderer_t *r;
+    RECT r_rect;
+    uint32_t i;
+
+    if (!renderer || !rects) return;
+
+    r = (win32_renderer_t*)renderer;
+
+    for (i = 0; i < count; i++) {
+        r_rect.left = rects[i].x;
+        r_rect.top = rects[i].y;
+        r_rect.right = rects[i].x + rects[i].w;
+        r_rect.bottom = rects[i].y + rects[i].h;
+        FillRect(r->mem_dc, &r_rect, r->current_brush);
+    }
+}
+
+/* A bitmap is only ever selected into one DC, so the surface that is the
+ * target is reached through mem_dc and any other through blit_dc */
+static HDC win32_surface_dc(win32_renderer_t *r, HBITMAP bitmap, HBITMAP *old) {
+    if (r->target == bitmap) {
+        *old = NULL;
+        return r->mem_dc;
+    }
+    *old = (HBITMAP)SelectObject(r->blit_dc, bitmap);
+    return r->blit_dc;
+}
+
+surface_t *surface_create(renderer_t *renderer, int32_t width, int32_t height) {
+    win32_renderer_t *r;
+    surface_t *surface;
+    HBITMAP bitmap;
+
+    if (!renderer || width <= 0 || height <= 0) return NULL;
+
+    r = (win32_renderer_t*)renderer;
+    if (!r->blit_dc) return NULL;
+
+    bitmap = CreateCompatibleBitmap(r->hdc, width, height);
+    if (!bitmap) return NULL;
+
+    surface = (surface_t*)malloc(sizeof(surface_t));
+    if (!surface) {
+        DeleteObject(bitmap);
+        return NULL;
+    }
+
+    surface->handle = bitmap;
+    surface->width = width;
+    surface->height = height;
+    return surface;
+}
+
+void surface_destroy(renderer_t *renderer, surface_t *surface) {
+    if (!renderer || !surface) return;
+
+    if (((win32_renderer_t*)renderer)->target == (HBITMAP)surface->handle) {
+        renderer_set_target(renderer, NULL);
+    }
+    DeleteObject((HBITMAP)surface->handle);
+    free(surface);
+}
+
+void surface_scroll(renderer_t *renderer, surface_t *surface, int32_t dx) {
+    win32_renderer_t *r;
+    HBITMAP old;
+    HDC dc;
+
+    if (!renderer || !surface || dx <= 0 || dx >= surface->width) return;
+
+    r = (win32_renderer_t*)renderer;
+    dc = win32_surface_dc(r, (HBITMAP)surface->handle, &old);
+    BitBlt(dc, 0, 0, surface->width - dx, surface->height, dc, dx, 0, SRCCOPY);
+    if (old) SelectObject(r->blit_dc, old);
+}
+
+void renderer_set_target(renderer_t *renderer, surface_t *surface) {
+    win32_renderer_t *r;
+
+    if (!renderer) return;
+
+    r = (win32_renderer_t*)renderer;
+    r->target = surface ? (HBITMAP)surface->handle : NULL;
+    SelectObject(r->mem_dc, r->target ? r->target : r->mem_bitmap);
+}
+
+void renderer_draw_surface(renderer_t *renderer, surface_t *surface, int32_t x, int32_t y) {
+    win32_renderer_t *r;
+    HBITMAP old;
+    HDC dc;
+
+    if (!renderer || !surface) return;
+
+    r = (win32_renderer_t*)renderer;
+    dc = win32_surface_dc(r, (HBITMAP)surface->handle, &old);
+    BitBlt(r->mem_dc, x, y, surface->width, surface->height, dc, 0, 0, SRCCOPY);
+    if (old) SelectObject(r->blit_dc, old);
+}
+
 font_t *font_create(const char *path, int32_t size) {
     win32_font_t *font;
     HFONT hfont;
@@ -492,17 +665,24 @@ int graphics_poll_events(void) {
 
 int graphics_wait_events(void) {
     MSG msg;
-    DWORD timeout_ms;
-    DWORD result;
+    DWORD interval_ms;
+    DWORD elapsed_ms;
 
-    timeout_ms = (DWORD)(1000 / current_fps);
+    interval_ms = (DWORD)(1000 / current_fps);
 
-    result = MsgWaitForMultipleObjects(0, NULL, FALSE, timeout_ms, QS_ALLINPUT);
+    /* block until input, a graphics_wakeup() or the idle time */
+    if (wakeup_event) {
+        MsgWaitForMultipleObjects(1, &wakeup_event, FALSE, GRAPHICS_IDLE_MS, QS_ALLINPUT);
+    } else {
+        MsgWaitForMultipleObjects(0, NULL, FALSE, interval_ms, QS_ALLINPUT);
+    }
 
-    if (result == WAIT_TIMEOUT) {
-        pending_event.type = GRAPHICS_EVENT_REFRESH;
-        return 1;
+    /* coalesce bursts of samples to max_fps */
+    elapsed_ms = GetTickCount() - last_wait_time;
+    if (elapsed_ms < interval_ms) {
+        Sleep(interval_ms - elapsed_ms);
     }
+    last_wait_time = GetTickCount();
 
     while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
         if (msg.message == WM_QUIT) {
@@ -515,6 +695,10 @@ int graphics_wait_events(void) {
     return 1;
 }
 
+void graphics_wakeup(void) {
+    if (wakeup_event) SetEvent(wakeup_event);
+}
+
 int graphics_get_event(graphics_event_t *event) {
     if (!event) return 0;
 
@@ -13,6 +13,13 @@
 #include <sys/time.h>
 #include <unistd.h>
 #include <string.h>
+#ifndef __VMS
+#include <sys/types.h>
+#include <fcntl.h>
+#ifdef LINUX
+#include <sys/eventfd.h>
+#endif
+#endif
 
 typedef struct {
     uint8_t r, g, b, a;
@@ -41,8 +48,13 @@ typedef struct {
     x11_window_context_t *window_context;
     unsigned long current_color;
     unsigned long last_set_color;
+    Drawable target;        /* surface pixmap, None = window pixmap */
 } x11_renderer_context_t;
 
+typedef struct {
+    Pixmap pixmap;
+} x11_surface_t;
+
 typedef struct {
     XFontStruct *font_struct;
     Display *display;
@@ -57,6 +69,14 @@ static int fullscreen_state = 0;
 static int32_t current_mouse_x = 0;
 static int32_t current_mouse_y = 0;
 static uint64_t last_mouse_motion_time = 0;
+static uint64_t last_wait_time = 0;
+
+/* graphics_wakeup() makes this readable: an eventfd on Linux, a pipe on
+ * other Unix. VMS cannot select() on either and keeps polling. */
+#ifndef __VMS
+static int wakeup_read_fd = -1;
+static int wakeup_write_fd = -1;
+#endif
 
 static uint32_t frame_count = 0;
 static uint64_t fps_last_time = 0;
@@ -68,6 +88,10 @@ static uint64_t x11_get_time_ms(void) {
     return (uint64_t)tv.tv_sec * 1000 + (uint64_t)tv.tv_usec / 1000;
 }
 
+static Drawable x11_target(x11_renderer_context_t *ctx) {
+    return ctx->target != None ? ctx->target : ctx->window_context->pixmap;
+}
+
 static unsigned long x11_create_color_cached(x11_window_context_t *ctx, color_t color) {
     Colormap colormap;
     XColor xcolor;
@@ -117,12 +141,34 @@ int graphics_init(void) {
     frame_count = 0;
     current_fps = 0.0f;
 
+#ifndef __VMS
+#ifdef LINUX
+    wakeup_read_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    wakeup_write_fd = wakeup_read_fd;
+#else
+    {
+        int fds[2];
+        if (pipe(fds) == 0) {
+            fcntl(fds[0], F_SETFL, O_NONBLOCK);
+            fcntl(fds[1], F_SETFL, O_NONBLOCK);
+            wakeup_read_fd = fds[0];
+            wakeup_write_fd = fds[1];
+        }
+    }
+#endif
+#endif
+
     x11_initialized = 1;
     return 1;
 }
 
 void graphics_cleanup(void) {
     if (!x11_initialized) return;
+#ifndef __VMS
+    if (wakeup_write_fd >= 0 && wakeup_write_fd != wakeup_read_fd) close(wakeup_write_fd);
+    if (wakeup_read_fd >= 0) close(wakeup_read_fd);
+    wakeup_read_fd = wakeup_write_fd = -1;
+#endif
     x11_initialized = 0;
 }
 
@@ -172,6 +218,8 @@ window_t *window_create(const char *title, int32_t width, int32_t height) {
                                DefaultDepth(ctx->display, ctx->screen));
 
     ctx->gc = XCreateGC(ctx->display, ctx->pixmap, 0, NULL);
+    /* every copy is pixmap to drawable, so NoExpose events are just noise */
+    XSetGraphicsExposures(ctx->display, ctx->gc, False);
     XSetBackground(ctx->display, ctx->gc, ctx->bg_color);
     XSetForeground(ctx->display, ctx->gc, BlackPixel(ctx->display, ctx->screen));
 
@@ -368,6 +416,7 @@ renderer_t *renderer_create(window_t *window) {
     ctx->window_context = (x11_window_context_t*)window->handle;
     ctx->current_color = BlackPixel(ctx->window_context->display, ctx->window_context->screen);
     ctx->last_set_color = ctx->current_color;
+    ctx->target = None;
 
     renderer->handle = ctx;
     return renderer;
@@ -421,6 +470,33 @@ void renderer_present(renderer_t *renderer) {
     XFlush(ctx->window_context->display);
 }
 
+int renderer_keeps_frame(renderer_t *renderer) {
+    (void)renderer;
+    return 1;
+}
+
+void renderer_present_rects(renderer_t *renderer, const rect_t *rects, uint32_t count) {
+    x11_renderer_context_t *ctx;
+    uint32_t i;
+
+    if (!renderer) return;
+
+    ctx = (x11_renderer_context_t*)renderer->handle;
+
+    for (i = 0; i < count; i++) {
+        if (rects[i].w <= 0 || rects[i].h <= 0) continue;
+        XCopyArea(ctx->window_context->display,
+                  ctx->window_context->pixmap,
+                  ctx->window_context->window,
+                  ctx->window_context->gc,
+                  rects[i].x, rects[i].y,
+                  (unsigned int)rects[i].w, (unsigned int)rects[i].h,
+                  rects[i].x, rects[i].y);
+    }
+
+    XFlush(ctx->window_context->display);
+}
+
 void renderer_set_color(renderer_t *renderer, color_t color) {
     x11_renderer_context_t *ctx;
 
@@ -446,7 +522,7 @@ void renderer_draw_line(renderer_t *renderer, int32_t x1, int32_t y1, int32_t x2
     seg.y1 = y1;
     seg.x2 = x2;
     seg.y2 = y2;
-    XDrawSegments(ctx->window_context->display, ctx->window_context->pixmap,
+    XDrawSegments(ctx->window_context->display, x11_target(ctx),
                   ctx->window_context->gc, &seg, 1);
 }
 
@@ -460,7 +536,7 @@ void renderer_draw_rect(renderer_t *renderer, rect_t rect) {
         XSetForeground(ctx->window_context->display, ctx->window_context->gc, ctx->current_color);
         ctx->last_set_color = ctx->current_color;
     }
-    XDrawRectangle(ctx->window_context->display, ctx->window_context->pixmap,
+    XDrawRectangle(ctx->window_context->display, x11_target(ctx),
                    ctx->window_context->gc, rect.x, rect.y, rect.w, rect.h);
 }
 
@@ -474,10 +550,150 @@ void renderer_fill_rect(renderer_t *renderer, rect_t rect) {
         XSetForeground(ctx->window_context->display, ctx->window_context->gc, ctx->current_color);
         ctx->last_set_color = ctx->current_color;
     }
-    XFillRectangle(ctx->window_context->display, ctx->window_context->pixmap,
+    XFillRectangle(ctx->window_context->display, x11_target(ctx),
                    ctx->window_context->gc, rect.x, rect.y, rect.w, rect.h);
 }
 
+/* Converted in chunks, each one request */
+#define X11_BATCH 256
+
+void renderer_draw_lines(renderer_t *renderer, const line_t *lines, uint32_t count) {
+    x11_renderer_context_t *ctx;
+    XSegment segs[X11_BATCH];
+    uint32_t i, n;
+
+    if (!renderer || !lines) return;
+
+    ctx = (x11_renderer_context_t*)renderer->handle;
+    if (ctx->current_color != ctx->last_set_color) {
+        XSetForeground(ctx->window_context->display, ctx->window_context->gc, ctx->current_color);
+        ctx->last_set_color = ctx->current_color;
+    }
+
+    while (count > 0) {
+        n = (count < X11_BATCH) ? count : X11_BATCH;
+        for (i = 0; i < n; i++) {
+            segs[i].x1 = lines[i].x1;
+            segs[i].y1 = lines[i].y1;
+            segs[i].x2 = lines[i].x2;
+            segs[i].y2 = lines[i].y2;
+        }
+        XDrawSegments(ctx->window_context->display, x11_target(ctx),
+                      ctx->window_context->gc, segs, (int)n);
+        lines += n;
+        count -= n;
+    }
+}
+
+void renderer_fill_rects(renderer_t *renderer, const rect_t *rects, uint32_t count) {
+    x11_renderer_context_t *ctx;
+    XRectangle xrects[X11_BATCH];
+    uint32_t i, n;
+
+    if (!renderer || !rects) return;
+
+    ctx = (x11_renderer_context_t*)renderer->handle;
+    if (ctx->current_color != ctx->last_set_color) {
+        XSetForeground(ctx->window_context->display, ctx->window_context->gc, ctx->current_color);
+        ctx->last_set_color = ctx->current_color;
+    }
+
+    while (count > 0) {
+        n = (count < X11_BATCH) ? count : X11_BATCH;
+        for (i = 0; i < n; i++) {
+            xrects[i].x = rects[i].x;
+            xrects[i].y = rects[i].y;
+            xrects[i].width = rects[i].w;
+            xrects[i].height = rects[i].h;
+        }
+        XFillRectangles(ctx->window_context->display, x11_target(ctx),
+                        ctx->window_context->gc, xrects, (int)n);
+        rects += n;
+        count -= n;
+    }
+}
+
+surface_t *surface_create(renderer_t *renderer, int32_t width, int32_t height) {
+    x11_renderer_context_t *ctx;
+    x11_surface_t *sctx;
+    surface_t *surface;
+
+    if (!renderer || width <= 0 || height <= 0) return NULL;
+
+    ctx = (x11_renderer_context_t*)renderer->handle;
+
+    surface = malloc(sizeof(surface_t));
+    if (!surface) return NULL;
+
+    sctx = malloc(sizeof(x11_surface_t));
+    if (!sctx) {
+        free(surface);
+        return NULL;
+    }
+
+    sctx->pixmap = XCreatePixmap(ctx->window_context->display, ctx->window_context->window,
+                                 width, height, DefaultDepth(ctx->window_context->display,
+                                                             ctx->window_context->screen));
+
+    surface->handle = sctx;
+    surface->width = width;
+    surface->height = height;
+    return surface;
+}
+
+void surface_destroy(renderer_t *renderer, surface_t *surface) {
+    x11_renderer_context_t *ctx;
+    x11_surface_t *sctx;
+
+    if (!renderer || !surface) return;
+
+    ctx = (x11_renderer_context_t*)renderer->handle;
+    sctx = (x11_surface_t*)surface->handle;
+
+    if (ctx->target == sctx->pixmap) {
+        ctx->target = None;
+    }
+    XFreePixmap(ctx->window_context->display, sctx->pixmap);
+    free(sctx);
+    free(surface);
+}
+
+/* XCopyArea copes with overlapping source and destination */
+void surface_scroll(renderer_t *renderer, surface_t *surface, int32_t dx) {
+    x11_renderer_context_t *ctx;
+    x11_surface_t *sctx;
+
+    if (!renderer || !surface || dx <= 0 || dx >= surface->width) return;
+
+    ctx = (x11_renderer_context_t*)renderer->handle;
+    sctx = (x11_surface_t*)surface->handle;
+
+    XCopyArea(ctx->window_context->display, sctx->pixmap, sctx->pixmap, ctx->window_context->gc,
+              dx, 0, surface->width - dx, surface->height, 0, 0);
+}
+
+void renderer_set_target(renderer_t *renderer, surface_t *surface) {
+    x11_renderer_context_t *ctx;
+
+    if (!renderer) return;
+
+    ctx = (x11_renderer_context_t*)renderer->handle;
+    ctx->target = surface ? ((x11_surface_t*)surface->handle)->pixmap : None;
+}
+
+void renderer_draw_surface(renderer_t *renderer, surface_t *surface, int32_t x, int32_t y) {
+    x11_renderer_context_t *ctx;
+    x11_surface_t *sctx;
+
+    if (!renderer || !surface) return;
+
+    ctx = (x11_renderer_context_t*)renderer->handle;
+    sctx = (x11_surface_t*)surface->handle;
+
+    XCopyArea(ctx->window_context->display, sctx->pixmap, x11_target(ctx), ctx->window_context->gc,
+              0, 0, surface->width, surface->height, x, y);
+}
+
 font_t *font_create(const char *path, int32_t size) {
     font_t *font;
     x11_font_context_t *ctx;
@@ -614,7 +830,7 @@ void font_draw_text(renderer_t *renderer, font_t *font, color_t color,
 
     y += fctx->font_struct->ascent;
 
-    XDrawString(rctx->window_context->display, rctx->window_context->pixmap,
+    XDrawString(rctx->window_context->display, x11_target(rctx),
                 rctx->window_context->gc, x, y, text, strlen(text));
 }
 
@@ -642,6 +858,12 @@ int graphics_poll_events(void) {
 
         switch (event.type) {
             case Expose:
+                /* the pixmap still holds the last frame */
+                if (event.xexpose.count == 0) {
+                    XCopyArea(x11_active_window->display, x11_active_window->pixmap,
+                              x11_active_window->window, x11_active_window->gc,
+                              0, 0, x11_active_window->width, x11_active_window->height, 0, 0);
+                }
                 break;
             case ConfigureNotify:
                 if (event.xconfigure.width != x11_active_window->width ||
@@ -706,12 +928,36 @@ int graphics_poll_events(void) {
     return !x11_active_window->should_quit;
 }
 
+void graphics_wakeup(void) {
+#ifndef __VMS
+#ifdef LINUX
+    uint64_t one = 1;
+    ssize_t written;
+
+    if (wakeup_write_fd < 0) return;
+    written = write(wakeup_write_fd, &one, sizeof(one));
+#else
+    char byte = 0;
+    ssize_t written;
+
+    if (wakeup_write_fd < 0) return;
+    written = write(wakeup_write_fd, &byte, 1);
+#endif
+    (void)written;      /* a full pipe is already a pending wakeup */
+#endif
+}
+
 int graphics_wait_events(void) {
     extern int config_get_max_fps(void);
     int fps;
-    int sleep_us;
+    uint32_t interval_ms;
     uint64_t current_time;
-    uint64_t time_since_mouse_motion;
+#ifndef __VMS
+    char drain[64];
+    struct timeval timeout;
+    fd_set fds;
+    int xfd, nfds;
+#endif
 
     if (!x11_active_window) return 1;
 
@@ -722,17 +968,40 @@ int graphics_wait_events(void) {
     fps = config_get_max_fps();
     if (fps <= 0) fps = 1;
 
-    current_time = x11_get_time_ms();
-    time_since_mouse_motion = current_time - last_mouse_motion_time;
+#ifndef __VMS
+    /* nothing queued: sleep until the server or a collector has news */
+    if (wakeup_read_fd >= 0 && XPending(x11_active_window->display) == 0) {
+        xfd = ConnectionNumber(x11_active_window->display);
+        FD_ZERO(&fds);
+        FD_SET(xfd, &fds);
+        FD_SET(wakeup_read_fd, &fds);
+        nfds = (xfd > wakeup_read_fd ? xfd : wakeup_read_fd) + 1;
+        timeout.tv_sec = GRAPHICS_IDLE_MS / 1000;
+        timeout.tv_usec = (GRAPHICS_IDLE_MS % 1000) * 1000;
+        select(nfds, &fds, NULL, NULL, &timeout);
+    }
+#endif
 
-    if (time_since_mouse_motion < 1000) {
-        sleep_us = 16000;
+    /* then hold off until a frame after the last one, faster while the
+     * mouse moves, so a burst of samples is drawn once */
+    current_time = x11_get_time_ms();
+    if (current_time - last_mouse_motion_time < 1000) {
+        interval_ms = 16;
     } else {
-        sleep_us = 1000000 / fps;
+        interval_ms = 1000 / (uint32_t)fps;
     }
+    if (interval_ms < 1) interval_ms = 1;
+    if (current_time - last_wait_time < interval_ms) {
+        os_sleep(interval_ms - (uint32_t)(current_time - last_wait_time));
+    }
+    last_wait_time = x11_get_time_ms();
 
-    if (sleep_us < 1000) sleep_us = 1000;
-    os_sleep((uint32_t)(sleep_us / 1000));
+#ifndef __VMS
+    if (wakeup_read_fd >= 0) {
+        while (read(wakeup_read_fd, drain, sizeof(drain)) > 0)
+            ;
+    }
+#endif
 
     return graphics_poll_events();
 }
@@ -11,6 +11,10 @@ typedef struct {
     int32_t x, y, w, h;
 } rect_t;
 
+typedef struct {
+    int32_t x1, y1, x2, y2;
+} line_t;
+
 typedef struct {
     void *handle;
 } font_t;
@@ -23,6 +27,15 @@ typedef struct {
     void *handle;
 } renderer_t;
 
+/* Offscreen pixels that survive between frames, so a plot can scroll what
+ * it drew instead of drawing it again. Drawing goes to the surface set as
+ * target, in its own coordinates; a NULL target is the window. Backends
+ * that cannot keep offscreen pixels return NULL from surface_create. */
+typedef struct {
+    void *handle;
+    int32_t width, height;
+} surface_t;
+
 int graphics_init(void);
 void graphics_cleanup(void);
 
@@ -38,10 +51,25 @@ renderer_t *renderer_create(window_t *window);
 void renderer_destroy(renderer_t *renderer);
 void renderer_clear(renderer_t *renderer, color_t color);
 void renderer_present(renderer_t *renderer);
+/* Where the backend keeps the frame between presents, only the parts
+ * that changed need drawing, and only those rects are put on screen.
+ * Elsewhere renderer_present_rects shows the whole frame. */
+int renderer_keeps_frame(renderer_t *renderer);
+void renderer_present_rects(renderer_t *renderer, const rect_t *rects, uint32_t count);
 void renderer_set_color(renderer_t *renderer, color_t color);
 void renderer_draw_line(renderer_t *renderer, int32_t x1, int32_t y1, int32_t x2, int32_t y2);
 void renderer_draw_rect(renderer_t *renderer, rect_t rect);
 void renderer_fill_rect(renderer_t *renderer, rect_t rect);
+/* Batches in the current color: one call per color run, drawn natively
+ * by each backend rather than one primitive at a time */
+void renderer_draw_lines(renderer_t *renderer, const line_t *lines, uint32_t count);
+void renderer_fill_rects(renderer_t *renderer, const rect_t *rects, uint32_t count);
+
+surface_t *surface_create(renderer_t *renderer, int32_t width, int32_t height);
+void surface_destroy(renderer_t *renderer, surface_t *surface);
+void surface_scroll(renderer_t *renderer, surface_t *surface, int32_t dx);    /* left; exposed columns are undefined */
+void renderer_set_target(renderer_t *renderer, surface_t *surface);
+void renderer_draw_surface(renderer_t *renderer, surface_t *surface, int32_t x, int32_t y);
 
 font_t *font_create(const char *path, int32_t size);
 void font_destroy(font_t *font);
@@ -71,8 +99,15 @@ typedef struct {
     int32_t mouse_y;
 } graphics_event_t;
 
+/* Longest graphics_wait_events() blocks with no input and no wakeup */
+#define GRAPHICS_IDLE_MS 1000
+
 int graphics_poll_events(void);
+/* Blocks until input arrives, graphics_wakeup() is called or the idle
+ * time passes; returns are kept at least a max_fps frame apart so that
+ * whatever lands in between is handled as one */
 int graphics_wait_events(void);
+void graphics_wakeup(void);     /* safe from any thread */
 int graphics_get_event(graphics_event_t *event);
 void graphics_start_render_timer(int fps);
 void graphics_stop_render_timer(void);
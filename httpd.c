@@ -451,29 +451,41 @@ static struct {
     char hostname[256];
 } httpd;
 
-static double snap_vals[2048];
-static double snap_vals2[2048];
-static uint32_t snap_ts[2048];
+/* The chart being drawn reduced to pixel columns, one array per series;
+ * httpd thread only */
+static ringbuf_m4_t chart_m4[RINGBUF_MAX_COLUMNS][2048];
+static ringbuf_m4_t *const chart_columns[RINGBUF_MAX_COLUMNS] = { chart_m4[0], chart_m4[1] };
+static uint32_t chart_timestamps[2048];
+static const double chart_quantiles[3] = { 0.50, 0.95, 0.99 };
 
 static void render_chart(fb_t *fb, uint32_t idx, int32_t x, int32_t y, int32_t width, int32_t height) {
     config_t *config;
     plot_config_t *pc;
     data_source_t *source;
     datasource_handler_t *handler;
-    datasource_stats_t stats;
+    ringbuf_stats_t stats, stats2;
+    double quantile_values[3];
+    char quantile_text[3][32], tail_text[128];
+    int32_t tail_x;
     uint8_t text_ci, border_ci, line_ci, line2_ci, err_ci;
     char title[256], temp[256];
     char *local_pos;
     size_t prefix_len;
     int32_t plot_y, plot_height, plot_bottom, plot_x, plot_max_offset;
-    int32_t bar_height, in_bar_height, out_bar_height, out_y;
+    int32_t bar_height, in_bar_height, out_y, out_top, out_bottom;
     int32_t prev_out_x, prev_out_y, pixel_offset;
-    uint32_t data_count, data_count2, head, tail, dual_count, i;
+    ringbuf_span_t span;
+    const ringbuf_m4_t *col, *in_col, *out_col;
+    uint32_t data_count, i;
+    int whole_ring;
     uint32_t now_ms, total_time_ms, minutes, hours, days;
-    double max_val, fixed_max_scale, value, in_value, out_value;
+    double max_val, fixed_max_scale;
     const char *unit;
     char scale_text[64], stats_text[128], time_span_text[64], formatted[64];
     int32_t refresh_interval;
+    uint32_t span_ms;
+    double ms_per_px;
+    int span_source;
 
     config = httpd.config;
     pc = &config->plots[idx];
@@ -515,31 +527,39 @@ static void render_chart(fb_t *fb, uint32_t idx, int32_t x, int32_t y, int32_t w
         unit = "";
     }
 
-    if (!ringbuf_read_snapshot(source->data_buffer, snap_vals, snap_ts, 2048,
-                               &data_count, &head, &tail))
-        return;
-    data_count2 = 0;
-    if (source->is_dual && source->data_buffer_secondary) {
-        if (!ringbuf_read_snapshot(source->data_buffer_secondary, snap_vals2, NULL, 2048,
-                                   &data_count2, &head, &tail))
-            return;
-    }
-
     now_ms = os_get_time_ms();
     refresh_interval = (pc->refresh_interval_ms > 0) ?
                        pc->refresh_interval_ms : config->refresh_interval_ms;
     plot_max_offset = width - 3;
     if (plot_max_offset < 0) plot_max_offset = 0;
 
+    span_ms = pc->span_ms ? pc->span_ms : config->span_ms;
+    if (span_ms == 0) span_ms = (uint32_t)plot_max_offset * (uint32_t)refresh_interval;
+    ms_per_px = (plot_max_offset > 0) ? (double)span_ms / plot_max_offset : 1.0;
+    if (ms_per_px < 1.0) ms_per_px = 1.0;
+
+    span_source = ringbuf_span_source(source->data_buffer, now_ms, span_ms, (uint32_t)refresh_interval);
+    if (!ringbuf_read_span(source->data_buffer, span_source, now_ms, span_ms, ms_per_px,
+                           chart_columns, chart_timestamps, 2048, &span))
+        return;
+    data_count = span.count;
+    whole_ring = span.whole_ring;
+
+    memset(&stats, 0, sizeof(stats));
+    memset(&stats2, 0, sizeof(stats2));
+    ringbuf_get_stats(source->data_buffer, 0, &stats);
+    if (source->is_dual) ringbuf_get_stats(source->data_buffer, 1, &stats2);
+
     if (fixed_max_scale > 0.0) {
         max_val = fixed_max_scale;
+    } else if (whole_ring) {
+        max_val = (stats2.max > stats.max) ? stats2.max : stats.max;
+        if (max_val <= 0.0) max_val = 1.0;
     } else {
         max_val = 0.0;
         for (i = 0; i < data_count; i++) {
-            if (snap_vals[i] > max_val) max_val = snap_vals[i];
-        }
-        for (i = 0; i < data_count2; i++) {
-            if (snap_vals2[i] > max_val) max_val = snap_vals2[i];
+            if (chart_columns[0][i].count > 0 && chart_columns[0][i].max > max_val) max_val = chart_columns[0][i].max;
+            if (source->is_dual && chart_columns[1][i].count > 0 && chart_columns[1][i].max > max_val) max_val = chart_columns[1][i].max;
         }
         if (max_val <= 0.0) max_val = 1.0;
     }
@@ -556,67 +576,65 @@ static void render_chart(fb_t *fb, uint32_t idx, int32_t x, int32_t y, int32_t w
 
     plot_bottom = plot_y + plot_height - 2;
 
-    if (source->is_dual && source->data_buffer_secondary) {
+    if (source->is_dual) {
         prev_out_x = -1;
         prev_out_y = -1;
-        dual_count = (data_count < data_count2) ? data_count : data_count2;
 
-        for (i = 0; i < dual_count; i++) {
-            in_value = snap_vals[i];
-            out_value = snap_vals2[i];
+        for (i = 0; i < data_count; i++) {
+            in_col = &chart_columns[0][i];
+            out_col = &chart_columns[1][i];
 
-            pixel_offset = (int32_t)((now_ms - snap_ts[i]) / (uint32_t)refresh_interval);
+            pixel_offset = (int32_t)((now_ms - chart_timestamps[i]) / ms_per_px);
             if (pixel_offset < 0 || pixel_offset > plot_max_offset) {
                 prev_out_x = prev_out_y = -1;
                 continue;
             }
             plot_x = x + width - 2 - pixel_offset;
 
-            if (in_value < 0 || out_value < 0) {
+            if (in_col->count == 0 || out_col->count == 0) {
                 fb_line(fb, plot_x, plot_y + 2, plot_x, plot_bottom, err_ci);
                 prev_out_x = prev_out_y = -1;
             } else {
-                in_bar_height = (int32_t)((in_value / max_val) * (plot_height - 4));
+                in_bar_height = (int32_t)((in_col->max / max_val) * (plot_height - 4));
                 if (in_bar_height < 1) in_bar_height = 1;
                 fb_line(fb, plot_x, plot_bottom - in_bar_height, plot_x, plot_bottom, line_ci);
 
-                out_bar_height = (int32_t)((out_value / max_val) * (plot_height - 4));
-                out_y = plot_bottom - out_bar_height;
+                out_y = plot_bottom - (int32_t)((out_col->first / max_val) * (plot_height - 4));
+                out_top = plot_bottom - (int32_t)((out_col->max / max_val) * (plot_height - 4));
+                out_bottom = plot_bottom - (int32_t)((out_col->min / max_val) * (plot_height - 4));
                 if (prev_out_x >= 0 && prev_out_y >= 0) {
                     fb_line(fb, prev_out_x, prev_out_y, plot_x, out_y, line2_ci);
-                } else {
+                }
+                if (out_top != out_bottom) {
+                    fb_line(fb, plot_x, out_top, plot_x, out_bottom, line2_ci);
+                } else if (prev_out_x < 0) {
                     fb_pixel(fb, plot_x, out_y, line2_ci);
                 }
                 prev_out_x = plot_x;
-                prev_out_y = out_y;
+                prev_out_y = plot_bottom - (int32_t)((out_col->last / max_val) * (plot_height - 4));
             }
         }
     } else {
         for (i = 0; i < data_count; i++) {
-            value = snap_vals[i];
+            col = &chart_columns[0][i];
 
-            pixel_offset = (int32_t)((now_ms - snap_ts[i]) / (uint32_t)refresh_interval);
+            pixel_offset = (int32_t)((now_ms - chart_timestamps[i]) / ms_per_px);
             if (pixel_offset < 0 || pixel_offset > plot_max_offset) continue;
             plot_x = x + width - 2 - pixel_offset;
 
-            if (value < 0) {
+            if (col->count == 0) {
                 fb_line(fb, plot_x, plot_y + 2, plot_x, plot_bottom, err_ci);
             } else {
-                bar_height = (int32_t)((value / max_val) * (plot_height - 4));
+                bar_height = (int32_t)((col->max / max_val) * (plot_height - 4));
                 if (bar_height < 1) bar_height = 1;
                 fb_line(fb, plot_x, plot_bottom - bar_height, plot_x, plot_bottom, line_ci);
             }
         }
     }
 
-    memset(&stats, 0, sizeof(stats));
-    if (handler && handler->get_stats && source->datasource->context) {
-        handler->get_stats(source->datasource->context, &stats);
-    }
-
     if (handler && handler->format_value) {
         if (source->is_dual && handler->format_dual_stats) {
-            handler->format_dual_stats(stats.last, stats.last_secondary,
+            handler->format_dual_stats(stats.last, stats2.last,
                                        stats_text, sizeof(stats_text));
         } else {
             handler->format_value(stats.last, stats_text, sizeof(stats_text));
@@ -628,7 +646,7 @@ static void render_chart(fb_t *fb, uint32_t idx, int32_t x, int32_t y, int32_t w
     }
     fb_text(fb, x + width - fb_text_width(stats_text), y + height - 15, stats_text, text_ci);
 
-    total_time_ms = source->data_buffer->size * (uint32_t)refresh_interval;
+    total_time_ms = span_ms;
     if (total_time_ms < 60000) {
         snprintf(time_span_text, sizeof(time_span_text), "%us", total_time_ms / 1000);
     } else if (total_time_ms < 86400000) {
@@ -644,6 +662,27 @@ static void render_chart(fb_t *fb, uint32_t idx, int32_t x, int32_t y, int32_t w
         snprintf(time_span_text, sizeof(time_span_text), "%ud", days);
     }
     fb_text(fb, x, y + height - 15, time_span_text, text_ci);
+
+    /* tails of the primary series over the span, centred when they fit */
+    if (!ringbuf_span_quantiles(source->data_buffer, span_source, 0, now_ms, span_ms,
+                                chart_quantiles, quantile_values, 3)) {
+        quantile_values[0] = stats.p50;
+        quantile_values[1] = stats.p95;
+        quantile_values[2] = stats.p99;
+    }
+    for (i = 0; i < 3; i++) {
+        if (handler && handler->format_value) {
+            handler->format_value(quantile_values[i], quantile_text[i], sizeof(quantile_text[i]));
+        } else {
+            snprintf(quantile_text[i], sizeof(quantile_text[i]), "%.1f%s", quantile_values[i], unit);
+        }
+    }
+    snprintf(tail_text, sizeof(tail_text), "p50 %s p95 %s p99 %s", quantile_text[0], quantile_text[1], quantile_text[2]);
+    tail_x = x + (width - fb_text_width(tail_text)) / 2;
+    if (tail_x > x + fb_text_width(time_span_text) + 8 &&
+        tail_x + fb_text_width(tail_text) + 8 < x + width - fb_text_width(stats_text)) {
+        fb_text(fb, tail_x, y + height - 15, tail_text, text_ci);
+    }
 }
 
 static uint8_t *render_gif(uint32_t *out_len) {
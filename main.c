@@ -104,6 +104,7 @@ int main(int argc, char *argv[]) {
     }
 
     plot_system_connect_data_buffers(plot_system, data_collector);
+    data_collector->on_sample = graphics_wakeup;
 
     if (!data_collector_start(data_collector)) {
         fprintf(stderr, "Failed to start data collector\n");
@@ -20,6 +20,7 @@
 #include "icmp_ping.c"
 #include "unix-defgw.c"
 #include "kqueue_timer.c"
+#include "posix_mmap.c"
 
 struct plot_mutex_t {
     void *handle;
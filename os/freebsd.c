@@ -330,3 +330,4 @@ char *os_get_config_path(const char *filename) {
 }
 #include "icmp_ping.c"
 #include "kqueue_timer.c"
+#include "posix_mmap.c"
@@ -5,18 +5,24 @@
  * the box, and on Linux when net.ipv4.ping_group_range covers the caller's
  * gid). Falls back to SOCK_RAW + IPPROTO_ICMP if SOCK_DGRAM is not permitted.
  *
- * Reply matching uses the source address and sequence number. Under SOCK_DGRAM
- * the kernel rewrites the ICMP id on send and demuxes replies to the originating
- * socket, so matching on id is unreliable across platforms.
+ * All targets share one socket owned by a small engine: probes are sent from
+ * the submitting thread and completed from the engine thread, which waits on
+ * the socket and a wakeup pipe and expires probes in deadline order. Replies
+ * are matched by sequence number (unique across targets) and source address.
+ * Under SOCK_DGRAM the kernel rewrites the ICMP id on send and demuxes replies
+ * to the originating socket, so matching on id is unreliable across platforms.
  */
 
 #include "os_interface.h"
 #include <errno.h>
+#include <fcntl.h>
 #include <netdb.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <netinet/in.h>
@@ -25,6 +31,10 @@
 #define ICMP_ECHO_REQUEST 8
 #define ICMP_ECHO_REPLY   0
 
+/* Probes in flight are indexed by seq; 4096 covers a /20 per timeout period */
+#define PING_ENGINE_SLOTS 4096
+#define PING_ENGINE_MASK  (PING_ENGINE_SLOTS - 1)
+
 struct icmp_echo_hdr {
     uint8_t  type;
     uint8_t  code;
@@ -34,13 +44,38 @@ struct icmp_echo_hdr {
 };
 
 struct os_ping_context_t {
-    int sockfd;
     struct sockaddr_in dst;
-    uint16_t id;
-    uint16_t seq;
     uint32_t timeout_ms;
 };
 
+typedef struct ping_probe_s {
+    os_ping_context_t *ctx;
+    os_ping_done_fn done;
+    void *arg;
+    uint32_t addr;
+    uint16_t seq;
+    int in_use;
+    uint64_t sent_us;
+    uint64_t deadline_us;
+    struct ping_probe_s *prev;
+    struct ping_probe_s *next;
+} ping_probe_t;
+
+typedef struct {
+    int sockfd;
+    int wake[2];
+    int started;
+    uint16_t id;
+    uint16_t seq;
+    plot_thread_t *thread;
+    ping_probe_t probes[PING_ENGINE_SLOTS];
+    ping_probe_t *head;     /* pending probes, ordered by deadline */
+    ping_probe_t *tail;
+} ping_engine_t;
+
+static ping_engine_t ping_engine;
+static pthread_mutex_t ping_engine_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static uint16_t icmp_cksum(const void *data, size_t len) {
     const uint16_t *w = (const uint16_t *)data;
     uint32_t sum = 0;
@@ -56,10 +91,180 @@ static uint64_t now_us(void) {
     return (uint64_t)tv.tv_sec * 1000000ULL + (uint64_t)tv.tv_usec;
 }
 
+static void ping_probe_unlink(ping_probe_t *probe) {
+    if (probe->prev) probe->prev->next = probe->next;
+    else ping_engine.head = probe->next;
+    if (probe->next) probe->next->prev = probe->prev;
+    else ping_engine.tail = probe->prev;
+    probe->prev = NULL;
+    probe->next = NULL;
+    probe->in_use = 0;
+}
+
+/* Timeouts are usually equal, so the new probe almost always goes last */
+static void ping_probe_link(ping_probe_t *probe) {
+    ping_probe_t *after;
+
+    after = ping_engine.tail;
+    while (after && after->deadline_us > probe->deadline_us) {
+        after = after->prev;
+    }
+
+    probe->prev = after;
+    probe->next = after ? after->next : ping_engine.head;
+    if (probe->next) probe->next->prev = probe;
+    else ping_engine.tail = probe;
+    if (after) after->next = probe;
+    else ping_engine.head = probe;
+    probe->in_use = 1;
+}
+
+/* Called with ping_engine_lock held; drops it around the callback */
+static void ping_probe_complete(ping_probe_t *probe, int success, double ping_time_ms) {
+    os_ping_done_fn done;
+    void *arg;
+
+    done = probe->done;
+    arg = probe->arg;
+    ping_probe_unlink(probe);
+
+    pthread_mutex_unlock(&ping_engine_lock);
+    done(arg, success, ping_time_ms);
+    pthread_mutex_lock(&ping_engine_lock);
+}
+
+static void ping_engine_receive(void) {
+    uint8_t buf[1500];
+    struct sockaddr_in from;
+    socklen_t fromlen;
+    const struct icmp_echo_hdr *reply;
+    ping_probe_t *probe;
+    uint16_t seq;
+    size_t off;
+    ssize_t n;
+
+    for (;;) {
+        fromlen = sizeof(from);
+        n = recvfrom(ping_engine.sockfd, buf, sizeof(buf), 0,
+                     (struct sockaddr *)&from, &fromlen);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+
+        /* SOCK_RAW delivers IP+ICMP; SOCK_DGRAM usually delivers ICMP only.
+         * Detect an IPv4 header by its version nibble and skip it. */
+        off = 0;
+        if (n > 0 && (buf[0] >> 4) == 4) {
+            off = (size_t)(buf[0] & 0x0f) * 4;
+        }
+        if ((size_t)n < off + sizeof(struct icmp_echo_hdr)) continue;
+        reply = (const struct icmp_echo_hdr *)(buf + off);
+
+        if (reply->type != ICMP_ECHO_REPLY) continue;
+        seq = ntohs(reply->seq);
+        probe = &ping_engine.probes[seq & PING_ENGINE_MASK];
+        if (!probe->in_use || probe->seq != seq) continue;
+        if (probe->addr != from.sin_addr.s_addr) continue;
+
+        ping_probe_complete(probe, 1, (double)(now_us() - probe->sent_us) / 1000.0);
+    }
+}
+
+static void ping_engine_thread(void *arg) {
+    struct pollfd pfds[2];
+    uint64_t now;
+    char drain[64];
+    int timeout_ms;
+    int r;
+
+    (void)arg;
+    /* poll, not select: with a locked history file per plot the socket
+     * can be numbered past FD_SETSIZE */
+    pfds[0].fd = ping_engine.sockfd;
+    pfds[0].events = POLLIN;
+    pfds[1].fd = ping_engine.wake[0];
+    pfds[1].events = POLLIN;
+
+    pthread_mutex_lock(&ping_engine_lock);
+    for (;;) {
+        now = now_us();
+        while (ping_engine.head && ping_engine.head->deadline_us <= now) {
+            ping_probe_complete(ping_engine.head, 0, -1.0);
+        }
+
+        timeout_ms = -1;
+        if (ping_engine.head) {
+            now = (ping_engine.head->deadline_us - now + 999) / 1000;
+            timeout_ms = (now > 0x7fffffffULL) ? 0x7fffffff : (int)now;
+        }
+        pthread_mutex_unlock(&ping_engine_lock);
+
+        pfds[0].revents = 0;
+        pfds[1].revents = 0;
+        r = poll(pfds, 2, timeout_ms);
+
+        if (r > 0 && (pfds[1].revents & POLLIN)) {
+            while (read(ping_engine.wake[0], drain, sizeof(drain)) > 0) {
+            }
+        }
+
+        pthread_mutex_lock(&ping_engine_lock);
+        if (r > 0 && (pfds[0].revents & POLLIN)) {
+            ping_engine_receive();
+        }
+    }
+}
+
+static int ping_engine_start(void) {
+    int fd;
+
+    pthread_mutex_lock(&ping_engine_lock);
+    if (ping_engine.started) {
+        pthread_mutex_unlock(&ping_engine_lock);
+        return 1;
+    }
+
+    fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_ICMP);
+    if (fd < 0) fd = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+    if (fd < 0) {
+        pthread_mutex_unlock(&ping_engine_lock);
+        return 0;
+    }
+
+    if (pipe(ping_engine.wake) != 0) {
+        close(fd);
+        pthread_mutex_unlock(&ping_engine_lock);
+        return 0;
+    }
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    fcntl(ping_engine.wake[0], F_SETFL, fcntl(ping_engine.wake[0], F_GETFL, 0) | O_NONBLOCK);
+    fcntl(ping_engine.wake[1], F_SETFL, fcntl(ping_engine.wake[1], F_GETFL, 0) | O_NONBLOCK);
+
+    ping_engine.sockfd = fd;
+    ping_engine.id = (uint16_t)(getpid() & 0xffff);
+    ping_engine.seq = 0;
+    ping_engine.head = NULL;
+    ping_engine.tail = NULL;
+
+    ping_engine.thread = os_plot_thread_create(ping_engine_thread, NULL);
+    if (!ping_engine.thread) {
+        close(ping_engine.wake[0]);
+        close(ping_engine.wake[1]);
+        close(fd);
+        pthread_mutex_unlock(&ping_engine_lock);
+        return 0;
+    }
+
+    ping_engine.started = 1;
+    pthread_mutex_unlock(&ping_engine_lock);
+    return 1;
+}
+
 os_ping_context_t *os_ping_create(const char *hostname, uint32_t timeout_ms) {
     struct addrinfo hints, *ai = NULL;
     os_ping_context_t *ctx;
-    int fd;
 
     if (!hostname) return NULL;
 
@@ -68,102 +273,132 @@ os_ping_context_t *os_ping_create(const char *hostname, uint32_t timeout_ms) {
     hints.ai_socktype = SOCK_DGRAM;
     if (getaddrinfo(hostname, NULL, &hints, &ai) != 0 || !ai) return NULL;
 
-    fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_ICMP);
-    if (fd < 0) fd = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
-    if (fd < 0) { freeaddrinfo(ai); return NULL; }
+    if (!ping_engine_start()) { freeaddrinfo(ai); return NULL; }
 
     ctx = (os_ping_context_t *)calloc(1, sizeof(*ctx));
-    if (!ctx) { close(fd); freeaddrinfo(ai); return NULL; }
+    if (!ctx) { freeaddrinfo(ai); return NULL; }
 
     memcpy(&ctx->dst, ai->ai_addr, sizeof(ctx->dst));
     ctx->dst.sin_port = 0;
-    ctx->sockfd = fd;
-    ctx->id = (uint16_t)(getpid() & 0xffff);
-    ctx->seq = 0;
     ctx->timeout_ms = timeout_ms ? timeout_ms : 1000;
 
     freeaddrinfo(ai);
     return ctx;
 }
 
-int os_ping_send(os_ping_context_t *ctx, double *ping_time_ms) {
+int os_ping_submit(os_ping_context_t *ctx, os_ping_done_fn done, void *arg) {
     struct icmp_echo_hdr req;
-    uint8_t buf[1500];
-    struct sockaddr_in from;
-    socklen_t fromlen;
-    fd_set rfds;
-    struct timeval tv;
-    uint64_t t0, elapsed_us, timeout_us;
+    ping_probe_t *probe;
     uint16_t seq;
-    ssize_t n;
-    int r;
+    int wake;
 
-    if (!ctx || !ping_time_ms) return 0;
+    if (!ctx || !done) return 0;
+    if (!ping_engine_start()) return 0;
+
+    pthread_mutex_lock(&ping_engine_lock);
+
+    seq = ++ping_engine.seq;
+    probe = &ping_engine.probes[seq & PING_ENGINE_MASK];
+    if (probe->in_use) {
+        pthread_mutex_unlock(&ping_engine_lock);
+        return 0;
+    }
+
+    probe->ctx = ctx;
+    probe->done = done;
+    probe->arg = arg;
+    probe->addr = ctx->dst.sin_addr.s_addr;
+    probe->seq = seq;
+    probe->sent_us = now_us();
+    probe->deadline_us = probe->sent_us + (uint64_t)ctx->timeout_ms * 1000ULL;
+    ping_probe_link(probe);
 
-    seq = ++ctx->seq;
     memset(&req, 0, sizeof(req));
     req.type = ICMP_ECHO_REQUEST;
-    req.id = htons(ctx->id);
+    req.id = htons(ping_engine.id);
     req.seq = htons(seq);
     req.cksum = icmp_cksum(&req, sizeof(req));
 
-    timeout_us = (uint64_t)ctx->timeout_ms * 1000ULL;
-    t0 = now_us();
-
-    if (sendto(ctx->sockfd, &req, sizeof(req), 0,
+    if (sendto(ping_engine.sockfd, &req, sizeof(req), 0,
                (struct sockaddr *)&ctx->dst, sizeof(ctx->dst)) < 0) {
-        *ping_time_ms = -1.0;
+        ping_probe_unlink(probe);
+        pthread_mutex_unlock(&ping_engine_lock);
         return 0;
     }
 
-    for (;;) {
-        const struct icmp_echo_hdr *reply;
-        size_t off;
+    /* the engine only needs to re-arm its timeout if this is the earliest */
+    wake = (ping_engine.head == probe);
+    pthread_mutex_unlock(&ping_engine_lock);
 
-        elapsed_us = now_us() - t0;
-        if (elapsed_us >= timeout_us) {
-            *ping_time_ms = -1.0;
-            return 0;
-        }
-        tv.tv_sec = (time_t)((timeout_us - elapsed_us) / 1000000ULL);
-        tv.tv_usec = (suseconds_t)((timeout_us - elapsed_us) % 1000000ULL);
+    if (wake) {
+        write(ping_engine.wake[1], "", 1);
+    }
+    return 1;
+}
 
-        FD_ZERO(&rfds);
-        FD_SET(ctx->sockfd, &rfds);
-        r = select(ctx->sockfd + 1, &rfds, NULL, NULL, &tv);
-        if (r < 0 && errno == EINTR) continue;
-        if (r <= 0) { *ping_time_ms = -1.0; return 0; }
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int finished;
+    int success;
+    double ping_time_ms;
+} ping_waiter_t;
 
-        fromlen = sizeof(from);
-        n = recvfrom(ctx->sockfd, buf, sizeof(buf), 0,
-                     (struct sockaddr *)&from, &fromlen);
-        if (n < 0) {
-            if (errno == EINTR) continue;
-            *ping_time_ms = -1.0;
-            return 0;
-        }
+static void ping_waiter_done(void *arg, int success, double ping_time_ms) {
+    ping_waiter_t *w = (ping_waiter_t *)arg;
 
-        if (from.sin_addr.s_addr != ctx->dst.sin_addr.s_addr) continue;
+    pthread_mutex_lock(&w->lock);
+    w->success = success;
+    w->ping_time_ms = ping_time_ms;
+    w->finished = 1;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
 
-        /* SOCK_RAW delivers IP+ICMP; SOCK_DGRAM usually delivers ICMP only.
-         * Detect an IPv4 header by its version nibble and skip it. */
-        off = 0;
-        if (n > 0 && (buf[0] >> 4) == 4) {
-            off = (size_t)(buf[0] & 0x0f) * 4;
-        }
-        if ((size_t)n < off + sizeof(struct icmp_echo_hdr)) continue;
-        reply = (const struct icmp_echo_hdr *)(buf + off);
+int os_ping_send(os_ping_context_t *ctx, double *ping_time_ms) {
+    ping_waiter_t w;
 
-        if (reply->type != ICMP_ECHO_REPLY) continue;
-        if (ntohs(reply->seq) != seq) continue;
+    if (!ctx || !ping_time_ms) return 0;
 
-        *ping_time_ms = (double)(now_us() - t0) / 1000.0;
-        return 1;
+    pthread_mutex_init(&w.lock, NULL);
+    pthread_cond_init(&w.cond, NULL);
+    w.finished = 0;
+    w.success = 0;
+    w.ping_time_ms = -1.0;
+
+    if (!os_ping_submit(ctx, ping_waiter_done, &w)) {
+        pthread_cond_destroy(&w.cond);
+        pthread_mutex_destroy(&w.lock);
+        *ping_time_ms = -1.0;
+        return 0;
     }
+
+    pthread_mutex_lock(&w.lock);
+    while (!w.finished) {
+        pthread_cond_wait(&w.cond, &w.lock);
+    }
+    pthread_mutex_unlock(&w.lock);
+
+    pthread_cond_destroy(&w.cond);
+    pthread_mutex_destroy(&w.lock);
+
+    *ping_time_ms = w.success ? w.ping_time_ms : -1.0;
+    return w.success;
 }
 
 void os_ping_destroy(os_ping_context_t *ctx) {
+    ping_probe_t *probe;
+    ping_probe_t *next;
+
     if (!ctx) return;
-    if (ctx->sockfd >= 0) close(ctx->sockfd);
+
+    /* drop anything still in flight; its owner is going away */
+    pthread_mutex_lock(&ping_engine_lock);
+    for (probe = ping_engine.head; probe; probe = next) {
+        next = probe->next;
+        if (probe->ctx == ctx) ping_probe_unlink(probe);
+    }
+    pthread_mutex_unlock(&ping_engine_lock);
+
     free(ctx);
 }
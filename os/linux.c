@@ -27,186 +27,7 @@ int os_init(void) {
 void os_cleanup(void) {
 }
 
-int os_cpu_get_stats(double *value) {
-    static uint64_t prev_idle = 0;
-    static uint64_t prev_total = 0;
-    
-    FILE *fp;
-    char line[256];
-    uint64_t user, nice, system, idle, iowait, irq, softirq, steal;
-    uint64_t total_ticks;
-    uint64_t idle_diff, total_diff;
-
-    fp = fopen("/proc/stat", "r");
-    if (!fp) return 0;
-
-    if (fgets(line, sizeof(line), fp) &&
-        sscanf(line, "cpu %lu %lu %lu %lu %lu %lu %lu %lu",
-               &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal) == 8) {
-
-        total_ticks = user + nice + system + idle + iowait + irq + softirq + steal;
-
-        if (prev_total != 0) {
-            idle_diff = idle - prev_idle;
-            total_diff = total_ticks - prev_total;
-
-            if (total_diff > 0) {
-                *value = 100.0 * (1.0 - (double)idle_diff / total_diff);
-            } else {
-                *value = 0.0;
-            }
-        } else {
-            *value = 0.0;
-        }
-
-        prev_idle = idle;
-        prev_total = total_ticks;
-    }
-    fclose(fp);
-
-    if (*value > 100.0) *value = 100.0;
-    if (*value < 0.0) *value = 0.0;
-
-    return 1;
-}
-
-int os_cpu_get_stats_dual(double *total_value, double *system_value) {
-    static uint64_t prev_idle = 0;
-    static uint64_t prev_total = 0;
-    static uint64_t prev_system = 0;
-    
-    FILE *fp;
-    char line[256];
-    uint64_t user, nice, system, idle, iowait, irq, softirq, steal;
-    uint64_t total_ticks, system_ticks;
-    uint64_t idle_diff, total_diff, system_diff;
-
-    fp = fopen("/proc/stat", "r");
-    if (!fp) return 0;
-
-    if (fgets(line, sizeof(line), fp) &&
-        sscanf(line, "cpu %lu %lu %lu %lu %lu %lu %lu %lu",
-               &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal) == 8) {
-
-        total_ticks = user + nice + system + idle + iowait + irq + softirq + steal;
-        system_ticks = system + irq + softirq;
-
-        if (prev_total != 0) {
-            idle_diff = idle - prev_idle;
-            total_diff = total_ticks - prev_total;
-            system_diff = system_ticks - prev_system;
-
-            if (total_diff > 0) {
-                *total_value = 100.0 * (1.0 - (double)idle_diff / total_diff);
-                *system_value = 100.0 * (double)system_diff / total_diff;
-            } else {
-                *total_value = 0.0;
-                *system_value = 0.0;
-            }
-        } else {
-            *total_value = 0.0;
-            *system_value = 0.0;
-        }
-
-        prev_idle = idle;
-        prev_total = total_ticks;
-        prev_system = system_ticks;
-    }
-    fclose(fp);
-
-    if (*total_value > 100.0) *total_value = 100.0;
-    if (*total_value < 0.0) *total_value = 0.0;
-    if (*system_value > 100.0) *system_value = 100.0;
-    if (*system_value < 0.0) *system_value = 0.0;
-
-    return 1;
-}
-
-int os_memory_get_stats(double *value) {
-    FILE *fp;
-    char line[256];
-    uint64_t mem_total, mem_available;
-    uint64_t total_memory, free_memory, used_memory;
-
-    fp = fopen("/proc/meminfo", "r");
-    if (!fp) return 0;
-
-    mem_total = 0;
-    mem_available = 0;
-    while (fgets(line, sizeof(line), fp)) {
-        if (sscanf(line, "MemTotal: %lu kB", &mem_total) == 1) {
-            total_memory = mem_total * 1024;
-        } else if (sscanf(line, "MemAvailable: %lu kB", &mem_available) == 1) {
-            free_memory = mem_available * 1024;
-        }
-    }
-    fclose(fp);
-
-    if (total_memory == 0) return 0;
-
-    used_memory = total_memory - free_memory;
-    *value = (double)used_memory / (double)total_memory * 100.0;
-
-    if (*value > 100.0) *value = 100.0;
-    if (*value < 0.0) *value = 0.0;
-
-    return 1;
-}
-
-int os_loadavg_get_stats(double *value) {
-    FILE *fp;
-    char line[256];
-    double loadavg1, loadavg5, loadavg15;
-
-    fp = fopen("/proc/loadavg", "r");
-    if (fp) {
-        if (fgets(line, sizeof(line), fp) &&
-            sscanf(line, "%lf %lf %lf", &loadavg1, &loadavg5, &loadavg15) >= 1) {
-            *value = loadavg1;
-        } else {
-            *value = 0.0;
-        }
-        fclose(fp);
-    } else {
-        *value = 0.0;
-    }
-    if (*value < 0.0) *value = 0.0;
-
-    return 1;
-}
-
-int os_get_interface_stats(const char* interface_name, uint32_t* in_bytes, uint32_t* out_bytes) {
-    FILE *fp = fopen("/proc/net/dev", "r");
-    if (!fp) {
-        return 0;
-    }
-
-    char line[256];
-    fgets(line, sizeof(line), fp);
-    fgets(line, sizeof(line), fp);
-
-    while (fgets(line, sizeof(line), fp)) {
-        char ifname[32];
-        unsigned long rx_bytes, tx_bytes;
-        unsigned long rx_packets, rx_errs, rx_drop, rx_fifo, rx_frame, rx_compressed, rx_multicast;
-        unsigned long tx_packets, tx_errs, tx_drop, tx_fifo, tx_colls, tx_carrier, tx_compressed;
-
-        if (sscanf(line, " %31[^:]: %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu %lu",
-                   ifname, &rx_bytes, &rx_packets, &rx_errs, &rx_drop, &rx_fifo, &rx_frame, &rx_compressed, &rx_multicast,
-                   &tx_bytes, &tx_packets, &tx_errs, &tx_drop, &tx_fifo, &tx_colls, &tx_carrier, &tx_compressed) == 17) {
-
-            if (strcmp(ifname, interface_name) == 0) {
-                *in_bytes = (uint32_t)rx_bytes;
-                *out_bytes = (uint32_t)tx_bytes;
-                fclose(fp);
-                return 1;
-            }
-        }
-    }
-
-    fclose(fp);
-    return 0;
-}
+#include "linux_procfs.c"
 
 void os_sleep(uint32_t milliseconds) {
     usleep(milliseconds * 1000);
@@ -368,3 +189,4 @@ int os_get_default_gw_ip(char *buf, size_t buflen) {
 }
 #include "icmp_ping.c"
 #include "linux_timer.c"
+#include "posix_mmap.c"
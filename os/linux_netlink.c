@@ -0,0 +1,186 @@
+/*
+ * Interface counters over rtnetlink.
+ *
+ * One RTM_GETLINK dump returns every interface with its IFLA_STATS64 block,
+ * so the snapshot gets 64-bit bytes, packets, errors and drops for all
+ * links in a single request on a persistent socket. Kernels that omit
+ * IFLA_STATS64 fall back to the 32-bit IFLA_STATS block.
+ */
+
+#include <stddef.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <linux/if_link.h>
+
+/* The stats blocks grow with the kernel (rx_nohandler, rx_otherhost_dropped
+ * and so on), so an older kernel sends less than these headers describe;
+ * everything up to tx_dropped is all that is read */
+#define NETLINK_STATS64_MIN (offsetof(struct rtnl_link_stats64, tx_dropped) + sizeof(__u64))
+#define NETLINK_STATS32_MIN (offsetof(struct rtnl_link_stats, tx_dropped) + sizeof(__u32))
+
+static int netlink_fd = -1;
+static uint32_t netlink_seq = 0;
+
+static int netlink_open(void) {
+    struct sockaddr_nl sa;
+
+    if (netlink_fd >= 0) return 1;
+
+    netlink_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (netlink_fd < 0) return 0;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    if (bind(netlink_fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        close(netlink_fd);
+        netlink_fd = -1;
+        return 0;
+    }
+    return 1;
+}
+
+static void netlink_close(void) {
+    if (netlink_fd >= 0) close(netlink_fd);
+    netlink_fd = -1;
+}
+
+/* Copies one RTM_NEWLINK into the next snapshot slot */
+static void netlink_parse_link(struct nlmsghdr *nlh, procfs_netdev_t *dev, int *have) {
+    struct ifinfomsg *ifm;
+    struct rtattr *rta;
+    int len;
+    struct rtnl_link_stats64 s64;
+    struct rtnl_link_stats s32;
+    int got_name, got_stats64, got_stats32;
+
+    ifm = (struct ifinfomsg *)NLMSG_DATA(nlh);
+    len = (int)IFLA_PAYLOAD(nlh);
+    got_name = 0;
+    got_stats64 = 0;
+    got_stats32 = 0;
+    memset(&s64, 0, sizeof(s64));
+    memset(&s32, 0, sizeof(s32));
+
+    for (rta = IFLA_RTA(ifm); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == IFLA_IFNAME && RTA_PAYLOAD(rta) <= sizeof(dev->name)) {
+            memcpy(dev->name, RTA_DATA(rta), RTA_PAYLOAD(rta));
+            dev->name[sizeof(dev->name) - 1] = '\0';
+            got_name = 1;
+        } else if (rta->rta_type == IFLA_STATS64 && RTA_PAYLOAD(rta) >= NETLINK_STATS64_MIN) {
+            memcpy(&s64, RTA_DATA(rta), (RTA_PAYLOAD(rta) < sizeof(s64)) ? RTA_PAYLOAD(rta) : sizeof(s64));
+            got_stats64 = 1;
+        } else if (rta->rta_type == IFLA_STATS && RTA_PAYLOAD(rta) >= NETLINK_STATS32_MIN) {
+            memcpy(&s32, RTA_DATA(rta), (RTA_PAYLOAD(rta) < sizeof(s32)) ? RTA_PAYLOAD(rta) : sizeof(s32));
+            got_stats32 = 1;
+        }
+    }
+
+    *have = 0;
+    if (!got_name) return;
+
+    if (got_stats64) {
+        dev->stats.rx_bytes = s64.rx_bytes;
+        dev->stats.tx_bytes = s64.tx_bytes;
+        dev->stats.rx_packets = s64.rx_packets;
+        dev->stats.tx_packets = s64.tx_packets;
+        dev->stats.rx_errors = s64.rx_errors;
+        dev->stats.tx_errors = s64.tx_errors;
+        dev->stats.rx_dropped = s64.rx_dropped;
+        dev->stats.tx_dropped = s64.tx_dropped;
+        *have = 1;
+    } else if (got_stats32) {
+        dev->stats.rx_bytes = s32.rx_bytes;
+        dev->stats.tx_bytes = s32.tx_bytes;
+        dev->stats.rx_packets = s32.rx_packets;
+        dev->stats.tx_packets = s32.tx_packets;
+        dev->stats.rx_errors = s32.rx_errors;
+        dev->stats.tx_errors = s32.tx_errors;
+        dev->stats.rx_dropped = s32.rx_dropped;
+        dev->stats.tx_dropped = s32.tx_dropped;
+        *have = 1;
+    }
+}
+
+/* Dumps all links into procfs.netdev; 0 if netlink is unavailable */
+static int netlink_read_links(void) {
+    static char *buf = NULL;
+    static size_t buf_size = 0;
+    struct {
+        struct nlmsghdr nlh;
+        struct ifinfomsg ifm;
+    } req;
+    struct sockaddr_nl sa;
+    struct nlmsghdr *nlh;
+    procfs_netdev_t *grown;
+    char *bigger;
+    ssize_t n;
+    int len, have, done;
+
+    if (!netlink_open()) return 0;
+
+    memset(&req, 0, sizeof(req));
+    req.nlh.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+    req.nlh.nlmsg_type = RTM_GETLINK;
+    req.nlh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nlh.nlmsg_seq = ++netlink_seq;
+    req.ifm.ifi_family = AF_UNSPEC;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.nl_family = AF_NETLINK;
+    if (sendto(netlink_fd, &req, req.nlh.nlmsg_len, 0, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        netlink_close();
+        return 0;
+    }
+
+    procfs.netdev_count = 0;
+    done = 0;
+    while (!done) {
+        /* MSG_TRUNC makes the peek report the whole datagram, so the
+         * buffer can grow before a message is cut short */
+        n = recv(netlink_fd, buf, buf_size, MSG_PEEK | MSG_TRUNC);
+        if (n < 0 && errno == EINTR) continue;
+        if (n > 0 && (size_t)n > buf_size) {
+            bigger = realloc(buf, (size_t)n);
+            if (!bigger) {
+                netlink_close();
+                return 0;
+            }
+            buf = bigger;
+            buf_size = (size_t)n;
+        }
+
+        n = recv(netlink_fd, buf, buf_size, MSG_TRUNC);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0 || (size_t)n > buf_size) {
+            netlink_close();
+            return 0;
+        }
+
+        len = (int)n;
+        for (nlh = (struct nlmsghdr *)buf; NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_seq != netlink_seq) continue;
+            if (nlh->nlmsg_type == NLMSG_DONE) {
+                done = 1;
+                break;
+            }
+            if (nlh->nlmsg_type == NLMSG_ERROR) {
+                netlink_close();
+                return 0;
+            }
+            if (nlh->nlmsg_type != RTM_NEWLINK) continue;
+
+            if (procfs.netdev_count == procfs.netdev_cap) {
+                grown = realloc(procfs.netdev, sizeof(procfs_netdev_t) * (procfs.netdev_cap ? procfs.netdev_cap * 2 : 16));
+                if (!grown) continue;
+                procfs.netdev = grown;
+                procfs.netdev_cap = procfs.netdev_cap ? procfs.netdev_cap * 2 : 16;
+            }
+
+            netlink_parse_link(nlh, &procfs.netdev[procfs.netdev_count], &have);
+            if (have) procfs.netdev_count++;
+        }
+    }
+
+    return 1;
+}
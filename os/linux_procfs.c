@@ -0,0 +1,404 @@
+/*
+ * Shared /proc snapshot.
+ *
+ * Every local datasource reads through here: each file is parsed at most
+ * once per PROCFS_MAX_AGE_MS however many plots sample it, so plots due on
+ * the same scheduler tick share one read. CPU counters are handed out raw
+ * (os_cpu_get_ticks) and each consumer keeps its own delta baseline.
+ *
+ * Files stay open and are re-read with pread() into static buffers, then
+ * parsed with a plain integer scanner: no stdio, allocation or locale work
+ * per sample.
+ */
+
+#include <pthread.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+
+/* Matches the collector's shortest tick */
+#define PROCFS_MAX_AGE_MS 10
+
+typedef struct {
+    char name[32];
+    os_if_stats64_t stats;
+} procfs_netdev_t;
+
+typedef struct {
+    uint32_t read_ms;
+    int read;
+    int ok;
+} procfs_stamp_t;
+
+static struct {
+    procfs_stamp_t stat_stamp;
+    procfs_stamp_t meminfo_stamp;
+    procfs_stamp_t loadavg_stamp;
+    procfs_stamp_t netdev_stamp;
+    os_cpu_ticks_t cpu;
+    uint64_t mem_total;
+    uint64_t mem_available;
+    double loadavg1;
+    procfs_netdev_t *netdev;
+    int netdev_count;
+    int netdev_cap;
+    uint64_t netdev_ns;
+} procfs;
+
+static pthread_mutex_t procfs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Returns 1 if the cached copy is recent enough to serve as is */
+static int procfs_fresh(procfs_stamp_t *stamp) {
+    return stamp->read && os_get_time_ms() - stamp->read_ms < PROCFS_MAX_AGE_MS;
+}
+
+static void procfs_stamp(procfs_stamp_t *stamp, int ok) {
+    stamp->read_ms = os_get_time_ms();
+    stamp->read = 1;
+    stamp->ok = ok;
+}
+
+/* Keeps the file open across reads; pread at offset 0 re-renders it */
+static int procfs_pread(int *fd, const char *path, char *buf, size_t size) {
+    ssize_t n;
+    size_t len;
+
+    if (*fd < 0) {
+        *fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (*fd < 0) return -1;
+    }
+
+    len = 0;
+    while (len < size - 1) {
+        n = pread(*fd, buf + len, size - 1 - len, (off_t)len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            close(*fd);
+            *fd = -1;
+            return -1;
+        }
+        if (n == 0) break;
+        len += (size_t)n;
+    }
+    buf[len] = '\0';
+    return (int)len;
+}
+
+static const char *scan_blank(const char *p) {
+    while (*p == ' ' || *p == '\t') p++;
+    return p;
+}
+
+/* Unsigned decimal after optional blanks; NULL if there are no digits */
+static const char *scan_u64(const char *p, uint64_t *out) {
+    uint64_t v;
+
+    p = scan_blank(p);
+    if (*p < '0' || *p > '9') return NULL;
+    v = 0;
+    while (*p >= '0' && *p <= '9') {
+        v = v * 10 + (uint64_t)(*p - '0');
+        p++;
+    }
+    *out = v;
+    return p;
+}
+
+static const char *scan_line_end(const char *p) {
+    while (*p && *p != '\n') p++;
+    return *p ? p + 1 : p;
+}
+
+static int procfs_read_stat(void) {
+    static int fd = -1;
+    static char buf[1024];
+    uint64_t v[8];
+    const char *p;
+    int i;
+
+    /* only the aggregate first line is needed */
+    if (procfs_pread(&fd, "/proc/stat", buf, sizeof(buf)) < 0) return 0;
+    if (strncmp(buf, "cpu ", 4) != 0) return 0;
+
+    p = buf + 4;
+    for (i = 0; i < 8; i++) {
+        if (!(p = scan_u64(p, &v[i]))) return 0;
+    }
+
+    /* user nice system idle iowait irq softirq steal */
+    procfs.cpu.idle = v[3];
+    procfs.cpu.system = v[2] + v[5] + v[6];
+    procfs.cpu.total = v[0] + v[1] + v[2] + v[3] + v[4] + v[5] + v[6] + v[7];
+    return 1;
+}
+
+static int procfs_read_meminfo(void) {
+    static int fd = -1;
+    static char buf[4096];
+    const char *p;
+    uint64_t kb;
+    int found;
+
+    if (procfs_pread(&fd, "/proc/meminfo", buf, sizeof(buf)) < 0) return 0;
+
+    found = 0;
+    for (p = buf; *p && found < 2; p = scan_line_end(p)) {
+        if (strncmp(p, "MemTotal:", 9) == 0 && scan_u64(p + 9, &kb)) {
+            procfs.mem_total = kb * 1024;
+            found++;
+        } else if (strncmp(p, "MemAvailable:", 13) == 0 && scan_u64(p + 13, &kb)) {
+            procfs.mem_available = kb * 1024;
+            found++;
+        }
+    }
+
+    return procfs.mem_total != 0;
+}
+
+static int procfs_read_loadavg(void) {
+    static int fd = -1;
+    static char buf[128];
+    const char *p;
+    uint64_t whole;
+    double frac, scale;
+
+    if (procfs_pread(&fd, "/proc/loadavg", buf, sizeof(buf)) < 0) return 0;
+
+    if (!(p = scan_u64(buf, &whole))) return 0;
+    frac = 0.0;
+    if (*p == '.') {
+        for (p++, scale = 0.1; *p >= '0' && *p <= '9'; p++, scale /= 10.0) {
+            frac += (*p - '0') * scale;
+        }
+    }
+
+    procfs.loadavg1 = (double)whole + frac;
+    return 1;
+}
+
+static uint64_t procfs_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Text fallback for when rtnetlink is unavailable. The buffer grows
+ * until the whole file fits, so no record is cut short. */
+static int procfs_read_net_dev_file(void) {
+    static int fd = -1;
+    static char *buf = NULL;
+    static size_t buf_size = 0;
+    const char *p, *next, *name, *colon;
+    uint64_t v[12];
+    size_t name_len;
+    procfs_netdev_t *grown;
+    procfs_netdev_t *dev;
+    char *bigger;
+    int len, i;
+
+    for (;;) {
+        if (!buf) {
+            buf = malloc(65536);
+            if (!buf) return 0;
+            buf_size = 65536;
+        }
+        if ((len = procfs_pread(&fd, "/proc/net/dev", buf, buf_size)) < 0) return 0;
+        if ((size_t)len < buf_size - 1) break;
+        bigger = realloc(buf, buf_size * 2);
+        if (!bigger) return 0;
+        buf = bigger;
+        buf_size *= 2;
+    }
+
+    /* two header lines */
+    p = scan_line_end(scan_line_end(buf));
+
+    procfs.netdev_count = 0;
+    for (; *p; p = next) {
+        next = scan_line_end(p);
+        /* a record without its newline was still being written */
+        if (next[-1] != '\n') break;
+
+        /* the name ends at the first colon within this line */
+        name = scan_blank(p);
+        colon = memchr(name, ':', (size_t)(next - name));
+        if (!colon) continue;
+        name_len = (size_t)(colon - name);
+        if (name_len == 0 || name_len >= sizeof(procfs.netdev[0].name)) continue;
+
+        /* rx: bytes packets errs drop fifo frame compressed multicast,
+         * tx: bytes packets errs drop ... */
+        p = colon + 1;
+        for (i = 0; i < 12; i++) {
+            if (!(p = scan_u64(p, &v[i]))) break;
+        }
+        if (i < 12) continue;
+
+        if (procfs.netdev_count == procfs.netdev_cap) {
+            grown = realloc(procfs.netdev, sizeof(procfs_netdev_t) * (procfs.netdev_cap ? procfs.netdev_cap * 2 : 16));
+            if (!grown) break;
+            procfs.netdev = grown;
+            procfs.netdev_cap = procfs.netdev_cap ? procfs.netdev_cap * 2 : 16;
+        }
+
+        dev = &procfs.netdev[procfs.netdev_count];
+        memcpy(dev->name, name, name_len);
+        dev->name[name_len] = '\0';
+        dev->stats.rx_bytes = v[0];
+        dev->stats.rx_packets = v[1];
+        dev->stats.rx_errors = v[2];
+        dev->stats.rx_dropped = v[3];
+        dev->stats.tx_bytes = v[8];
+        dev->stats.tx_packets = v[9];
+        dev->stats.tx_errors = v[10];
+        dev->stats.tx_dropped = v[11];
+        procfs.netdev_count++;
+    }
+    return 1;
+}
+
+#include "linux_netlink.c"
+
+static int procfs_read_netdev(void) {
+    int ok;
+
+    ok = netlink_read_links() || procfs_read_net_dev_file();
+    procfs.netdev_ns = procfs_now_ns();
+    return ok;
+}
+
+/* Re-reads a file if its snapshot is stale; called with procfs_lock held */
+static int procfs_update(procfs_stamp_t *stamp, int (*reader)(void)) {
+    if (!procfs_fresh(stamp)) {
+        procfs_stamp(stamp, reader());
+    }
+    return stamp->ok;
+}
+
+int os_cpu_get_ticks(os_cpu_ticks_t *ticks) {
+    int ok;
+
+    pthread_mutex_lock(&procfs_lock);
+    ok = procfs_update(&procfs.stat_stamp, procfs_read_stat);
+    if (ok) *ticks = procfs.cpu;
+    pthread_mutex_unlock(&procfs_lock);
+    return ok;
+}
+
+void os_cpu_ticks_usage(const os_cpu_ticks_t *prev, const os_cpu_ticks_t *now,
+                        double *total_value, double *system_value) {
+    uint64_t total_diff;
+
+    *total_value = 0.0;
+    *system_value = 0.0;
+    if (prev->total != 0 && now->total > prev->total) {
+        total_diff = now->total - prev->total;
+        *total_value = 100.0 * (1.0 - (double)(now->idle - prev->idle) / total_diff);
+        *system_value = 100.0 * (double)(now->system - prev->system) / total_diff;
+    }
+
+    if (*total_value > 100.0) *total_value = 100.0;
+    if (*total_value < 0.0) *total_value = 0.0;
+    if (*system_value > 100.0) *system_value = 100.0;
+    if (*system_value < 0.0) *system_value = 0.0;
+}
+
+/* Single shared baseline, for callers that don't keep their own */
+int os_cpu_get_stats(double *value) {
+    static os_cpu_ticks_t prev;
+    static pthread_mutex_t prev_lock = PTHREAD_MUTEX_INITIALIZER;
+    double system_value;
+    os_cpu_ticks_t now;
+
+    if (!os_cpu_get_ticks(&now)) return 0;
+
+    pthread_mutex_lock(&prev_lock);
+    os_cpu_ticks_usage(&prev, &now, value, &system_value);
+    prev = now;
+    pthread_mutex_unlock(&prev_lock);
+    return 1;
+}
+
+int os_cpu_get_stats_dual(double *total_value, double *system_value) {
+    static os_cpu_ticks_t prev;
+    static pthread_mutex_t prev_lock = PTHREAD_MUTEX_INITIALIZER;
+    os_cpu_ticks_t now;
+
+    if (!os_cpu_get_ticks(&now)) return 0;
+
+    pthread_mutex_lock(&prev_lock);
+    os_cpu_ticks_usage(&prev, &now, total_value, system_value);
+    prev = now;
+    pthread_mutex_unlock(&prev_lock);
+    return 1;
+}
+
+int os_memory_get_stats(double *value) {
+    uint64_t total_memory, free_memory;
+    int ok;
+
+    pthread_mutex_lock(&procfs_lock);
+    ok = procfs_update(&procfs.meminfo_stamp, procfs_read_meminfo);
+    total_memory = procfs.mem_total;
+    free_memory = procfs.mem_available;
+    pthread_mutex_unlock(&procfs_lock);
+
+    if (!ok || total_memory == 0) return 0;
+
+    *value = (double)(total_memory - free_memory) / (double)total_memory * 100.0;
+
+    if (*value > 100.0) *value = 100.0;
+    if (*value < 0.0) *value = 0.0;
+
+    return 1;
+}
+
+int os_loadavg_get_stats(double *value) {
+    pthread_mutex_lock(&procfs_lock);
+    if (procfs_update(&procfs.loadavg_stamp, procfs_read_loadavg)) {
+        *value = procfs.loadavg1;
+    } else {
+        *value = 0.0;
+    }
+    pthread_mutex_unlock(&procfs_lock);
+
+    if (*value < 0.0) *value = 0.0;
+
+    return 1;
+}
+
+static int procfs_find_interface(const char *interface_name, os_if_stats64_t *stats) {
+    int i;
+    int found;
+
+    found = 0;
+    pthread_mutex_lock(&procfs_lock);
+    if (procfs_update(&procfs.netdev_stamp, procfs_read_netdev)) {
+        for (i = 0; i < procfs.netdev_count; i++) {
+            if (strcmp(procfs.netdev[i].name, interface_name) == 0) {
+                *stats = procfs.netdev[i].stats;
+                stats->time_ns = procfs.netdev_ns;
+                found = 1;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&procfs_lock);
+
+    return found;
+}
+
+int os_get_interface_stats64(const char *interface_name, os_if_stats64_t *stats) {
+    if (!interface_name || !stats) return 0;
+    return procfs_find_interface(interface_name, stats);
+}
+
+int os_get_interface_stats(const char* interface_name, uint32_t* in_bytes, uint32_t* out_bytes) {
+    os_if_stats64_t stats;
+
+    if (!procfs_find_interface(interface_name, &stats)) return 0;
+
+    *in_bytes = (uint32_t)stats.rx_bytes;
+    *out_bytes = (uint32_t)stats.tx_bytes;
+    return 1;
+}
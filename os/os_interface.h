@@ -16,6 +16,21 @@ typedef struct plot_timer_t plot_timer_t;
 int os_cpu_get_stats(double *value);
 int os_cpu_get_stats_dual(double *total_value, double *system_value);
 
+/* Raw cumulative CPU ticks from a shared snapshot; each caller keeps its
+ * own previous sample instead of sharing os_cpu_get_stats' baseline */
+#if defined(__linux__)
+#define OS_HAVE_CPU_TICKS
+typedef struct {
+    uint64_t idle;
+    uint64_t system;    /* system + irq + softirq */
+    uint64_t total;
+} os_cpu_ticks_t;
+int os_cpu_get_ticks(os_cpu_ticks_t *ticks);
+/* Usage in percent between two snapshots, clamped to 0..100 */
+void os_cpu_ticks_usage(const os_cpu_ticks_t *prev, const os_cpu_ticks_t *now,
+                        double *total_value, double *system_value);
+#endif
+
 /* Memory statistics functions */
 int os_memory_get_stats(double *value);
 
@@ -25,6 +40,32 @@ int os_loadavg_get_stats(double *value);
 /* Interface throughput functions - following existing pattern */
 int os_get_interface_stats(const char* interface_name, uint32_t* in_bytes, uint32_t* out_bytes);
 
+/* Full 64-bit interface counters, stamped with the monotonic time they
+ * were read so rates can be taken over sub-second intervals */
+#if defined(__linux__)
+#define OS_HAVE_IF_STATS64
+typedef struct {
+    uint64_t rx_bytes;
+    uint64_t tx_bytes;
+    uint64_t rx_packets;
+    uint64_t tx_packets;
+    uint64_t rx_errors;
+    uint64_t tx_errors;
+    uint64_t rx_dropped;
+    uint64_t tx_dropped;
+    uint64_t time_ns;
+} os_if_stats64_t;
+int os_get_interface_stats64(const char *interface_name, os_if_stats64_t *stats);
+#endif
+
+/* Shared read/write file mappings backing persistent history */
+#if defined(__linux__) || defined(__FreeBSD__) || (defined(__APPLE__) && defined(__MACH__))
+#define OS_HAVE_MAP_FILE
+int os_make_dir(const char *path);
+void *os_map_file(const char *path, size_t size, int *existed, int *handle);
+void os_unmap_file(void *addr, size_t size, int handle);
+#endif
+
 /* Platform detection */
 const char* os_get_platform_name(void);
 
@@ -64,6 +105,12 @@ os_ping_context_t *os_ping_create(const char *hostname, uint32_t timeout_ms);
 int os_ping_send(os_ping_context_t *ctx, double *ping_time_ms);
 void os_ping_destroy(os_ping_context_t *ctx);
 
+/* Asynchronous ping: returns 0 if the probe could not be sent, otherwise
+ * done() is called exactly once with the RTT or a timeout, possibly from
+ * another thread. Platforms without an engine complete synchronously. */
+typedef void (*os_ping_done_fn)(void *arg, int success, double ping_time_ms);
+int os_ping_submit(os_ping_context_t *ctx, os_ping_done_fn done, void *arg);
+
 int os_get_default_gw_ip(char *buf, size_t buflen);
 
 #endif /* OS_INTERFACE_H */
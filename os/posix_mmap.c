@@ -0,0 +1,67 @@
+/*
+ * Shared file mappings for persistent ring buffers.
+ *
+ * Pages are MAP_SHARED, so the kernel writes them back on its own schedule
+ * and on unmap; nothing in the sample path ever calls write(). Each file
+ * is held under an exclusive flock for as long as it is mapped, so a
+ * second plot or process never truncates it under a live mapping.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+
+int os_make_dir(const char *path) {
+    struct stat st;
+
+    if (!path) return 0;
+    if (stat(path, &st) == 0) return S_ISDIR(st.st_mode);
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+/* A new or differently sized file is truncated to size and reads as
+ * zeros; *existed is set only when the file was already exactly size.
+ * Fails when another mapping holds the file; *handle keeps the lock and
+ * goes back to os_unmap_file. */
+void *os_map_file(const char *path, size_t size, int *existed, int *handle) {
+    struct stat st;
+    void *addr;
+    int fd;
+
+    if (!path || size == 0 || !existed || !handle) return NULL;
+    *existed = 0;
+    *handle = -1;
+
+    fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) return NULL;
+
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0 || fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    if ((size_t)st.st_size == size) {
+        *existed = 1;
+    } else if (ftruncate(fd, 0) < 0 || ftruncate(fd, (off_t)size) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    *handle = fd;
+    return addr;
+}
+
+void os_unmap_file(void *addr, size_t size, int handle) {
+    if (addr) munmap(addr, size);
+    if (handle >= 0) close(handle);
+}
@@ -237,6 +237,18 @@ int os_ping_send(os_ping_context_t *ctx, double *ping_time_ms)
     }
 }
 
+int os_ping_submit(os_ping_context_t *ctx, os_ping_done_fn done, void *arg)
+{
+    double ping_time_ms;
+    int success;
+
+    if (!ctx || !done) return 0;
+
+    success = os_ping_send(ctx, &ping_time_ms);
+    done(arg, success, success ? ping_time_ms : -1.0);
+    return 1;
+}
+
 void os_ping_destroy(os_ping_context_t *ctx)
 {
     if (!ctx) return;
@@ -23,30 +23,265 @@ typedef struct {
     double max_value_secondary;
     double avg_value_secondary;
     double last_value_secondary;
+    double quantiles[3];    /* p50, p95, p99 of the primary series */
 } plot_stats_t;
 
 static plot_stats_t plot_stats_cache[32];
+static const double plot_quantiles[3] = { 0.50, 0.95, 0.99 };
+
+/* The plot being drawn reduced to pixel columns, one array per series;
+ * render thread only */
+static ringbuf_m4_t plot_m4[RINGBUF_MAX_COLUMNS][2048];
+static ringbuf_m4_t *const plot_columns[RINGBUF_MAX_COLUMNS] = { plot_m4[0], plot_m4[1] };
+static uint32_t plot_timestamps[2048];
+
+/* Primitives of those columns, collected per color and submitted as one
+ * batch each: bars and error columns are one pixel wide rects */
+static rect_t plot_bars[2048];
+static rect_t plot_gaps[2048];
+static line_t plot_lines[4096];
+
+/* Window rects of the plots drawn this frame, as many as plot_stats_cache */
+static rect_t plot_damage[32];
 static char system_hostname[256] = "";
 
-static void calculate_stats(plot_t *plot, data_source_t *data_source, uint32_t plot_index) {
-    if (!plot) return;
-
-    if (data_source && data_source->datasource && data_source->datasource->handler->get_stats) {
-        datasource_stats_t ds_stats;
-        if (data_source->datasource->handler->get_stats(data_source->datasource->context, &ds_stats) == 1) {
-            plot_stats_cache[plot_index].min_value = ds_stats.min;
-            plot_stats_cache[plot_index].max_value = ds_stats.max;
-            plot_stats_cache[plot_index].avg_value = ds_stats.avg;
-            plot_stats_cache[plot_index].last_value = ds_stats.last;
-            plot_stats_cache[plot_index].min_value_secondary = ds_stats.min_secondary;
-            plot_stats_cache[plot_index].max_value_secondary = ds_stats.max_secondary;
-            plot_stats_cache[plot_index].avg_value_secondary = ds_stats.avg_secondary;
-            plot_stats_cache[plot_index].last_value_secondary = ds_stats.last_secondary;
+/* Statistics over the samples in the buffer, kept current by every push,
+ * so this is O(1) and reads a consistent snapshot */
+static void calculate_stats(plot_t *plot, uint32_t plot_index) {
+    ringbuf_stats_t stats;
+
+    if (!plot || !plot->data_buffer) return;
+
+    if (ringbuf_get_stats(plot->data_buffer, 0, &stats)) {
+        plot_stats_cache[plot_index].min_value = stats.min;
+        plot_stats_cache[plot_index].max_value = stats.max;
+        plot_stats_cache[plot_index].avg_value = stats.avg;
+        plot_stats_cache[plot_index].last_value = stats.last;
+        plot_stats_cache[plot_index].quantiles[0] = stats.p50;
+        plot_stats_cache[plot_index].quantiles[1] = stats.p95;
+        plot_stats_cache[plot_index].quantiles[2] = stats.p99;
+    }
+    if (plot->is_dual && ringbuf_get_stats(plot->data_buffer, 1, &stats)) {
+        plot_stats_cache[plot_index].min_value_secondary = stats.min;
+        plot_stats_cache[plot_index].max_value_secondary = stats.max;
+        plot_stats_cache[plot_index].avg_value_secondary = stats.avg;
+        plot_stats_cache[plot_index].last_value_secondary = stats.last;
+    }
+}
+
+
+static void plot_format_value(plot_t *plot, double value, const char *unit, char *buffer, size_t buffer_size) {
+    if (plot->data_source && plot->data_source->datasource && plot->data_source->datasource->handler->format_value) {
+        plot->data_source->datasource->handler->format_value(value, buffer, buffer_size);
+    } else if (strlen(unit) > 0) {
+        snprintf(buffer, buffer_size, "%.1f%s", value, unit);
+    } else {
+        snprintf(buffer, buffer_size, "%.1f", value);
+    }
+}
+
+/* Draws the columns up to limit pixels from the right edge of a w x h plot
+ * area at (ox, oy). The column just past limit is not drawn but starts the
+ * secondary line, so a partial redraw joins what is already there. */
+static void plot_draw_columns(plot_t *plot, renderer_t *renderer, config_t *global_config,
+                              int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t data_count,
+                              uint32_t now_ms, double ms_per_px, double max_val, int32_t limit) {
+    const ringbuf_m4_t *col, *in_col, *out_col;
+    int32_t prev_out_x, prev_out_y;
+    int32_t plot_x, plot_bottom, pixel_offset;
+    int32_t out_y, out_top, out_bottom;
+    int32_t bar_height;
+    uint32_t i, bars, gaps, lines;
+    line_t *line;
+
+    plot_bottom = oy + h - 1;
+    bars = gaps = lines = 0;
+    prev_out_x = -1;
+    prev_out_y = -1;
+
+    for (i = 0; i < data_count; i++) {
+        col = in_col = &plot_columns[0][i];
+        out_col = plot->is_dual ? &plot_columns[1][i] : NULL;
+
+        pixel_offset = (int32_t)((now_ms - plot_timestamps[i]) / ms_per_px);
+        plot_x = ox + w - 1 - pixel_offset;
+        if (out_col && pixel_offset == limit + 1 && pixel_offset < w && in_col->count > 0 && out_col->count > 0) {
+            prev_out_x = plot_x;
+            prev_out_y = plot_bottom - (int32_t)((out_col->last / max_val) * (h - 1));
+            continue;
+        }
+        if (pixel_offset < 0 || pixel_offset > limit) {
+            prev_out_x = prev_out_y = -1;
+            continue;
+        }
+
+        if (col->count == 0 || (out_col && out_col->count == 0)) {
+            plot_gaps[gaps].x = plot_x;
+            plot_gaps[gaps].y = oy;
+            plot_gaps[gaps].w = 1;
+            plot_gaps[gaps].h = h;
+            gaps++;
+            prev_out_x = prev_out_y = -1;
+            continue;
+        }
+
+        bar_height = (int32_t)((col->max / max_val) * (h - 1));
+        if (bar_height < 1) bar_height = 1;
+        plot_bars[bars].x = plot_x;
+        plot_bars[bars].y = plot_bottom - bar_height;
+        plot_bars[bars].w = 1;
+        plot_bars[bars].h = bar_height + 1;
+        bars++;
+
+        if (!out_col) continue;
+
+        /* the line enters the column at its first sample, spans
+         * its range and leaves from its last */
+        out_y = plot_bottom - (int32_t)((out_col->first / max_val) * (h - 1));
+        out_top = plot_bottom - (int32_t)((out_col->max / max_val) * (h - 1));
+        out_bottom = plot_bottom - (int32_t)((out_col->min / max_val) * (h - 1));
+
+        if (prev_out_x >= 0 && prev_out_y >= 0) {
+            line = &plot_lines[lines++];
+            line->x1 = prev_out_x;
+            line->y1 = prev_out_y;
+            line->x2 = plot_x;
+            line->y2 = out_y;
+        }
+        if (out_top != out_bottom || prev_out_x < 0) {
+            line = &plot_lines[lines++];
+            line->x1 = plot_x;
+            line->y1 = out_top;
+            line->x2 = plot_x;
+            line->y2 = out_bottom;
         }
+
+        prev_out_x = plot_x;
+        prev_out_y = plot_bottom - (int32_t)((out_col->last / max_val) * (h - 1));
+    }
+
+    /* the second series goes over the bars */
+    if (gaps > 0) {
+        renderer_set_color(renderer, global_config->error_line_color);
+        renderer_fill_rects(renderer, plot_gaps, gaps);
+    }
+    if (bars > 0) {
+        renderer_set_color(renderer, plot->config->line_color);
+        renderer_fill_rects(renderer, plot_bars, bars);
+    }
+    if (lines > 0) {
+        renderer_set_color(renderer, plot->config->line_color_secondary);
+        renderer_draw_lines(renderer, plot_lines, lines);
     }
 }
 
+/* What plot_surface_begin decided for the frame being drawn */
+typedef struct {
+    int full;               /* the whole surface is drawn again */
+    int32_t shift;          /* columns scrolled since the last frame */
+    uint32_t anchor_ms;
+    uint32_t columns;       /* columns scrolled since anchor_ms */
+    int source;             /* RINGBUF_SPAN_RAW, _ARCHIVE or the tier */
+    uint32_t head;
+} plot_frame_t;
+
+/* Keeps a surface the size of the plot area and puts the frame on its
+ * column grid: the returned time is a whole number of columns after the
+ * anchor, so everything drawn earlier is still exactly shift columns off.
+ * A new size, scale step or source starts a new grid. */
+static uint32_t plot_surface_begin(plot_t *plot, renderer_t *renderer, int32_t w, int32_t h,
+                                   uint32_t now_ms, double ms_per_px, int source, plot_frame_t *frame) {
+    uint32_t elapsed, columns;
+
+    if (plot->surface && (plot->surface->width != w || plot->surface->height != h)) {
+        surface_destroy(renderer, plot->surface);
+        plot->surface = NULL;
+    }
+    if (!plot->surface && w > 0 && h > 0) {
+        plot->surface = surface_create(renderer, w, h);
+        plot->surface_valid = 0;
+    }
 
+    frame->full = !plot->surface || !plot->surface_valid ||
+                  plot->surface_ms_per_px != ms_per_px || plot->surface_source != source;
+    frame->shift = 0;
+    frame->source = source;
+    frame->head = plot->data_buffer->head;
+
+    if (!frame->full) {
+        elapsed = now_ms - plot->surface_anchor_ms;
+        columns = (uint32_t)(elapsed / ms_per_px);
+        if ((int32_t)elapsed >= 0 && columns >= plot->surface_columns) {
+            frame->anchor_ms = plot->surface_anchor_ms;
+            frame->columns = columns;
+            frame->shift = (int32_t)(columns - plot->surface_columns);
+            return plot->surface_anchor_ms + (uint32_t)(columns * ms_per_px);
+        }
+        frame->full = 1;
+    }
+    frame->anchor_ms = now_ms;
+    frame->columns = 0;
+    return now_ms;
+}
+
+/* Draws the plot area at (ox, oy). With a surface, it scrolls by the
+ * frame's shift and only the columns scrolled in or holding samples newer
+ * than the last drawn are drawn again before it is copied to the window;
+ * a new scale redraws it all. Without one, every column is drawn. */
+static void plot_draw_area(plot_t *plot, renderer_t *renderer, config_t *global_config,
+                           int32_t ox, int32_t oy, int32_t w, int32_t h, uint32_t data_count,
+                           uint32_t now_ms, double ms_per_px, double max_val, const plot_frame_t *frame) {
+    rect_t clear;
+    uint32_t newest;
+    int32_t limit, drawn_offset;
+
+    if (!plot->surface) {
+        plot_draw_columns(plot, renderer, global_config, ox, oy, w, h, data_count, now_ms, ms_per_px, max_val, w - 1);
+        return;
+    }
+
+    newest = (data_count > 0) ? plot_timestamps[data_count - 1] : plot->surface_drawn_ms;
+
+    limit = w - 1;
+    if (!frame->full && max_val == plot->surface_max) {
+        if (frame->source >= 0) {
+            /* the open bucket of a tier changes with every push */
+            limit = (frame->shift > 0 || frame->head != plot->surface_head) ? w - 1 : -1;
+        } else {
+            limit = frame->shift - 1;
+            if (newest != plot->surface_drawn_ms) {
+                drawn_offset = (int32_t)((now_ms - plot->surface_drawn_ms) / ms_per_px);
+                if (drawn_offset > limit) limit = drawn_offset;
+            }
+            if (limit > w - 1) limit = w - 1;
+        }
+    }
+
+    if (limit < w - 1 && frame->shift > 0) {
+        surface_scroll(renderer, plot->surface, frame->shift);
+    }
+    if (limit >= 0) {
+        renderer_set_target(renderer, plot->surface);
+        clear.x = w - 1 - limit;
+        clear.y = 0;
+        clear.w = limit + 1;
+        clear.h = h;
+        renderer_set_color(renderer, global_config->background_color);
+        renderer_fill_rect(renderer, clear);
+        plot_draw_columns(plot, renderer, global_config, 0, 0, w, h, data_count, now_ms, ms_per_px, max_val, limit);
+        renderer_set_target(renderer, NULL);
+    }
+    renderer_draw_surface(renderer, plot->surface, ox, oy);
+
+    plot->surface_valid = 1;
+    plot->surface_source = frame->source;
+    plot->surface_ms_per_px = ms_per_px;
+    plot->surface_max = max_val;
+    plot->surface_anchor_ms = frame->anchor_ms;
+    plot->surface_columns = frame->columns;
+    plot->surface_drawn_ms = newest;
+    plot->surface_head = frame->head;
+}
 
 void plot_draw(plot_t *plot, renderer_t *renderer, font_t *font,
                int32_t x, int32_t y, int32_t width, int32_t height, config_t *global_config, uint32_t plot_index,
@@ -61,22 +296,18 @@ void plot_draw(plot_t *plot, renderer_t *renderer, font_t *font,
     const char* unit;
     int32_t scale_text_width, scale_text_height;
     int32_t scale_x;
-    double temp_buffer[2048];
-    double temp_buffer_secondary[2048];
-    uint32_t temp_timestamps[2048];
-    uint32_t data_count, head_pos, tail_pos;
-    uint32_t data_count_secondary, head_pos_secondary, tail_pos_secondary;
-    int32_t prev_out_x, prev_out_y;
+    ringbuf_span_t span;
+    uint32_t data_count;
+    int whole_ring, intact;
+    plot_frame_t frame;
+    const ringbuf_m4_t *col;
     uint32_t i;
-    double in_value, out_value;
-    int32_t plot_x, plot_bottom;
-    int32_t in_bar_height, out_bar_height, out_y;
-    double value;
-    int32_t bar_height;
     int32_t text_width, text_height;
     int32_t text_x;
-    uint32_t buffer_size;
     int32_t refresh_interval;
+    uint32_t span_ms;
+    double ms_per_px;
+    int span_source;
     uint32_t total_time_ms;
     char time_span_text[64];
     uint32_t minutes, hours, days;
@@ -88,13 +319,11 @@ void plot_draw(plot_t *plot, renderer_t *renderer, font_t *font,
     char avg_formatted[64];
     char last_formatted[64];
     uint32_t now_ms;
-    int32_t pixel_offset;
     int32_t plot_max_offset;
-    uint32_t dual_count;
 
     if (!plot || !renderer || !font) return;
     
-    calculate_stats(plot, plot->data_source, plot_index);
+    calculate_stats(plot, plot_index);
     
     border_color = global_config->border_color;
     renderer_set_color(renderer, border_color);
@@ -133,15 +362,6 @@ void plot_draw(plot_t *plot, renderer_t *renderer, font_t *font,
         unit = "";
     }
 
-    if (!ringbuf_read_snapshot(plot->data_buffer, temp_buffer, temp_timestamps, 2048, &data_count, &head_pos, &tail_pos))
-        return;
-
-    if (plot->is_dual && plot->data_buffer_secondary) {
-        if (!ringbuf_read_snapshot(plot->data_buffer_secondary, temp_buffer_secondary, NULL, 2048,
-                                  &data_count_secondary, &head_pos_secondary, &tail_pos_secondary))
-            return;
-    }
-
     now_ms = os_get_time_ms();
     refresh_interval = (plot->config->refresh_interval_ms > 0) ?
                       plot->config->refresh_interval_ms :
@@ -149,18 +369,47 @@ void plot_draw(plot_t *plot, renderer_t *renderer, font_t *font,
     plot_max_offset = width - 3;
     if (plot_max_offset < 0) plot_max_offset = 0;
 
+    /* by default one pixel per sample, as wide as the raw buffer reaches */
+    span_ms = plot->config->span_ms ? plot->config->span_ms : global_config->span_ms;
+    if (span_ms == 0) span_ms = (uint32_t)plot_max_offset * (uint32_t)refresh_interval;
+    ms_per_px = (plot_max_offset > 0) ? (double)span_ms / plot_max_offset : 1.0;
+    if (ms_per_px < 1.0) ms_per_px = 1.0;
+
+    span_source = ringbuf_span_source(plot->data_buffer, now_ms, span_ms, (uint32_t)refresh_interval);
+
+    now_ms = plot_surface_begin(plot, renderer, width - 2, plot_height - 3, now_ms, ms_per_px,
+                                span_source, &frame);
+
+    /* Whatever the source, the span is reduced to one M4 column per
+     * pixel, so drawing costs the width however many samples are on
+     * screen and a spike always keeps its column. Raw rows torn by the
+     * producer only cost one odd frame: the surface is then drawn again
+     * from scratch. */
+    if (!ringbuf_read_span(plot->data_buffer, span_source, now_ms, span_ms, ms_per_px,
+                           plot_columns, plot_timestamps, 2048, &span))
+        return;
+    data_count = span.count;
+    whole_ring = span.whole_ring;
+    intact = span.intact;
+
     if (fixed_max_scale > 0.0) {
         max_val = fixed_max_scale;
+    } else if (whole_ring) {
+        max_val = plot_stats_cache[plot_index].max_value;
+        if (plot->is_dual && plot_stats_cache[plot_index].max_value_secondary > max_val)
+            max_val = plot_stats_cache[plot_index].max_value_secondary;
+        if (max_val <= 0.0)
+            max_val = 1.0;
     } else {
         max_val = 0.0;
         for (i = 0; i < data_count; i++) {
-            if (temp_buffer[i] > max_val)
-                max_val = temp_buffer[i];
+            if (plot_columns[0][i].count > 0 && plot_columns[0][i].max > max_val)
+                max_val = plot_columns[0][i].max;
         }
         if (plot->is_dual) {
-            for (i = 0; i < data_count_secondary; i++) {
-                if (temp_buffer_secondary[i] > max_val)
-                    max_val = temp_buffer_secondary[i];
+            for (i = 0; i < data_count; i++) {
+                if (plot_columns[1][i].count > 0 && plot_columns[1][i].max > max_val)
+                    max_val = plot_columns[1][i].max;
             }
         }
         if (max_val <= 0.0)
@@ -182,72 +431,10 @@ void plot_draw(plot_t *plot, renderer_t *renderer, font_t *font,
     scale_x = x + width - scale_text_width;
     font_draw_text(renderer, font, global_config->text_color, scale_x, y + 5, scale_text);
 
-    if (plot->is_dual && plot->data_buffer_secondary) {
-        prev_out_x = -1;
-        prev_out_y = -1;
-        dual_count = (data_count < data_count_secondary) ? data_count : data_count_secondary;
+    plot_draw_area(plot, renderer, global_config, x + 1, plot_y + 2, width - 2, plot_height - 3,
+                   data_count, now_ms, ms_per_px, max_val, &frame);
+    if (!intact) plot->surface_valid = 0;
 
-        for (i = 0; i < dual_count; i++) {
-            in_value = temp_buffer[i];
-            out_value = temp_buffer_secondary[i];
-
-            pixel_offset = (int32_t)((now_ms - temp_timestamps[i]) / (uint32_t)refresh_interval);
-            if (pixel_offset < 0 || pixel_offset > plot_max_offset) {
-                prev_out_x = prev_out_y = -1;
-                continue;
-            }
-            plot_x = x + width - 2 - pixel_offset;
-            plot_bottom = plot_y + plot_height - 2;
-
-            if (in_value < 0 || out_value < 0) {
-                renderer_set_color(renderer, global_config->error_line_color);
-                renderer_draw_line(renderer, plot_x, plot_y + 2, plot_x, plot_bottom);
-                prev_out_x = prev_out_y = -1;
-            } else {
-                in_bar_height = (int32_t)((in_value / max_val) * (plot_height - 4));
-                if (in_bar_height < 1) in_bar_height = 1;
-
-                renderer_set_color(renderer, plot->config->line_color);
-                renderer_draw_line(renderer, plot_x, plot_bottom - in_bar_height, plot_x, plot_bottom);
-
-                out_bar_height = (int32_t)((out_value / max_val) * (plot_height - 4));
-                out_y = plot_bottom - out_bar_height;
-
-                renderer_set_color(renderer, plot->config->line_color_secondary);
-
-                if (prev_out_x >= 0 && prev_out_y >= 0) {
-                    renderer_draw_line(renderer, prev_out_x, prev_out_y, plot_x, out_y);
-                } else {
-                    renderer_draw_line(renderer, plot_x, out_y, plot_x, out_y);
-                }
-
-                prev_out_x = plot_x;
-                prev_out_y = out_y;
-            }
-        }
-    } else {
-        dual_count = data_count;
-        for (i = 0; i < data_count; i++) {
-            value = temp_buffer[i];
-
-            pixel_offset = (int32_t)((now_ms - temp_timestamps[i]) / (uint32_t)refresh_interval);
-            if (pixel_offset < 0 || pixel_offset > plot_max_offset) continue;
-            plot_x = x + width - 2 - pixel_offset;
-            plot_bottom = plot_y + plot_height - 2;
-
-            if (value < 0) {
-                renderer_set_color(renderer, global_config->error_line_color);
-                renderer_draw_line(renderer, plot_x, plot_y + 2, plot_x, plot_bottom);
-            } else {
-                bar_height = (int32_t)((value / max_val) * (plot_height - 4));
-                if (bar_height < 1) bar_height = 1;
-
-                renderer_set_color(renderer, plot->config->line_color);
-                renderer_draw_line(renderer, plot_x, plot_bottom - bar_height, plot_x, plot_bottom);
-            }
-        }
-    }
-    
     if (plot->data_source && plot->data_source->datasource && plot->data_source->datasource->handler->format_value) {
         plot->data_source->datasource->handler->format_value(plot_stats_cache[plot_index].avg_value, avg_formatted, sizeof(avg_formatted));
         plot->data_source->datasource->handler->format_value(plot_stats_cache[plot_index].last_value, last_formatted, sizeof(last_formatted));
@@ -278,8 +465,7 @@ void plot_draw(plot_t *plot, renderer_t *renderer, font_t *font,
     text_x = x + width - text_width;
     font_draw_text(renderer, font, global_config->text_color, text_x, y + height - 15, stats_text);
 
-    buffer_size = plot->data_buffer->size;
-    total_time_ms = buffer_size * (uint32_t)refresh_interval;
+    total_time_ms = span_ms;
     if (total_time_ms < 60000) {
         snprintf(time_span_text, sizeof(time_span_text), "%us", total_time_ms / 1000);
     } else if (total_time_ms < 86400000) {
@@ -306,7 +492,9 @@ void plot_draw(plot_t *plot, renderer_t *renderer, font_t *font,
         int32_t best_distance;
         int hover_found;
         double hover_value;
-        char hover_text[128];
+        double quantile_values[3];
+        char quantile_text[3][32];
+        char hover_text[256];
         int32_t hover_text_width, hover_text_height;
         int32_t hover_text_x, hover_text_y;
         uint32_t time_offset_ms;
@@ -324,8 +512,8 @@ void plot_draw(plot_t *plot, renderer_t *renderer, font_t *font,
         hover_found = 0;
         best_distance = 3;
         data_index = 0;
-        for (i = 0; i < dual_count; i++) {
-            sample_pixel_offset = (int32_t)((now_ms - temp_timestamps[i]) / (uint32_t)refresh_interval);
+        for (i = 0; i < data_count; i++) {
+            sample_pixel_offset = (int32_t)((now_ms - plot_timestamps[i]) / ms_per_px);
             if (sample_pixel_offset < 0 || sample_pixel_offset > plot_max_offset) continue;
             sample_plot_x = x + width - 2 - sample_pixel_offset;
             distance = sample_plot_x - hover_x;
@@ -339,10 +527,16 @@ void plot_draw(plot_t *plot, renderer_t *renderer, font_t *font,
 
         if (hover_found) {
             double hover_value_secondary;
-            hover_value = temp_buffer[data_index];
-            hover_value_secondary = (plot->is_dual && data_index < data_count_secondary) ? temp_buffer_secondary[data_index] : 0.0;
+            /* a column shows its peak, as the bar does */
+            col = &plot_columns[0][data_index];
+            hover_value = (col->count > 0) ? col->max : -1.0;
+            hover_value_secondary = 0.0;
+            if (plot->is_dual) {
+                col = &plot_columns[1][data_index];
+                hover_value_secondary = (col->count > 0) ? col->max : -1.0;
+            }
 
-            time_offset_ms = now_ms - temp_timestamps[data_index];
+            time_offset_ms = now_ms - plot_timestamps[data_index];
             time_seconds = time_offset_ms / 1000;
             time_minutes = time_seconds / 60;
             time_hours = time_minutes / 60;
@@ -369,7 +563,18 @@ void plot_draw(plot_t *plot, renderer_t *renderer, font_t *font,
                 }
             }
 
-            snprintf(hover_text, sizeof(hover_text), "%s - %s", value_text, time_text);
+            /* tails over what is on screen: the window's own sketch, or
+             * the merged sketches of the tier covering the span */
+            if (!ringbuf_span_quantiles(plot->data_buffer, span_source, 0, now_ms, span_ms,
+                                        plot_quantiles, quantile_values, 3)) {
+                memcpy(quantile_values, plot_stats_cache[plot_index].quantiles, sizeof(quantile_values));
+            }
+            for (i = 0; i < 3; i++) {
+                plot_format_value(plot, quantile_values[i], unit, quantile_text[i], sizeof(quantile_text[i]));
+            }
+
+            snprintf(hover_text, sizeof(hover_text), "%s - %s  p50 %s p95 %s p99 %s", value_text, time_text,
+                     quantile_text[0], quantile_text[1], quantile_text[2]);
             font_get_text_size(font, hover_text, &hover_text_width, &hover_text_height);
 
             hover_text_x = guide_x + 5;
@@ -388,6 +593,7 @@ void plot_draw(plot_t *plot, renderer_t *renderer, font_t *font,
             font_draw_text(renderer, font, border_color, hover_text_x, hover_text_y, hover_text);
         }
     }
+
 }
 
 plot_system_t *plot_system_create(config_t *config) {
@@ -482,6 +688,7 @@ plot_system_t *plot_system_create(config_t *config) {
 
     system->mouse_x = -1;
     system->mouse_y = -1;
+    system->mouse_moved = 0;
 
     for (i = 0; i < system->plot_count; i++) {
         plot_t *plot = &system->plots[i];
@@ -494,18 +701,25 @@ plot_system_t *plot_system_create(config_t *config) {
         plot->active = 1;
 
         plot->cached_data_count = 0;
-        plot->cached_data_count_secondary = 0;
         plot->cached_head_position = 0;
-        plot->cached_head_position_secondary = 0;
         plot->stats_dirty = 1;
+        plot->hover_drawn = 0;
+
+        plot->surface = NULL;
+        plot->surface_valid = 0;
     }
     
     return system;
 }
 
 void plot_system_destroy(plot_system_t *system) {
+    uint32_t i;
+
     if (!system) return;
     
+    for (i = 0; i < system->plot_count; i++) {
+        if (system->plots[i].surface) surface_destroy(system->renderer, system->plots[i].surface);
+    }
     font_destroy(system->font);
     renderer_destroy(system->renderer);
     window_destroy(system->window);
@@ -519,7 +733,6 @@ void plot_system_connect_data_buffers(plot_system_t *system, data_collector_t *c
 
     for (i = 0; i < system->plot_count && i < collector->source_count; i++) {
         system->plots[i].data_buffer = collector->sources[i].data_buffer;
-        system->plots[i].data_buffer_secondary = collector->sources[i].data_buffer_secondary;
         system->plots[i].data_source = &collector->sources[i];
         system->plots[i].is_dual = collector->sources[i].is_dual;
     }
@@ -530,7 +743,8 @@ static int plot_system_needs_redraw(plot_system_t *system) {
 
     if (!system) return 0;
 
-    if (window_was_resized() || system->window_size_dirty || system->needs_redraw) {
+    if (window_was_resized() || system->window_size_dirty || system->needs_redraw ||
+        system->mouse_moved) {
         return 1;
     }
     for (i = 0; i < system->plot_count; i++) {
@@ -541,12 +755,6 @@ static int plot_system_needs_redraw(plot_system_t *system) {
             plot->cached_head_position != plot->data_buffer->head) {
             return 1;
         }
-
-        if (plot->is_dual && plot->data_buffer_secondary &&
-            (plot->cached_data_count_secondary != plot->data_buffer_secondary->count ||
-             plot->cached_head_position_secondary != plot->data_buffer_secondary->head)) {
-            return 1;
-        }
     }
 
     return 0;
@@ -560,6 +768,8 @@ int plot_system_update(plot_system_t *system) {
     int32_t plot_height;
     int32_t plot_spacing;
     int32_t margin;
+    int partial;
+    uint32_t damage_count;
     uint32_t i;
 
     if (!system) return 0;
@@ -587,7 +797,7 @@ int plot_system_update(plot_system_t *system) {
             case GRAPHICS_EVENT_MOUSE_MOTION:
                 system->mouse_x = event.mouse_x;
                 system->mouse_y = event.mouse_y;
-                system->needs_redraw = 1;
+                system->mouse_moved = 1;
                 break;
             case GRAPHICS_EVENT_NONE:
             case GRAPHICS_EVENT_KEY_PRESS:
@@ -622,20 +832,9 @@ int plot_system_update(plot_system_t *system) {
         needs_full_render = 1;
     }
 
+    /* history is sized by the config, so a new width is only a redraw */
     current_plot_width = system->cached_window_width - (system->config->window_margin * 2);
     if (system->last_plot_width != current_plot_width) {
-        uint32_t new_buffer_size;
-        new_buffer_size = current_plot_width - 2;
-        if (new_buffer_size > 0) {
-            for (i = 0; i < system->plot_count; i++) {
-                if (system->plots[i].data_buffer) {
-                    ringbuf_resize(system->plots[i].data_buffer, new_buffer_size);
-                }
-                if (system->plots[i].data_buffer_secondary) {
-                    ringbuf_resize(system->plots[i].data_buffer_secondary, new_buffer_size);
-                }
-            }
-        }
         system->last_plot_width = current_plot_width;
         system->needs_redraw = 1;
         needs_full_render = 1;
@@ -645,14 +844,36 @@ int plot_system_update(plot_system_t *system) {
         return 1;
     }
 
+    /* backends may drop offscreen pixels along with the window's */
+    if (needs_full_render) {
+        for (i = 0; i < system->plot_count; i++) {
+            system->plots[i].surface_valid = 0;
+        }
+    }
+
     plot_height = system->config->default_height;
     margin = system->config->window_margin;
     plot_spacing = 10;
 
-    renderer_clear(system->renderer, system->config->background_color);
+    /* Anything that touches the whole window redraws every plot. Else,
+     * where the backend keeps the frame, only plots whose series moved
+     * or that the cursor is over or just left are drawn and put on
+     * screen, so a 1s plot does not redraw a 60s one beside it. */
+    partial = !system->needs_redraw && !needs_full_render && !system->config->fps_counter &&
+              system->plot_count <= sizeof(plot_damage) / sizeof(plot_damage[0]) &&
+              renderer_keeps_frame(system->renderer);
+    damage_count = 0;
+
+    if (!partial) {
+        renderer_clear(system->renderer, system->config->background_color);
+    }
     for (i = 0; i < system->plot_count; i++) {
+        plot_t *plot = &system->plots[i];
         int32_t y;
         int32_t hover_x, hover_y;
+        uint32_t data_count, data_head;
+        int data_changed;
+        rect_t damage;
         y = i * (plot_height + plot_spacing) + margin;
 
         hover_x = -1;
@@ -663,14 +884,41 @@ int plot_system_update(plot_system_t *system) {
             hover_y = system->mouse_y;
         }
 
-        plot_draw(&system->plots[i], system->renderer, system->font,
+        /* read once: a sample landing while drawing is caught next frame */
+        data_count = plot->data_buffer ? plot->data_buffer->count : 0;
+        data_head = plot->data_buffer ? plot->data_buffer->head : 0;
+        data_changed = plot->data_buffer &&
+                       (plot->cached_data_count != data_count || plot->cached_head_position != data_head);
+
+        if (partial) {
+            if (!data_changed && !(system->mouse_moved && (hover_x >= 0 || plot->hover_drawn)))
+                continue;
+            damage.x = margin;
+            damage.y = y;
+            damage.w = current_plot_width;
+            damage.h = plot_height;
+            renderer_set_color(system->renderer, system->config->background_color);
+            renderer_fill_rect(system->renderer, damage);
+            plot_damage[damage_count++] = damage;
+        }
+
+        plot_draw(plot, system->renderer, system->font,
                   margin, y, current_plot_width, plot_height, system->config, i, hover_x, hover_y);
-    }
 
-    graphics_draw_fps_counter(system->renderer, system->font, system->config->fps_counter);
+        /* until the next sample lands, there is nothing new to draw */
+        plot->hover_drawn = (hover_x >= 0);
+        plot->cached_data_count = data_count;
+        plot->cached_head_position = data_head;
+    }
 
-    renderer_present(system->renderer);
+    if (!partial) {
+        graphics_draw_fps_counter(system->renderer, system->font, system->config->fps_counter);
+        renderer_present(system->renderer);
+    } else if (damage_count > 0) {
+        renderer_present_rects(system->renderer, plot_damage, damage_count);
+    }
 
+    system->mouse_moved = 0;
     system->needs_redraw = 0;
 
     return 1;
@@ -9,18 +9,29 @@
 
 typedef struct {
     plot_config_t *config;
-    ringbuf_t *data_buffer;
-    ringbuf_t *data_buffer_secondary; // For dual-line plots (OUT data)
+    ringbuf_t *data_buffer; // Two columns for dual-line plots (IN, OUT)
     data_source_t *data_source; // Reference to data source for statistics
     int active;
     int is_dual; // True for dual-line plots like SNMP
 
     /* Statistics caching fields */
     uint32_t cached_data_count;
-    uint32_t cached_data_count_secondary;
     uint32_t cached_head_position;
-    uint32_t cached_head_position_secondary;
     int stats_dirty;
+    int hover_drawn;            /* last drawn with the hover guide */
+
+    /* Plot area kept between frames, NULL where the backend cannot keep
+     * one. Columns sit on a grid of surface_ms_per_px steps from
+     * surface_anchor_ms, so scrolling by whole columns keeps them valid. */
+    surface_t *surface;
+    int surface_valid;
+    int surface_source;         /* RINGBUF_SPAN_RAW, _ARCHIVE or the tier */
+    double surface_ms_per_px;
+    double surface_max;
+    uint32_t surface_anchor_ms;
+    uint32_t surface_columns;   /* columns scrolled since the anchor */
+    uint32_t surface_drawn_ms;  /* newest sample drawn */
+    uint32_t surface_head;
 } plot_t;
 
 typedef struct {
@@ -47,6 +58,7 @@ typedef struct {
     /* Mouse tracking */
     int32_t mouse_x;
     int32_t mouse_y;
+    int mouse_moved;
 
 } plot_system_t;
 
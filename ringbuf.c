@@ -1,257 +1,1385 @@
 #include "compat.h"
 #include "ringbuf.h"
 #include "os/os_interface.h"
+#include <math.h>
 #include <stdlib.h>
 #include <string.h>
 
-ringbuf_t *ringbuf_create(uint32_t size) {
+/* Gives up after this many torn reads; the caller draws the next frame */
+#define RINGBUF_READ_ATTEMPTS 64
+
+static void ringbuf_barrier(ringbuf_t *ringbuf) {
+#ifdef SNG_HAVE_BARRIER
+    (void)ringbuf;
+    sng_barrier();
+#else
+    os_plot_mutex_lock(ringbuf->barrier_mutex);
+    os_plot_mutex_unlock(ringbuf->barrier_mutex);
+#endif
+}
+
+static void ringbuf_window_free(ringbuf_window_t *window, uint32_t columns) {
+    uint32_t c;
+
+    for (c = 0; c < columns; c++) {
+        free(window[c].min_slots);
+        free(window[c].max_slots);
+        window[c].min_slots = NULL;
+        window[c].max_slots = NULL;
+    }
+}
+
+static int ringbuf_window_alloc(ringbuf_window_t *window, uint32_t columns, uint32_t size) {
+    uint32_t c;
+
+    for (c = 0; c < RINGBUF_MAX_COLUMNS; c++) {
+        memset(&window[c], 0, sizeof(window[c]));
+    }
+    for (c = 0; c < columns; c++) {
+        window[c].min_slots = malloc(sizeof(uint32_t) * size);
+        window[c].max_slots = malloc(sizeof(uint32_t) * size);
+        if (!window[c].min_slots || !window[c].max_slots) {
+            ringbuf_window_free(window, c + 1);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Neumaier's compensated addition: the rounding lost from sum is carried
+ * in sum_error, so a window that has seen millions of adds and removes
+ * still averages to what its rows add up to */
+static void ringbuf_window_sum(ringbuf_window_t *w, double x) {
+    double t;
+
+    t = w->sum + x;
+    if (fabs(w->sum) >= fabs(x)) {
+        w->sum_error += (w->sum - t) + x;
+    } else {
+        w->sum_error += (x - t) + w->sum;
+    }
+    w->sum = t;
+}
+
+/* Takes the row at slot into every column's window. Slots the new value
+ * dominates are dropped from the deque backs: they leave the window
+ * before it does, so they can never be its min or max again. */
+static void ringbuf_window_add(ringbuf_t *ringbuf, uint32_t slot) {
+    ringbuf_window_t *w;
+    const double *data;
+    double value;
+    uint32_t c, pos;
+
+    for (c = 0; c < ringbuf->columns; c++) {
+        w = &ringbuf->window[c];
+        data = ringbuf->data[c];
+        value = data[slot];
+        if (value < 0) {
+            w->errors++;
+            continue;
+        }
+
+        while (w->max_len > 0) {
+            pos = w->max_head + w->max_len - 1;
+            if (pos >= ringbuf->size) pos -= ringbuf->size;
+            if (data[w->max_slots[pos]] > value) break;
+            w->max_len--;
+        }
+        pos = w->max_head + w->max_len;
+        if (pos >= ringbuf->size) pos -= ringbuf->size;
+        w->max_slots[pos] = slot;
+        w->max_len++;
+
+        while (w->min_len > 0) {
+            pos = w->min_head + w->min_len - 1;
+            if (pos >= ringbuf->size) pos -= ringbuf->size;
+            if (data[w->min_slots[pos]] < value) break;
+            w->min_len--;
+        }
+        pos = w->min_head + w->min_len;
+        if (pos >= ringbuf->size) pos -= ringbuf->size;
+        w->min_slots[pos] = slot;
+        w->min_len++;
+
+        ringbuf_window_sum(w, value);
+        w->count++;
+        w->last = value;
+        sketch_window_add(&w->sketch, value);
+    }
+}
+
+/* Lets the oldest row, at slot, leave every column's window */
+static void ringbuf_window_remove(ringbuf_t *ringbuf, uint32_t slot) {
+    ringbuf_window_t *w;
+    double value;
+    uint32_t c;
+
+    for (c = 0; c < ringbuf->columns; c++) {
+        w = &ringbuf->window[c];
+        value = ringbuf->data[c][slot];
+        if (value < 0) {
+            if (w->errors > 0) w->errors--;
+            continue;
+        }
+
+        if (w->max_len > 0 && w->max_slots[w->max_head] == slot) {
+            if (++w->max_head == ringbuf->size) w->max_head = 0;
+            w->max_len--;
+        }
+        if (w->min_len > 0 && w->min_slots[w->min_head] == slot) {
+            if (++w->min_head == ringbuf->size) w->min_head = 0;
+            w->min_len--;
+        }
+        if (w->count > 0) w->count--;
+        if (w->count > 0) {
+            ringbuf_window_sum(w, -value);
+        } else {
+            w->sum = 0.0;
+            w->sum_error = 0.0;
+        }
+        sketch_window_remove(&w->sketch, value);
+    }
+}
+
+/* Refills the windows from the rows in the ring, when the ring is set up
+ * or resized; never from push, which it would stall for a whole lap */
+static void ringbuf_window_rebuild(ringbuf_t *ringbuf) {
+    ringbuf_window_t *w;
+    uint32_t c, i, slot;
+
+    for (c = 0; c < ringbuf->columns; c++) {
+        w = &ringbuf->window[c];
+        w->min_head = w->min_len = 0;
+        w->max_head = w->max_len = 0;
+        w->count = 0;
+        w->errors = 0;
+        w->sum = 0.0;
+        w->sum_error = 0.0;
+        sketch_window_clear(&w->sketch);
+    }
+
+    slot = (ringbuf->head + ringbuf->size - ringbuf->count) % ringbuf->size;
+    for (i = 0; i < ringbuf->count; i++) {
+        ringbuf_window_add(ringbuf, slot);
+        if (++slot == ringbuf->size) slot = 0;
+    }
+}
+
+/* Producer side, inside the seq write section */
+static void ringbuf_window_publish(ringbuf_t *ringbuf) {
+    ringbuf_window_t *w;
+    ringbuf_stats_t *s;
+    uint32_t c;
+
+    for (c = 0; c < ringbuf->columns; c++) {
+        w = &ringbuf->window[c];
+        s = &ringbuf->stats[c];
+        s->count = w->count;
+        s->errors = w->errors;
+        s->last = w->last;
+        if (w->count > 0) {
+            s->min = ringbuf->data[c][w->min_slots[w->min_head]];
+            s->max = ringbuf->data[c][w->max_slots[w->max_head]];
+            s->avg = (w->sum + w->sum_error) / w->count;
+        } else {
+            s->min = 0.0;
+            s->max = 0.0;
+            s->avg = 0.0;
+        }
+        s->p50 = sketch_window_quantile(&w->sketch, 0.50);
+        s->p95 = sketch_window_quantile(&w->sketch, 0.95);
+        s->p99 = sketch_window_quantile(&w->sketch, 0.99);
+    }
+}
+
+static void ringbuf_free_arrays(ringbuf_t *ringbuf) {
+    uint32_t c;
+
+    for (c = 0; c < ringbuf->columns; c++) {
+        free(ringbuf->data[c]);
+    }
+    free(ringbuf->timestamps);
+}
+
+ringbuf_t *ringbuf_create(uint32_t size, uint32_t columns) {
     ringbuf_t *ringbuf;
+    uint32_t c;
 
-    if (size == 0) return NULL;
+    if (size == 0 || columns == 0 || columns > RINGBUF_MAX_COLUMNS) return NULL;
 
     ringbuf = malloc(sizeof(ringbuf_t));
     if (!ringbuf) return NULL;
 
-    ringbuf->data = malloc(sizeof(double) * size);
-    if (!ringbuf->data) {
+    ringbuf->columns = columns;
+    for (c = 0; c < RINGBUF_MAX_COLUMNS; c++) {
+        ringbuf->data[c] = NULL;
+    }
+    ringbuf->timestamps = calloc(size, sizeof(uint32_t));
+    for (c = 0; c < columns; c++) {
+        ringbuf->data[c] = calloc(size, sizeof(double));
+        if (!ringbuf->data[c]) break;
+    }
+    if (c < columns || !ringbuf->timestamps) {
+        ringbuf_free_arrays(ringbuf);
         free(ringbuf);
         return NULL;
     }
-
-    ringbuf->timestamps = malloc(sizeof(uint32_t) * size);
-    if (!ringbuf->timestamps) {
-        free(ringbuf->data);
+    if (!ringbuf_window_alloc(ringbuf->window, columns, size)) {
+        ringbuf_free_arrays(ringbuf);
         free(ringbuf);
         return NULL;
     }
+    memset(ringbuf->stats, 0, sizeof(ringbuf->stats));
 
     ringbuf->size = size;
-    atomic_store(&ringbuf->head, 0);
-    atomic_store(&ringbuf->tail, 0);
-    atomic_store(&ringbuf->count, 0);
-
-    ringbuf->write_mutex = os_plot_mutex_create();
-    if (!ringbuf->write_mutex) {
-        free(ringbuf->timestamps);
-        free(ringbuf->data);
+    ringbuf->seq = 0;
+    ringbuf->head = 0;
+    ringbuf->count = 0;
+    ringbuf->pending_size = size;
+    ringbuf->tier_count = 0;
+    ringbuf->archive = NULL;
+    ringbuf->archive_blocks = 0;
+    ringbuf->archive_head = 0;
+    ringbuf->archive_used = 0;
+    ringbuf->file = NULL;
+    ringbuf->file_size = 0;
+    ringbuf->file_handle = -1;
+
+    ringbuf->resize_mutex = os_plot_mutex_create();
+    if (!ringbuf->resize_mutex) {
+        ringbuf_window_free(ringbuf->window, columns);
+        ringbuf_free_arrays(ringbuf);
+        free(ringbuf);
+        return NULL;
+    }
+
+#ifndef SNG_HAVE_BARRIER
+    ringbuf->barrier_mutex = os_plot_mutex_create();
+    if (!ringbuf->barrier_mutex) {
+        os_plot_mutex_destroy(ringbuf->resize_mutex);
+        ringbuf_window_free(ringbuf->window, columns);
+        ringbuf_free_arrays(ringbuf);
+        free(ringbuf);
+        return NULL;
+    }
+#endif
+
+    return ringbuf;
+}
+
+#ifdef OS_HAVE_MAP_FILE
+static size_t ringbuf_align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+/* A header is trusted only if it describes exactly the requested layout,
+ * its positions are in range and every archive block in use could have
+ * been written by this code */
+static int ringbuf_file_valid(const ringbuf_file_header_t *hdr, uint32_t size, uint32_t columns, const ringbuf_tier_spec_t *tiers, uint32_t tier_count, const tsblock_t *archive, uint32_t archive_blocks) {
+    uint32_t i;
+
+    if (hdr->magic != RINGBUF_FILE_MAGIC || hdr->version != RINGBUF_FILE_VERSION) return 0;
+    if (hdr->columns != columns || hdr->size != size || hdr->tier_count != tier_count) return 0;
+    if (hdr->head >= size || hdr->count > size) return 0;
+
+    for (i = 0; i < tier_count; i++) {
+        if (hdr->tier_bucket_ms[i] != tiers[i].bucket_ms || hdr->tier_size[i] != tiers[i].buckets) return 0;
+        if (hdr->tier_head[i] >= tiers[i].buckets || hdr->tier_used[i] > tiers[i].buckets) return 0;
+        if (hdr->tier_sketches[i] != (tiers[i].sketches ? 1U : 0U)) return 0;
+    }
+
+    if (hdr->archive_blocks != archive_blocks) return 0;
+    if (archive_blocks > 0 && (hdr->archive_head >= archive_blocks || hdr->archive_used > archive_blocks)) return 0;
+#ifdef TSBLOCK_SUPPORTED
+    /* blocks outside the used run are restarted before they are written */
+    for (i = 0; i < hdr->archive_used; i++) {
+        if (!tsblock_valid(&archive[(hdr->archive_head + archive_blocks - i) % archive_blocks], columns)) return 0;
+    }
+#else
+    (void)archive;
+#endif
+    return 1;
+}
+
+/* Maps path as the backing store of a new buffer. Existing contents are
+ * reused when the layout matches, otherwise the buffer starts empty. Tiers
+ * must be given finest first and cannot be added later. */
+ringbuf_t *ringbuf_create_file(const char *path, uint32_t size, uint32_t columns, const ringbuf_tier_spec_t *tiers, uint32_t tier_count, uint32_t archive_blocks) {
+    ringbuf_t *ringbuf;
+    ringbuf_file_header_t *hdr;
+    tsblock_t *archive;
+    char *base;
+    size_t offset, total;
+    uint32_t i;
+    int existed, handle;
+
+    if (!path || size == 0 || tier_count > RINGBUF_MAX_TIERS) return NULL;
+    if (columns == 0 || columns > RINGBUF_MAX_COLUMNS) return NULL;
+    if (tier_count > 0 && !tiers) return NULL;
+
+    total = ringbuf_align8(sizeof(ringbuf_file_header_t));
+    total += ringbuf_align8(sizeof(double) * size) * columns;
+    total += ringbuf_align8(sizeof(uint32_t) * size);
+    for (i = 0; i < tier_count; i++) {
+        if (tiers[i].bucket_ms == 0 || tiers[i].buckets == 0) return NULL;
+        total += sizeof(ringbuf_bucket_t) * tiers[i].buckets * columns;
+        if (tiers[i].sketches) total += ringbuf_align8(sizeof(sketch_t) * tiers[i].buckets * columns);
+    }
+#ifdef TSBLOCK_SUPPORTED
+    total += sizeof(tsblock_t) * archive_blocks;
+#else
+    archive_blocks = 0;
+#endif
+
+    ringbuf = malloc(sizeof(ringbuf_t));
+    if (!ringbuf) return NULL;
+
+    if (!ringbuf_window_alloc(ringbuf->window, columns, size)) {
+        free(ringbuf);
+        return NULL;
+    }
+
+    base = os_map_file(path, total, &existed, &handle);
+    if (!base) {
+        ringbuf_window_free(ringbuf->window, columns);
         free(ringbuf);
         return NULL;
     }
 
     ringbuf->resize_mutex = os_plot_mutex_create();
     if (!ringbuf->resize_mutex) {
-        os_plot_mutex_destroy(ringbuf->write_mutex);
-        free(ringbuf->timestamps);
-        free(ringbuf->data);
+        os_unmap_file(base, total, handle);
+        ringbuf_window_free(ringbuf->window, columns);
+        free(ringbuf);
+        return NULL;
+    }
+
+#ifndef SNG_HAVE_BARRIER
+    ringbuf->barrier_mutex = os_plot_mutex_create();
+    if (!ringbuf->barrier_mutex) {
+        os_plot_mutex_destroy(ringbuf->resize_mutex);
+        os_unmap_file(base, total, handle);
+        ringbuf_window_free(ringbuf->window, columns);
         free(ringbuf);
         return NULL;
     }
+#endif
 
-    memset(ringbuf->data, 0, sizeof(double) * size);
-    memset(ringbuf->timestamps, 0, sizeof(uint32_t) * size);
+    hdr = (ringbuf_file_header_t*)base;
+    archive = (tsblock_t*)(base + total - sizeof(tsblock_t) * archive_blocks);
+    if (!existed || !ringbuf_file_valid(hdr, size, columns, tiers, tier_count, archive, archive_blocks)) {
+        /* fresh pages are already zero; stale samples past count are never read */
+        memset(hdr, 0, sizeof(*hdr));
+        hdr->magic = RINGBUF_FILE_MAGIC;
+        hdr->version = RINGBUF_FILE_VERSION;
+        hdr->columns = columns;
+        hdr->size = size;
+        hdr->tier_count = tier_count;
+        for (i = 0; i < tier_count; i++) {
+            hdr->tier_bucket_ms[i] = tiers[i].bucket_ms;
+            hdr->tier_size[i] = tiers[i].buckets;
+            hdr->tier_sketches[i] = tiers[i].sketches ? 1 : 0;
+        }
+        hdr->archive_blocks = archive_blocks;
+    }
+
+    offset = ringbuf_align8(sizeof(ringbuf_file_header_t));
+    ringbuf->columns = columns;
+    for (i = 0; i < RINGBUF_MAX_COLUMNS; i++) {
+        ringbuf->data[i] = NULL;
+    }
+    for (i = 0; i < columns; i++) {
+        ringbuf->data[i] = (double*)(base + offset);
+        offset += ringbuf_align8(sizeof(double) * size);
+    }
+    ringbuf->timestamps = (uint32_t*)(base + offset);
+    offset += ringbuf_align8(sizeof(uint32_t) * size);
+
+    ringbuf->size = size;
+    ringbuf->seq = 0;
+    ringbuf->head = hdr->head;
+    ringbuf->count = hdr->count;
+    ringbuf->pending_size = size;
+    ringbuf->tier_count = tier_count;
+    for (i = 0; i < tier_count; i++) {
+        ringbuf->tiers[i].bucket_ms = tiers[i].bucket_ms;
+        ringbuf->tiers[i].size = tiers[i].buckets;
+        ringbuf->tiers[i].head = hdr->tier_head[i];
+        ringbuf->tiers[i].count = hdr->tier_used[i];
+        ringbuf->tiers[i].buckets = (ringbuf_bucket_t*)(base + offset);
+        offset += sizeof(ringbuf_bucket_t) * tiers[i].buckets * columns;
+        ringbuf->tiers[i].sketches = NULL;
+        if (tiers[i].sketches) {
+            ringbuf->tiers[i].sketches = (sketch_t*)(base + offset);
+            offset += ringbuf_align8(sizeof(sketch_t) * tiers[i].buckets * columns);
+        }
+    }
+    ringbuf->archive = archive_blocks ? (tsblock_t*)(base + offset) : NULL;
+    ringbuf->archive_blocks = archive_blocks;
+    ringbuf->archive_head = hdr->archive_head;
+    ringbuf->archive_used = hdr->archive_used;
+    ringbuf->file = hdr;
+    ringbuf->file_size = total;
+    ringbuf->file_handle = handle;
+
+    /* the windows are not stored, so they are rebuilt from the rows */
+    memset(ringbuf->stats, 0, sizeof(ringbuf->stats));
+    ringbuf_window_rebuild(ringbuf);
+    ringbuf_window_publish(ringbuf);
 
     return ringbuf;
 }
+#else
+ringbuf_t *ringbuf_create_file(const char *path, uint32_t size, uint32_t columns, const ringbuf_tier_spec_t *tiers, uint32_t tier_count, uint32_t archive_blocks) {
+    (void)path;
+    (void)size;
+    (void)columns;
+    (void)tiers;
+    (void)tier_count;
+    (void)archive_blocks;
+    return NULL;
+}
+#endif
+
+/* Producer side: records positions in the mapped header */
+static void ringbuf_file_mirror(ringbuf_t *ringbuf) {
+    ringbuf_file_header_t *hdr;
+    uint32_t i;
+
+    hdr = ringbuf->file;
+    hdr->head = ringbuf->head;
+    hdr->count = ringbuf->count;
+    for (i = 0; i < ringbuf->tier_count; i++) {
+        hdr->tier_head[i] = ringbuf->tiers[i].head;
+        hdr->tier_used[i] = ringbuf->tiers[i].count;
+    }
+    hdr->archive_head = ringbuf->archive_head;
+    hdr->archive_used = ringbuf->archive_used;
+}
 
 void ringbuf_destroy(ringbuf_t *ringbuf) {
+    uint32_t i;
+
     if (!ringbuf) return;
 
-    os_plot_mutex_destroy(ringbuf->write_mutex);
+#ifndef SNG_HAVE_BARRIER
+    os_plot_mutex_destroy(ringbuf->barrier_mutex);
+#endif
     os_plot_mutex_destroy(ringbuf->resize_mutex);
-    free(ringbuf->timestamps);
-    free(ringbuf->data);
+    ringbuf_window_free(ringbuf->window, ringbuf->columns);
+
+#ifdef OS_HAVE_MAP_FILE
+    if (ringbuf->file) {
+        os_unmap_file(ringbuf->file, ringbuf->file_size, ringbuf->file_handle);
+        free(ringbuf);
+        return;
+    }
+#endif
+
+    for (i = 0; i < ringbuf->tier_count; i++) {
+        free(ringbuf->tiers[i].buckets);
+        free(ringbuf->tiers[i].sketches);
+    }
+    free(ringbuf->archive);
+    ringbuf_free_arrays(ringbuf);
     free(ringbuf);
 }
 
-int ringbuf_resize(ringbuf_t *ringbuf, uint32_t new_size) {
-    double *new_data;
-    uint32_t *new_timestamps;
-    uint32_t current_count;
-    uint32_t current_head;
-    uint32_t current_tail;
-    uint32_t copy_count;
+/* Adds a consolidation tier of buckets of bucket_ms each, with a quantile
+ * sketch per bucket if asked. Must be called before the producer starts;
+ * tiers are kept finest first. */
+int ringbuf_add_tier(ringbuf_t *ringbuf, uint32_t bucket_ms, uint32_t buckets, int sketches) {
+    ringbuf_tier_t *tier;
+    uint32_t i;
+
+    if (!ringbuf || bucket_ms == 0 || buckets == 0) return 0;
+    if (ringbuf->file || ringbuf->tier_count >= RINGBUF_MAX_TIERS) return 0;
+
+    i = ringbuf->tier_count;
+    while (i > 0 && ringbuf->tiers[i - 1].bucket_ms > bucket_ms) {
+        ringbuf->tiers[i] = ringbuf->tiers[i - 1];
+        i--;
+    }
+
+    tier = &ringbuf->tiers[i];
+    tier->buckets = malloc(sizeof(ringbuf_bucket_t) * buckets * ringbuf->columns);
+    tier->sketches = NULL;
+    if (tier->buckets && sketches) {
+        tier->sketches = malloc(sizeof(sketch_t) * buckets * ringbuf->columns);
+        if (!tier->sketches) {
+            free(tier->buckets);
+            tier->buckets = NULL;
+        }
+    }
+    if (!tier->buckets) {
+        /* undo the shift */
+        for (; i < ringbuf->tier_count; i++) {
+            ringbuf->tiers[i] = ringbuf->tiers[i + 1];
+        }
+        return 0;
+    }
+    tier->bucket_ms = bucket_ms;
+    tier->size = buckets;
+    tier->head = 0;
+    tier->count = 0;
+    ringbuf->tier_count++;
+    return 1;
+}
+
+/* Finest tier covering span_ms, else the longest one; -1 without tiers */
+int ringbuf_tier_for_span(ringbuf_t *ringbuf, uint32_t span_ms) {
     uint32_t i;
-    uint32_t src_index;
+    double covered, longest;
+    int best;
+
+    if (!ringbuf || ringbuf->tier_count == 0) return -1;
+
+    best = 0;
+    longest = 0.0;
+    for (i = 0; i < ringbuf->tier_count; i++) {
+        covered = (double)ringbuf->tiers[i].bucket_ms * ringbuf->tiers[i].size;
+        if (covered >= (double)span_ms) return (int)i;
+        if (covered > longest) {
+            longest = covered;
+            best = (int)i;
+        }
+    }
+    return best;
+}
+
+/* Keeps samples that fall out of the raw ring in this many compressed
+ * blocks; like tiers, must be set up before the producer starts */
+int ringbuf_add_archive(ringbuf_t *ringbuf, uint32_t blocks) {
+#ifdef TSBLOCK_SUPPORTED
+    if (!ringbuf || blocks == 0 || ringbuf->file || ringbuf->archive) return 0;
 
+    ringbuf->archive = calloc(blocks, sizeof(tsblock_t));
+    if (!ringbuf->archive) return 0;
+    ringbuf->archive_blocks = blocks;
+    ringbuf->archive_head = 0;
+    ringbuf->archive_used = 0;
+    return 1;
+#else
+    (void)ringbuf;
+    (void)blocks;
+    return 0;
+#endif
+}
+
+/* Queues a new capacity; the producer swaps the arrays on its next push so
+ * the push path itself never needs a lock */
+int ringbuf_resize(ringbuf_t *ringbuf, uint32_t new_size) {
     if (!ringbuf || new_size == 0) return 0;
+    if (ringbuf->file) return new_size == ringbuf->size;
 
     os_plot_mutex_lock(ringbuf->resize_mutex);
-    os_plot_mutex_lock(ringbuf->write_mutex);
+    ringbuf->pending_size = new_size;
+    os_plot_mutex_unlock(ringbuf->resize_mutex);
+    return 1;
+}
 
+/* Producer side. Readers hold resize_mutex for the whole copy, so taking it
+ * here means nobody is looking at the old arrays when they are freed. */
+static void ringbuf_apply_resize(ringbuf_t *ringbuf) {
+    ringbuf_window_t new_window[RINGBUF_MAX_COLUMNS];
+    double *new_data[RINGBUF_MAX_COLUMNS];
+    uint32_t *new_timestamps;
+    uint32_t new_size;
+    uint32_t copy_count;
+    uint32_t src;
+    uint32_t c, i;
+    int failed;
+
+    os_plot_mutex_lock(ringbuf->resize_mutex);
+
+    new_size = ringbuf->pending_size;
     if (new_size == ringbuf->size) {
-        os_plot_mutex_unlock(ringbuf->write_mutex);
         os_plot_mutex_unlock(ringbuf->resize_mutex);
-        return 1;
+        return;
     }
 
-    new_data = malloc(sizeof(double) * new_size);
-    if (!new_data) {
-        os_plot_mutex_unlock(ringbuf->write_mutex);
-        os_plot_mutex_unlock(ringbuf->resize_mutex);
-        return 0;
+    failed = !ringbuf_window_alloc(new_window, ringbuf->columns, new_size);
+    new_timestamps = calloc(new_size, sizeof(uint32_t));
+    if (!new_timestamps) failed = 1;
+    for (c = 0; c < ringbuf->columns; c++) {
+        new_data[c] = calloc(new_size, sizeof(double));
+        if (!new_data[c]) failed = 1;
     }
-
-    new_timestamps = malloc(sizeof(uint32_t) * new_size);
-    if (!new_timestamps) {
-        free(new_data);
-        os_plot_mutex_unlock(ringbuf->write_mutex);
+    if (failed) {
+        /* keep the old buffer rather than retrying every push */
+        for (c = 0; c < ringbuf->columns; c++) {
+            free(new_data[c]);
+        }
+        free(new_timestamps);
+        ringbuf_window_free(new_window, ringbuf->columns);
+        ringbuf->pending_size = ringbuf->size;
         os_plot_mutex_unlock(ringbuf->resize_mutex);
-        return 0;
+        return;
     }
 
-    current_count = atomic_load(&ringbuf->count);
-    current_head = atomic_load(&ringbuf->head);
-    current_tail = atomic_load(&ringbuf->tail);
-    copy_count = (current_count < new_size) ? current_count : new_size;
-
-    if (copy_count > 0) {
-        for (i = 0; i < copy_count; i++) {
-            if (new_size < current_count) {
-                src_index = (current_head - copy_count + i + ringbuf->size) % ringbuf->size;
-            } else {
-                src_index = (current_tail + i) % ringbuf->size;
-            }
-            new_data[i] = ringbuf->data[src_index];
-            new_timestamps[i] = ringbuf->timestamps[src_index];
+    /* keep the newest rows */
+    copy_count = (ringbuf->count < new_size) ? ringbuf->count : new_size;
+    src = (ringbuf->head + ringbuf->size - copy_count) % ringbuf->size;
+    for (i = 0; i < copy_count; i++) {
+        for (c = 0; c < ringbuf->columns; c++) {
+            new_data[c][i] = ringbuf->data[c][src];
         }
+        new_timestamps[i] = ringbuf->timestamps[src];
+        if (++src == ringbuf->size) src = 0;
     }
 
-    free(ringbuf->data);
-    free(ringbuf->timestamps);
-    ringbuf->data = new_data;
+    ringbuf_free_arrays(ringbuf);
+    ringbuf_window_free(ringbuf->window, ringbuf->columns);
+    for (c = 0; c < ringbuf->columns; c++) {
+        ringbuf->data[c] = new_data[c];
+        new_window[c].last = ringbuf->window[c].last;
+        ringbuf->window[c] = new_window[c];
+    }
     ringbuf->timestamps = new_timestamps;
     ringbuf->size = new_size;
-    atomic_store(&ringbuf->head, copy_count % new_size);
-    atomic_store(&ringbuf->tail, 0);
-    atomic_store(&ringbuf->count, copy_count);
-
-    memset(&ringbuf->data[copy_count], 0, sizeof(double) * (new_size - copy_count));
-    memset(&ringbuf->timestamps[copy_count], 0, sizeof(uint32_t) * (new_size - copy_count));
+    ringbuf->head = copy_count % new_size;
+    ringbuf->count = copy_count;
+    ringbuf_window_rebuild(ringbuf);
 
-    os_plot_mutex_unlock(ringbuf->write_mutex);
     os_plot_mutex_unlock(ringbuf->resize_mutex);
-    return 1;
 }
 
-int ringbuf_push(ringbuf_t *ringbuf, double value, uint32_t timestamp_ms) {
-    uint32_t current_head;
-    uint32_t current_count;
-    uint32_t new_head;
-    uint32_t current_tail;
+/* Folds one row into the tier's open bucket row, starting a new row when
+ * the sample falls in the next time slot */
+static void ringbuf_tier_push(ringbuf_tier_t *tier, uint32_t columns, const double *values, uint32_t timestamp_ms) {
+    ringbuf_bucket_t *bucket;
+    sketch_t *sketch;
+    uint32_t start_ms;
+    uint32_t head;
+    uint32_t c;
 
-    if (!ringbuf) return 0;
+    start_ms = timestamp_ms - timestamp_ms % tier->bucket_ms;
+    head = tier->head;
+    bucket = &tier->buckets[head * columns];
 
-    os_plot_mutex_lock(ringbuf->write_mutex);
+    if (tier->count == 0 || bucket->start_ms != start_ms) {
+        if (tier->count > 0 && ++head == tier->size) head = 0;
+        bucket = &tier->buckets[head * columns];
+        for (c = 0; c < columns; c++) {
+            bucket[c].start_ms = start_ms;
+            bucket[c].count = 0;
+            bucket[c].errors = 0;
+            bucket[c].min = 0.0;
+            bucket[c].max = 0.0;
+            bucket[c].sum = 0.0;
+            if (tier->sketches) sketch_clear(&tier->sketches[head * columns + c]);
+        }
+        tier->head = head;
+        if (tier->count < tier->size) tier->count++;
+    }
 
-    current_head = atomic_load(&ringbuf->head);
-    current_count = atomic_load(&ringbuf->count);
+    sketch = tier->sketches ? &tier->sketches[head * columns] : NULL;
+    for (c = 0; c < columns; c++, bucket++) {
+        if (values[c] < 0) {
+            bucket->errors++;
+            continue;
+        }
 
-    ringbuf->data[current_head] = value;
-    ringbuf->timestamps[current_head] = timestamp_ms;
-    new_head = (current_head + 1) % ringbuf->size;
-    atomic_store(&ringbuf->head, new_head);
+        if (bucket->count == 0 || values[c] < bucket->min) bucket->min = values[c];
+        if (bucket->count == 0 || values[c] > bucket->max) bucket->max = values[c];
+        bucket->sum += values[c];
+        bucket->count++;
+        if (sketch) sketch_add(&sketch[c], values[c]);
+    }
+}
 
-    if (current_count < ringbuf->size) {
-        atomic_store(&ringbuf->count, current_count + 1);
-    } else {
-        current_tail = atomic_load(&ringbuf->tail);
-        atomic_store(&ringbuf->tail, (current_tail + 1) % ringbuf->size);
+#ifdef TSBLOCK_SUPPORTED
+/* Producer side: archives the row at slot, appending to the open block
+ * and recycling the oldest block once all of them are in use */
+static void ringbuf_archive_push(ringbuf_t *ringbuf, uint32_t slot) {
+    double values[RINGBUF_MAX_COLUMNS];
+    uint32_t timestamp_ms;
+    uint32_t head;
+    uint32_t c;
+
+    for (c = 0; c < ringbuf->columns; c++) {
+        values[c] = ringbuf->data[c][slot];
     }
+    timestamp_ms = ringbuf->timestamps[slot];
 
-    os_plot_mutex_unlock(ringbuf->write_mutex);
-    return 1;
+    head = ringbuf->archive_head;
+    if (ringbuf->archive_used > 0 && tsblock_append(&ringbuf->archive[head], values, timestamp_ms)) {
+        return;
+    }
+
+    if (ringbuf->archive_used > 0 && ++head == ringbuf->archive_blocks) head = 0;
+    tsblock_start(&ringbuf->archive[head], values, ringbuf->columns, timestamp_ms);
+    ringbuf->archive_head = head;
+    if (ringbuf->archive_used < ringbuf->archive_blocks) ringbuf->archive_used++;
 }
+#endif
 
-int ringbuf_pop(ringbuf_t *ringbuf, double *value, uint32_t *timestamp_ms) {
-    uint32_t current_count;
-    uint32_t current_tail;
-    uint32_t new_tail;
+/* Publishes one row, a value for every column, with a single seq bump */
+int ringbuf_push(ringbuf_t *ringbuf, const double *values, uint32_t timestamp_ms) {
+    uint32_t head;
+    uint32_t c, i;
 
-    if (!ringbuf || !value) return 0;
+    if (!ringbuf || !values) return 0;
 
-    os_plot_mutex_lock(ringbuf->write_mutex);
+    if (ringbuf->pending_size != ringbuf->size) {
+        ringbuf_apply_resize(ringbuf);
+    }
 
-    current_count = atomic_load(&ringbuf->count);
-    if (current_count == 0) {
-        os_plot_mutex_unlock(ringbuf->write_mutex);
-        return 0;
+    ringbuf->seq++;
+    ringbuf_barrier(ringbuf);
+
+    head = ringbuf->head;
+    if (ringbuf->count == ringbuf->size) {
+#ifdef TSBLOCK_SUPPORTED
+        if (ringbuf->archive) ringbuf_archive_push(ringbuf, head);
+#endif
+        ringbuf_window_remove(ringbuf, head);
+    }
+    for (c = 0; c < ringbuf->columns; c++) {
+        ringbuf->data[c][head] = values[c];
+    }
+    ringbuf->timestamps[head] = timestamp_ms;
+    ringbuf_window_add(ringbuf, head);
+    if (++head == ringbuf->size) head = 0;
+    ringbuf->head = head;
+    if (ringbuf->count < ringbuf->size) {
+        ringbuf->count++;
     }
+    ringbuf_window_publish(ringbuf);
 
-    current_tail = atomic_load(&ringbuf->tail);
-    *value = ringbuf->data[current_tail];
-    if (timestamp_ms) *timestamp_ms = ringbuf->timestamps[current_tail];
-    new_tail = (current_tail + 1) % ringbuf->size;
-    atomic_store(&ringbuf->tail, new_tail);
-    atomic_store(&ringbuf->count, current_count - 1);
+    for (i = 0; i < ringbuf->tier_count; i++) {
+        ringbuf_tier_push(&ringbuf->tiers[i], ringbuf->columns, values, timestamp_ms);
+    }
+    if (ringbuf->file) ringbuf_file_mirror(ringbuf);
 
-    os_plot_mutex_unlock(ringbuf->write_mutex);
+    ringbuf_barrier(ringbuf);
+    ringbuf->seq++;
     return 1;
 }
 
+/* Removes the oldest row; like push, only the producer may call it */
+int ringbuf_pop(ringbuf_t *ringbuf, double *values, uint32_t *timestamp_ms) {
+    uint32_t tail;
+    uint32_t c;
+
+    if (!ringbuf || !values) return 0;
+
+    if (ringbuf->count == 0) return 0;
+
+    ringbuf->seq++;
+    ringbuf_barrier(ringbuf);
+
+    tail = (ringbuf->head + ringbuf->size - ringbuf->count) % ringbuf->size;
+    for (c = 0; c < ringbuf->columns; c++) {
+        values[c] = ringbuf->data[c][tail];
+    }
+    if (timestamp_ms) *timestamp_ms = ringbuf->timestamps[tail];
+    ringbuf_window_remove(ringbuf, tail);
+    ringbuf->count--;
+    ringbuf_window_publish(ringbuf);
+    if (ringbuf->file) ringbuf_file_mirror(ringbuf);
+
+    ringbuf_barrier(ringbuf);
+    ringbuf->seq++;
+    return 1;
+}
+
+/* Copies the published statistics of one column; O(1), never blocks */
+int ringbuf_get_stats(ringbuf_t *ringbuf, uint32_t column, ringbuf_stats_t *stats) {
+    uint32_t seq;
+    uint32_t attempts;
+
+    if (!ringbuf || !stats || column >= ringbuf->columns) return 0;
+
+    for (attempts = 0; attempts < RINGBUF_READ_ATTEMPTS; attempts++) {
+        seq = ringbuf->seq;
+        ringbuf_barrier(ringbuf);
+        if (seq & 1) continue;
+
+        *stats = ringbuf->stats[column];
+
+        ringbuf_barrier(ringbuf);
+        if (ringbuf->seq == seq) return 1;
+    }
+    return 0;
+}
+
 uint32_t ringbuf_count(ringbuf_t *ringbuf) {
     if (!ringbuf) return 0;
 
-    return atomic_load(&ringbuf->count);
+    return ringbuf->count;
 }
 
 int ringbuf_is_full(ringbuf_t *ringbuf) {
     if (!ringbuf) return 0;
 
-    return (atomic_load(&ringbuf->count) == ringbuf->size);
+    return (ringbuf->count == ringbuf->size);
 }
 
 int ringbuf_is_empty(ringbuf_t *ringbuf) {
     if (!ringbuf) return 1;
 
-    return (atomic_load(&ringbuf->count) == 0);
+    return (ringbuf->count == 0);
 }
 
-int ringbuf_read_snapshot(ringbuf_t *ringbuf, double *values, uint32_t *timestamps, uint32_t buffer_size, uint32_t *count_out, uint32_t *head_out, uint32_t *tail_out) {
-    uint32_t count, head, tail;
+/* Copies the oldest min(count, buffer_size) rows, each column into its own
+ * array, as at most two memcpy spans per column and retries only when a
+ * push overlapped the copy */
+int ringbuf_read_snapshot(ringbuf_t *ringbuf, double *const *values, uint32_t *timestamps, uint32_t buffer_size, uint32_t *count_out, uint32_t *head_out, uint32_t *tail_out) {
+    uint32_t seq;
     uint32_t attempts;
-    const uint32_t max_attempts = 10;
+    uint32_t c;
+    uint32_t size, count, head, tail;
     uint32_t copy_count;
-    uint32_t i;
-    uint32_t idx;
-    uint32_t verify_count;
-    uint32_t verify_head;
-    uint32_t verify_tail;
+    uint32_t first;
 
     if (!ringbuf || !values || !count_out || !head_out || !tail_out) return 0;
 
-    attempts = 0;
+    os_plot_mutex_lock(ringbuf->resize_mutex);
 
-    do {
-        count = atomic_load(&ringbuf->count);
-        head = atomic_load(&ringbuf->head);
-        tail = atomic_load(&ringbuf->tail);
+    for (attempts = 0; attempts < RINGBUF_READ_ATTEMPTS; attempts++) {
+        seq = ringbuf->seq;
+        ringbuf_barrier(ringbuf);
+        if (seq & 1) continue;
 
-        if (count == 0) {
-            *count_out = 0;
-            return 1;
-        }
+        size = ringbuf->size;
+        count = ringbuf->count;
+        head = ringbuf->head;
+        tail = (head + size - count) % size;
 
         copy_count = (count < buffer_size) ? count : buffer_size;
+        first = size - tail;
+        if (first > copy_count) first = copy_count;
 
-        for (i = 0; i < copy_count; i++) {
-            idx = (tail + i) % ringbuf->size;
-            values[i] = ringbuf->data[idx];
-            if (timestamps) timestamps[i] = ringbuf->timestamps[idx];
+        for (c = 0; c < ringbuf->columns; c++) {
+            memcpy(values[c], &ringbuf->data[c][tail], sizeof(double) * first);
+            memcpy(&values[c][first], ringbuf->data[c], sizeof(double) * (copy_count - first));
+        }
+        if (timestamps) {
+            memcpy(timestamps, &ringbuf->timestamps[tail], sizeof(uint32_t) * first);
+            memcpy(&timestamps[first], ringbuf->timestamps, sizeof(uint32_t) * (copy_count - first));
         }
 
-        verify_count = atomic_load(&ringbuf->count);
-        verify_head = atomic_load(&ringbuf->head);
-        verify_tail = atomic_load(&ringbuf->tail);
-
-        if (count == verify_count && head == verify_head && tail == verify_tail) {
+        ringbuf_barrier(ringbuf);
+        if (ringbuf->seq == seq) {
+            os_plot_mutex_unlock(ringbuf->resize_mutex);
             *count_out = copy_count;
             *head_out = head;
             *tail_out = tail;
             return 1;
         }
+    }
 
-        attempts++;
-    } while (attempts < max_attempts);
+    os_plot_mutex_unlock(ringbuf->resize_mutex);
+    return 0;
+}
+
+/* Opens a view; on success the caller must close it with ringbuf_view_end.
+ * Holding resize_mutex keeps the arrays from being swapped meanwhile. */
+int ringbuf_view_begin(ringbuf_t *ringbuf, ringbuf_view_t *view) {
+    uint32_t seq;
+    uint32_t attempts;
+    uint32_t size, count, head, tail;
+    uint32_t c;
+
+    if (!ringbuf || !view) return 0;
+
+    os_plot_mutex_lock(ringbuf->resize_mutex);
 
+    for (attempts = 0; attempts < RINGBUF_READ_ATTEMPTS; attempts++) {
+        seq = ringbuf->seq;
+        ringbuf_barrier(ringbuf);
+        if (seq & 1) continue;
+
+        size = ringbuf->size;
+        count = ringbuf->count;
+        head = ringbuf->head;
+
+        ringbuf_barrier(ringbuf);
+        if (ringbuf->seq != seq) continue;
+
+        /* the next push lands on the oldest slot of a full buffer */
+        if (count == size && count > 0) count--;
+        tail = (head + size - count) % size;
+
+        view->seq = seq;
+        view->columns = ringbuf->columns;
+        view->count = count;
+        view->len[0] = size - tail;
+        if (view->len[0] > count) view->len[0] = count;
+        view->len[1] = count - view->len[0];
+        for (c = 0; c < ringbuf->columns; c++) {
+            view->values[c][0] = &ringbuf->data[c][tail];
+            view->values[c][1] = ringbuf->data[c];
+        }
+        view->timestamps[0] = &ringbuf->timestamps[tail];
+        view->timestamps[1] = ringbuf->timestamps;
+        return 1;
+    }
+
+    os_plot_mutex_unlock(ringbuf->resize_mutex);
     return 0;
 }
+
+/* Closes a view; returns 0 if the producer may have overwritten part of it */
+int ringbuf_view_end(ringbuf_t *ringbuf, ringbuf_view_t *view) {
+    int intact;
+
+    if (!ringbuf || !view) return 0;
+
+    ringbuf_barrier(ringbuf);
+    intact = (uint32_t)(ringbuf->seq - view->seq) <= 2;
+    os_plot_mutex_unlock(ringbuf->resize_mutex);
+    return intact;
+}
+
+/* Index of the first row in the view no older than since_ms, or view->count
+ * if there is none; rows are in time order, so this is a binary search */
+uint32_t ringbuf_view_seek(const ringbuf_view_t *view, uint32_t since_ms) {
+    uint32_t lo, hi, mid;
+
+    lo = 0;
+    hi = view->count;
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if ((int32_t)(ringbuf_view_timestamp(view, mid) - since_ms) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/* Opens a view over one tier. The open bucket is included and changes with
+ * every push; like the raw view, the oldest bucket of a full tier is left
+ * out so a single push never invalidates the rest. */
+int ringbuf_tier_view_begin(ringbuf_t *ringbuf, uint32_t tier, ringbuf_tier_view_t *view) {
+    ringbuf_tier_t *t;
+    uint32_t seq;
+    uint32_t attempts;
+    uint32_t count, head, tail;
+
+    if (!ringbuf || !view || tier >= ringbuf->tier_count) return 0;
+    t = &ringbuf->tiers[tier];
+
+    os_plot_mutex_lock(ringbuf->resize_mutex);
+
+    for (attempts = 0; attempts < RINGBUF_READ_ATTEMPTS; attempts++) {
+        seq = ringbuf->seq;
+        ringbuf_barrier(ringbuf);
+        if (seq & 1) continue;
+
+        count = t->count;
+        head = t->head;
+
+        ringbuf_barrier(ringbuf);
+        if (ringbuf->seq != seq) continue;
+
+        if (count == t->size && count > 1) count--;
+        /* head is the newest bucket, so the oldest is count - 1 behind it */
+        tail = (count > 0) ? (head + t->size - (count - 1)) % t->size : 0;
+
+        view->seq = seq;
+        view->columns = ringbuf->columns;
+        view->count = count;
+        view->bucket_ms = t->bucket_ms;
+        view->len[0] = t->size - tail;
+        if (view->len[0] > count) view->len[0] = count;
+        view->len[1] = count - view->len[0];
+        view->buckets[0] = &t->buckets[tail * ringbuf->columns];
+        view->buckets[1] = t->buckets;
+        return 1;
+    }
+
+    os_plot_mutex_unlock(ringbuf->resize_mutex);
+    return 0;
+}
+
+int ringbuf_tier_view_end(ringbuf_t *ringbuf, ringbuf_tier_view_t *view) {
+    int intact;
+
+    if (!ringbuf || !view) return 0;
+
+    ringbuf_barrier(ringbuf);
+    intact = (uint32_t)(ringbuf->seq - view->seq) <= 2;
+    os_plot_mutex_unlock(ringbuf->resize_mutex);
+    return intact;
+}
+
+/* Estimates quantiles q[0..n-1] of one column over the tier's buckets in
+ * the last span_ms by merging their sketches; bounded by the bucket count,
+ * whatever the number of samples behind them. 0 if the tier keeps none. */
+int ringbuf_tier_quantiles(ringbuf_t *ringbuf, uint32_t tier, uint32_t column, uint32_t now_ms, uint32_t span_ms, const double *q, double *out, uint32_t n) {
+    ringbuf_tier_view_t view;
+    const ringbuf_bucket_t *bucket;
+    const sketch_t *sketches;
+    sketch_t merged;
+    uint32_t i;
+
+    if (!ringbuf || !q || !out || column >= ringbuf->columns) return 0;
+    if (tier >= ringbuf->tier_count || !ringbuf->tiers[tier].sketches) return 0;
+    if (!ringbuf_tier_view_begin(ringbuf, tier, &view)) return 0;
+
+    /* the sketches line up with the buckets the view points into */
+    sketches = ringbuf->tiers[tier].sketches;
+    sketch_clear(&merged);
+    for (i = 0; i < view.count; i++) {
+        bucket = ringbuf_tier_view_bucket(&view, column, i);
+        if (now_ms - bucket->start_ms > span_ms + view.bucket_ms) continue;
+        sketch_merge(&merged, &sketches[bucket - ringbuf->tiers[tier].buckets]);
+    }
+
+    if (!ringbuf_tier_view_end(ringbuf, &view)) return 0;
+
+    for (i = 0; i < n; i++) {
+        out[i] = sketch_quantile(&merged, q[i]);
+    }
+    return merged.count > 0;
+}
+
+/* Whether archived samples go back at least span_ms from now_ms */
+int ringbuf_archive_reaches(ringbuf_t *ringbuf, uint32_t now_ms, uint32_t span_ms) {
+    uint32_t used, head, oldest;
+
+    if (!ringbuf || !ringbuf->archive) return 0;
+
+    used = ringbuf->archive_used;
+    head = ringbuf->archive_head;
+    if (used == 0) return 0;
+
+    oldest = (head + ringbuf->archive_blocks - (used - 1)) % ringbuf->archive_blocks;
+    return now_ms - ringbuf->archive[oldest].first_ts >= span_ms;
+}
+
+/* Accumulates time-ordered rows into pixel columns, one ringbuf_m4_t per
+ * series each */
+typedef struct {
+    ringbuf_m4_t *const *out;
+    uint32_t *timestamps;
+    uint32_t columns;
+    uint32_t max;
+    uint32_t n;
+    uint32_t now_ms;
+    uint32_t span_ms;
+    double ms_per_px;
+    int32_t column;
+    ringbuf_m4_t m4[RINGBUF_MAX_COLUMNS];
+    uint32_t timestamp_ms;
+    int open;
+} ringbuf_columns_t;
+
+static void ringbuf_columns_init(ringbuf_columns_t *c, ringbuf_m4_t *const *out, uint32_t *timestamps, uint32_t columns, uint32_t max, uint32_t now_ms, uint32_t span_ms, double ms_per_px) {
+    c->out = out;
+    c->timestamps = timestamps;
+    c->columns = columns;
+    c->max = max;
+    c->n = 0;
+    c->now_ms = now_ms;
+    c->span_ms = span_ms;
+    c->ms_per_px = (ms_per_px < 1.0) ? 1.0 : ms_per_px;
+    c->column = 0;
+    c->timestamp_ms = 0;
+    c->open = 0;
+}
+
+static void ringbuf_columns_flush(ringbuf_columns_t *c) {
+    uint32_t i;
+
+    if (c->open && c->n < c->max) {
+        for (i = 0; i < c->columns; i++) {
+            c->out[i][c->n] = c->m4[i];
+        }
+        c->timestamps[c->n] = c->timestamp_ms;
+        c->n++;
+    }
+    c->open = 0;
+}
+
+/* Pixel column of a timestamp, -1 outside the span */
+static int32_t ringbuf_columns_of(const ringbuf_columns_t *c, uint32_t timestamp_ms) {
+    uint32_t age;
+
+    age = c->now_ms - timestamp_ms;
+    if ((int32_t)age < 0 || age > c->span_ms) return -1;
+    return (int32_t)(age / c->ms_per_px);
+}
+
+/* Makes column the one being filled, stamped with its newest row */
+static void ringbuf_columns_open(ringbuf_columns_t *c, int32_t column, uint32_t timestamp_ms) {
+    if (c->open && column != c->column) ringbuf_columns_flush(c);
+    if (!c->open) {
+        memset(c->m4, 0, sizeof(c->m4));
+        c->column = column;
+        c->open = 1;
+    }
+    c->timestamp_ms = timestamp_ms;
+}
+
+/* The kernel: folds a contiguous run of one series into its column. A
+ * plain loop over doubles, left for the compiler to unroll. */
+static void ringbuf_m4_run(ringbuf_m4_t *m4, const double *values, uint32_t n) {
+    double lo, hi, value;
+    uint32_t i, errors, first;
+
+    for (first = 0; first < n && values[first] < 0.0; first++)
+        ;
+    errors = first;
+    if (first == n) {
+        m4->errors += errors;
+        return;
+    }
+
+    lo = hi = values[first];
+    for (i = first + 1; i < n; i++) {
+        value = values[i];
+        if (value < 0.0) {
+            errors++;
+            continue;
+        }
+        lo = (value < lo) ? value : lo;
+        hi = (value > hi) ? value : hi;
+    }
+
+    if (m4->count == 0) {
+        m4->first = values[first];
+        m4->min = lo;
+        m4->max = hi;
+    } else {
+        if (lo < m4->min) m4->min = lo;
+        if (hi > m4->max) m4->max = hi;
+    }
+    for (i = n; i-- > first; ) {
+        if (values[i] >= 0.0) break;
+    }
+    m4->last = values[i];
+    m4->count += n - errors;
+    m4->errors += errors;
+}
+
+/* Splits n time-ordered rows into runs that share a pixel column, so the
+ * values are only touched once, by the kernel */
+static void ringbuf_columns_add_rows(ringbuf_columns_t *c, const double *const *values, const uint32_t *timestamps, uint32_t n) {
+    uint32_t i, j, k;
+    int32_t column;
+
+    for (i = 0; i < n; i = j) {
+        column = ringbuf_columns_of(c, timestamps[i]);
+        for (j = i + 1; j < n && ringbuf_columns_of(c, timestamps[j]) == column; j++)
+            ;
+        if (column < 0) continue;
+
+        ringbuf_columns_open(c, column, timestamps[j - 1]);
+        for (k = 0; k < c->columns; k++) {
+            ringbuf_m4_run(&c->m4[k], values[k] + i, j - i);
+        }
+    }
+}
+
+/* Rows of a view from its first row inside the span on */
+static void ringbuf_columns_add_view(ringbuf_columns_t *c, const ringbuf_view_t *view) {
+    const double *values[RINGBUF_MAX_COLUMNS];
+    uint32_t first, part, k;
+
+    first = ringbuf_view_seek(view, c->now_ms - c->span_ms);
+    for (part = 0; part < 2; part++) {
+        if (first < view->len[part]) {
+            for (k = 0; k < c->columns; k++) {
+                values[k] = view->values[k][part] + first;
+            }
+            ringbuf_columns_add_rows(c, values, view->timestamps[part] + first, view->len[part] - first);
+            first = 0;
+        } else {
+            first -= view->len[part];
+        }
+    }
+}
+
+#ifdef TSBLOCK_SUPPORTED
+static void ringbuf_archive_columns(ringbuf_t *ringbuf, ringbuf_columns_t *c) {
+    tsblock_t copy;
+    tsblock_iter_t it;
+    const tsblock_t *block;
+    uint32_t seq, gen, used, head, idx, i, attempts;
+    uint32_t timestamp_ms;
+    double values[RINGBUF_MAX_COLUMNS];
+    const double *rows[RINGBUF_MAX_COLUMNS];
+    int stable;
+
+    for (i = 0; i < RINGBUF_MAX_COLUMNS; i++) {
+        rows[i] = &values[i];
+    }
+
+    for (attempts = 0; attempts < RINGBUF_READ_ATTEMPTS; attempts++) {
+        seq = ringbuf->seq;
+        ringbuf_barrier(ringbuf);
+        if (seq & 1) continue;
+        used = ringbuf->archive_used;
+        head = ringbuf->archive_head;
+        ringbuf_barrier(ringbuf);
+        if (ringbuf->seq == seq) break;
+    }
+    if (attempts == RINGBUF_READ_ATTEMPTS || used == 0) return;
+
+    for (i = 0; i < used; i++) {
+        idx = (head + ringbuf->archive_blocks - (used - 1) + i) % ringbuf->archive_blocks;
+        block = &ringbuf->archive[idx];
+
+        /* closed blocks only change when recycled, which bumps gen; the
+         * open one changes with every push, so it is copied under seq */
+        stable = 0;
+        for (attempts = 0; attempts < RINGBUF_READ_ATTEMPTS && !stable; attempts++) {
+            seq = ringbuf->seq;
+            gen = block->gen;
+            ringbuf_barrier(ringbuf);
+            if (i + 1 < used && c->now_ms - block->last_ts > c->span_ms) break;
+            memcpy(&copy, block, sizeof(copy));
+            ringbuf_barrier(ringbuf);
+            if (block->gen != gen) break;
+            stable = (i + 1 < used) || (!(seq & 1) && ringbuf->seq == seq);
+        }
+        if (!stable || copy.values != c->columns) continue;
+
+        tsblock_iter_init(&it, &copy);
+        while (tsblock_iter_next(&it, values, &timestamp_ms)) {
+            ringbuf_columns_add_rows(c, rows, &timestamp_ms, 1);
+        }
+    }
+}
+#endif
+
+/* Reduces every row from the last span_ms, archived ones first, then the
+ * raw ring, to one ringbuf_m4_t per ms_per_px wide pixel column, oldest
+ * first. out holds one array per series; all of them share timestamps,
+ * each column's newest. */
+uint32_t ringbuf_read_columns(ringbuf_t *ringbuf, uint32_t now_ms, uint32_t span_ms, double ms_per_px, ringbuf_m4_t *const *out, uint32_t *timestamps, uint32_t max) {
+    ringbuf_columns_t c;
+    ringbuf_view_t view;
+
+    if (!ringbuf || !out || !timestamps || max == 0) return 0;
+
+    ringbuf_columns_init(&c, out, timestamps, ringbuf->columns, max, now_ms, span_ms, ms_per_px);
+
+#ifdef TSBLOCK_SUPPORTED
+    if (ringbuf->archive) ringbuf_archive_columns(ringbuf, &c);
+#endif
+
+    if (ringbuf_view_begin(ringbuf, &view)) {
+        ringbuf_columns_add_view(&c, &view);
+        ringbuf_view_end(ringbuf, &view);
+    }
+
+    ringbuf_columns_flush(&c);
+    return c.n;
+}
+
+/* Same for the rows of an open view only; cost follows the rows inside the
+ * span, not the size of the ring */
+uint32_t ringbuf_view_columns(const ringbuf_view_t *view, uint32_t now_ms, uint32_t span_ms, double ms_per_px, ringbuf_m4_t *const *out, uint32_t *timestamps, uint32_t max) {
+    ringbuf_columns_t c;
+
+    if (!view || !out || !timestamps || max == 0) return 0;
+
+    ringbuf_columns_init(&c, out, timestamps, view->columns, max, now_ms, span_ms, ms_per_px);
+    ringbuf_columns_add_view(&c, view);
+    ringbuf_columns_flush(&c);
+    return c.n;
+}
+
+/* Reduces the buckets of one tier within span_ms of now_ms to pixel
+ * columns: extremes from the buckets' min and max, first and last from
+ * their averages. Buckets are placed at their midpoint, which for the
+ * open one may not be reached yet. */
+uint32_t ringbuf_tier_read(ringbuf_t *ringbuf, uint32_t tier, uint32_t now_ms, uint32_t span_ms, double ms_per_px, ringbuf_m4_t *const *out, uint32_t *timestamps, uint32_t max) {
+    ringbuf_tier_view_t view;
+    ringbuf_columns_t c;
+    const ringbuf_bucket_t *bucket;
+    ringbuf_m4_t *m4;
+    uint32_t i, k, mid_ms;
+    int32_t column;
+    double avg;
+
+    if (!out || !timestamps || max == 0) return 0;
+    if (!ringbuf_tier_view_begin(ringbuf, tier, &view)) return 0;
+
+    ringbuf_columns_init(&c, out, timestamps, view.columns, max, now_ms, span_ms + view.bucket_ms, ms_per_px);
+    for (i = 0; i < view.count; i++) {
+        bucket = ringbuf_tier_view_bucket(&view, 0, i);
+        mid_ms = bucket->start_ms + view.bucket_ms / 2;
+        if ((int32_t)(now_ms - mid_ms) < 0) mid_ms = now_ms;
+        column = ringbuf_columns_of(&c, mid_ms);
+        if (column < 0) continue;
+
+        ringbuf_columns_open(&c, column, mid_ms);
+        for (k = 0; k < view.columns; k++) {
+            bucket = ringbuf_tier_view_bucket(&view, k, i);
+            m4 = &c.m4[k];
+            m4->errors += bucket->errors;
+            if (bucket->count == 0) continue;
+            avg = bucket->sum / bucket->count;
+            if (m4->count == 0) {
+                m4->first = avg;
+                m4->min = bucket->min;
+                m4->max = bucket->max;
+            } else {
+                if (bucket->min < m4->min) m4->min = bucket->min;
+                if (bucket->max > m4->max) m4->max = bucket->max;
+            }
+            m4->last = avg;
+            m4->count += bucket->count;
+        }
+    }
+    ringbuf_columns_flush(&c);
+
+    ringbuf_tier_view_end(ringbuf, &view);
+    return c.n;
+}
+
+/* Where a span of span_ms is read from, for a ring filled every
+ * interval_ms: the raw ring while it reaches that far. Past it, the
+ * archive keeps every sample but tiers reach further back, so it is only
+ * used while it covers the whole span. */
+int ringbuf_span_source(ringbuf_t *ringbuf, uint32_t now_ms, uint32_t span_ms, uint32_t interval_ms) {
+    if (!ringbuf) return RINGBUF_SPAN_RAW;
+    if ((double)span_ms <= (double)ringbuf->size * interval_ms) return RINGBUF_SPAN_RAW;
+    if (ringbuf->archive && (ringbuf->tier_count == 0 || ringbuf_archive_reaches(ringbuf, now_ms, span_ms))) {
+        return RINGBUF_SPAN_ARCHIVE;
+    }
+    return ringbuf_tier_for_span(ringbuf, span_ms);
+}
+
+/* Reduces the span to pixel columns from the source ringbuf_span_source
+ * picked. 0 when the raw ring could not be opened, which only costs the
+ * caller a frame. */
+int ringbuf_read_span(ringbuf_t *ringbuf, int source, uint32_t now_ms, uint32_t span_ms, double ms_per_px, ringbuf_m4_t *const *out, uint32_t *timestamps, uint32_t max, ringbuf_span_t *span) {
+    ringbuf_view_t view;
+
+    if (!ringbuf || !span) return 0;
+
+    span->count = 0;
+    span->whole_ring = 0;
+    span->intact = 1;
+    if (source == RINGBUF_SPAN_ARCHIVE) {
+        span->count = ringbuf_read_columns(ringbuf, now_ms, span_ms, ms_per_px, out, timestamps, max);
+    } else if (source >= 0) {
+        span->count = ringbuf_tier_read(ringbuf, (uint32_t)source, now_ms, span_ms, ms_per_px, out, timestamps, max);
+    } else {
+        if (!ringbuf_view_begin(ringbuf, &view)) return 0;
+        span->whole_ring = (ringbuf_view_seek(&view, now_ms - span_ms) == 0);
+        span->count = ringbuf_view_columns(&view, now_ms, span_ms, ms_per_px, out, timestamps, max);
+        span->intact = ringbuf_view_end(ringbuf, &view);
+    }
+    return 1;
+}
+
+/* Quantiles of one column over a span read from source: the merged
+ * sketches of the tier covering it. 0 for the raw ring, or when no tier
+ * has them, in which case the window's own p50/p95/p99 stand in. */
+int ringbuf_span_quantiles(ringbuf_t *ringbuf, int source, uint32_t column, uint32_t now_ms, uint32_t span_ms, const double *q, double *out, uint32_t n) {
+    int tier;
+
+    if (source == RINGBUF_SPAN_RAW) return 0;
+    tier = ringbuf_tier_for_span(ringbuf, span_ms);
+    if (tier < 0) return 0;
+    return ringbuf_tier_quantiles(ringbuf, (uint32_t)tier, column, now_ms, span_ms, q, out, n);
+}
@@ -3,26 +3,214 @@
 
 #include "compat.h"
 #include "os/os_interface.h"
+#include "tsblock.h"
+#include "sketch.h"
+
+#define RINGBUF_MAX_TIERS 4
+#define RINGBUF_MAX_COLUMNS TSBLOCK_MAX_VALUES
+
+/* One consolidation bucket; failed samples (negative values) are counted
+ * in errors and kept out of min/max/sum and the quantile sketch */
+typedef struct {
+    uint32_t start_ms;
+    uint32_t count;
+    uint32_t errors;
+    double min;
+    double max;
+    double sum;
+} ringbuf_bucket_t;
+
+/* A ring of fixed-width bucket rows, one bucket per column each;
+ * row head is the one being filled. The sketches, when kept, line up
+ * with the buckets; at about 7 times a bucket's size they are optional. */
+typedef struct {
+    uint32_t bucket_ms;
+    uint32_t size;
+    volatile uint32_t head;
+    volatile uint32_t count;
+    ringbuf_bucket_t *buckets;
+    sketch_t *sketches;     /* NULL when not kept */
+} ringbuf_tier_t;
+
+/* Statistics of one column over the rows currently in the ring; failed
+ * samples (negative values) are counted in errors and kept out of the
+ * rest. last is the newest successful value; the percentiles are sketch
+ * estimates within SKETCH_ALPHA. */
+typedef struct {
+    uint32_t count;
+    uint32_t errors;
+    double min;
+    double max;
+    double avg;
+    double last;
+    double p50;
+    double p95;
+    double p99;
+} ringbuf_stats_t;
+
+/* Producer-side state behind ringbuf_stats_t: monotonic deques of ring
+ * slots whose fronts are the window's min and max, a compensated running
+ * sum and a sketch that samples leave again as they are evicted */
+typedef struct {
+    uint32_t *min_slots;
+    uint32_t *max_slots;
+    uint32_t min_head, min_len;
+    uint32_t max_head, max_len;
+    uint32_t count;
+    uint32_t errors;
+    double sum;
+    double sum_error;       /* rounding sum has lost, added back on publish */
+    double last;
+    sketch_window_t sketch;
+} ringbuf_window_t;
+
+/* Layout of a file-backed buffer: this header, then each column's data,
+ * timestamps and each tier's buckets, then the archive blocks. The
+ * producer mirrors its positions here on every push so a restart picks up
+ * where the last run stopped. */
+#define RINGBUF_FILE_MAGIC 0x53524231   /* "SRB1" */
+#define RINGBUF_FILE_VERSION 7
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t columns;
+    uint32_t size;
+    uint32_t head;
+    uint32_t count;
+    uint32_t tier_count;
+    uint32_t tier_bucket_ms[RINGBUF_MAX_TIERS];
+    uint32_t tier_size[RINGBUF_MAX_TIERS];
+    uint32_t tier_head[RINGBUF_MAX_TIERS];
+    uint32_t tier_used[RINGBUF_MAX_TIERS];
+    uint32_t tier_sketches[RINGBUF_MAX_TIERS];
+    uint32_t archive_blocks;
+    uint32_t archive_head;
+    uint32_t archive_used;
+} ringbuf_file_header_t;
 
 typedef struct {
-    double *data;
+    uint32_t bucket_ms;
+    uint32_t buckets;
+    int sketches;           /* keep a quantile sketch per bucket */
+} ringbuf_tier_spec_t;
+
+/* Single-producer ring buffer of rows: one value per column sharing one
+ * timestamp, so the series of a dual plot can never drift apart. The
+ * producer never blocks: each push bumps seq to odd, writes the row, then
+ * bumps it back to even. Readers copy without locking and retry if seq
+ * moved underneath them. Resizes are queued and applied by the producer on
+ * its next push; file-backed buffers keep the size they were opened with. */
+typedef struct {
+    double *data[RINGBUF_MAX_COLUMNS];
     uint32_t *timestamps;
+    uint32_t columns;
     uint32_t size;
-    atomic_uint_fast32_t head;
-    atomic_uint_fast32_t tail;
-    atomic_uint_fast32_t count;
-    plot_mutex_t *write_mutex;
-    plot_mutex_t *resize_mutex;
+    volatile uint32_t seq;
+    volatile uint32_t head;
+    volatile uint32_t count;
+    volatile uint32_t pending_size;
+    ringbuf_window_t window[RINGBUF_MAX_COLUMNS];   /* producer only */
+    ringbuf_stats_t stats[RINGBUF_MAX_COLUMNS];     /* published with seq */
+    ringbuf_tier_t tiers[RINGBUF_MAX_TIERS];   /* finest first */
+    uint32_t tier_count;
+    /* samples pushed out of the raw ring, compressed; blocks[archive_head]
+     * is the one being appended to */
+    tsblock_t *archive;
+    uint32_t archive_blocks;
+    volatile uint32_t archive_head;
+    volatile uint32_t archive_used;
+    ringbuf_file_header_t *file;    /* NULL unless file-backed */
+    size_t file_size;
+    int file_handle;                /* holds the file lock while mapped */
+    plot_mutex_t *resize_mutex;     /* keeps the arrays alive while read */
+#ifndef SNG_HAVE_BARRIER
+    plot_mutex_t *barrier_mutex;
+#endif
 } ringbuf_t;
 
-ringbuf_t *ringbuf_create(uint32_t size);
+/* In-place read access: up to two const spans over the live arrays, oldest
+ * first. When the buffer is full the oldest slot is left out, so the view
+ * stays intact across one concurrent push; ringbuf_view_end reports whether
+ * more than that happened while it was open. */
+typedef struct {
+    const double *values[RINGBUF_MAX_COLUMNS][2];
+    const uint32_t *timestamps[2];
+    uint32_t len[2];
+    uint32_t columns;
+    uint32_t count;
+    uint32_t seq;
+} ringbuf_view_t;
+
+#define ringbuf_view_value(v, c, i) \
+    ((i) < (v)->len[0] ? (v)->values[(c)][0][(i)] : (v)->values[(c)][1][(i) - (v)->len[0]])
+#define ringbuf_view_timestamp(v, i) \
+    ((i) < (v)->len[0] ? (v)->timestamps[0][(i)] : (v)->timestamps[1][(i) - (v)->len[0]])
+
+/* One pixel column of one series after decimation (M4): the extremes keep
+ * every spike on screen and first and last are where a line enters and
+ * leaves the column. Failed samples are only counted in errors, so a
+ * column of nothing but failures has count 0. */
+typedef struct {
+    double min;
+    double max;
+    double first;
+    double last;
+    uint32_t count;
+    uint32_t errors;
+} ringbuf_m4_t;
+
+/* Same as ringbuf_view_t for one consolidation tier */
+typedef struct {
+    const ringbuf_bucket_t *buckets[2];
+    uint32_t len[2];
+    uint32_t columns;
+    uint32_t count;
+    uint32_t bucket_ms;
+    uint32_t seq;
+} ringbuf_tier_view_t;
+
+#define ringbuf_tier_view_bucket(v, c, i) \
+    ((i) < (v)->len[0] ? &(v)->buckets[0][(i) * (v)->columns + (c)] : \
+                         &(v)->buckets[1][((i) - (v)->len[0]) * (v)->columns + (c)])
+
+/* Sources ringbuf_span_source picks besides a tier index */
+#define RINGBUF_SPAN_RAW (-1)
+#define RINGBUF_SPAN_ARCHIVE (-2)
+
+/* What ringbuf_read_span produced */
+typedef struct {
+    uint32_t count;         /* pixel columns written */
+    int whole_ring;         /* the span reaches past the oldest raw row */
+    int intact;             /* no push tore the raw rows while they were read */
+} ringbuf_span_t;
+
+ringbuf_t *ringbuf_create(uint32_t size, uint32_t columns);
+ringbuf_t *ringbuf_create_file(const char *path, uint32_t size, uint32_t columns, const ringbuf_tier_spec_t *tiers, uint32_t tier_count, uint32_t archive_blocks);
 void ringbuf_destroy(ringbuf_t *ringbuf);
 int ringbuf_resize(ringbuf_t *ringbuf, uint32_t new_size);
-int ringbuf_push(ringbuf_t *ringbuf, double value, uint32_t timestamp_ms);
-int ringbuf_pop(ringbuf_t *ringbuf, double *value, uint32_t *timestamp_ms);
+int ringbuf_add_tier(ringbuf_t *ringbuf, uint32_t bucket_ms, uint32_t buckets, int sketches);
+int ringbuf_tier_for_span(ringbuf_t *ringbuf, uint32_t span_ms);
+int ringbuf_add_archive(ringbuf_t *ringbuf, uint32_t blocks);
+int ringbuf_archive_reaches(ringbuf_t *ringbuf, uint32_t now_ms, uint32_t span_ms);
+uint32_t ringbuf_read_columns(ringbuf_t *ringbuf, uint32_t now_ms, uint32_t span_ms, double ms_per_px, ringbuf_m4_t *const *out, uint32_t *timestamps, uint32_t max);
+uint32_t ringbuf_view_columns(const ringbuf_view_t *view, uint32_t now_ms, uint32_t span_ms, double ms_per_px, ringbuf_m4_t *const *out, uint32_t *timestamps, uint32_t max);
+int ringbuf_push(ringbuf_t *ringbuf, const double *values, uint32_t timestamp_ms);
+int ringbuf_pop(ringbuf_t *ringbuf, double *values, uint32_t *timestamp_ms);
+int ringbuf_get_stats(ringbuf_t *ringbuf, uint32_t column, ringbuf_stats_t *stats);
 uint32_t ringbuf_count(ringbuf_t *ringbuf);
 int ringbuf_is_full(ringbuf_t *ringbuf);
 int ringbuf_is_empty(ringbuf_t *ringbuf);
-int ringbuf_read_snapshot(ringbuf_t *ringbuf, double *values, uint32_t *timestamps, uint32_t buffer_size, uint32_t *count_out, uint32_t *head_out, uint32_t *tail_out);
+int ringbuf_view_begin(ringbuf_t *ringbuf, ringbuf_view_t *view);
+int ringbuf_view_end(ringbuf_t *ringbuf, ringbuf_view_t *view);
+uint32_t ringbuf_view_seek(const ringbuf_view_t *view, uint32_t since_ms);
+int ringbuf_tier_view_begin(ringbuf_t *ringbuf, uint32_t tier, ringbuf_tier_view_t *view);
+int ringbuf_tier_view_end(ringbuf_t *ringbuf, ringbuf_tier_view_t *view);
+int ringbuf_tier_quantiles(ringbuf_t *ringbuf, uint32_t tier, uint32_t column, uint32_t now_ms, uint32_t span_ms, const double *q, double *out, uint32_t n);
+uint32_t ringbuf_tier_read(ringbuf_t *ringbuf, uint32_t tier, uint32_t now_ms, uint32_t span_ms, double ms_per_px, ringbuf_m4_t *const *out, uint32_t *timestamps, uint32_t max);
+int ringbuf_span_source(ringbuf_t *ringbuf, uint32_t now_ms, uint32_t span_ms, uint32_t interval_ms);
+int ringbuf_read_span(ringbuf_t *ringbuf, int source, uint32_t now_ms, uint32_t span_ms, double ms_per_px, ringbuf_m4_t *const *out, uint32_t *timestamps, uint32_t max, ringbuf_span_t *span);
+int ringbuf_span_quantiles(ringbuf_t *ringbuf, int source, uint32_t column, uint32_t now_ms, uint32_t span_ms, const double *q, double *out, uint32_t n);
+int ringbuf_read_snapshot(ringbuf_t *ringbuf, double *const *values, uint32_t *timestamps, uint32_t buffer_size, uint32_t *count_out, uint32_t *head_out, uint32_t *tail_out);
 
 #endif
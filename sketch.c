@@ -0,0 +1,199 @@
+#include "compat.h"
+#include "sketch.h"
+#include <math.h>
+#include <string.h>
+
+#define SKETCH_GAMMA ((1.0 + SKETCH_ALPHA) / (1.0 - SKETCH_ALPHA))
+#define SKETCH_BIN_MAX 0xffffffffU
+
+static int32_t sketch_key(double value) {
+    return (int32_t)ceil(log(value) / log(SKETCH_GAMMA));
+}
+
+/* Midpoint of the bin, which is what bounds the relative error */
+static double sketch_key_value(int32_t key) {
+    return 2.0 * pow(SKETCH_GAMMA, (double)key) / (SKETCH_GAMMA + 1.0);
+}
+
+static int sketch_top(const sketch_t *sketch) {
+    int i;
+
+    for (i = SKETCH_BINS - 1; i >= 0; i--) {
+        if (sketch->bins[i]) return i;
+    }
+    return -1;
+}
+
+void sketch_clear(sketch_t *sketch) {
+    memset(sketch, 0, sizeof(*sketch));
+}
+
+/* Counts n samples under key, moving the bin window to fit it. Keys above
+ * the window move it up, folding the lowest bins into bins[0]; keys below
+ * it move it down while the highest bin in use still fits, else land in
+ * bins[0]. Folded samples keep the key they were folded to, which is
+ * never below their own. */
+static void sketch_add_key(sketch_t *sketch, int32_t key, uint32_t n) {
+    uint32_t folded;
+    int32_t shift;
+    int top, i;
+
+    top = sketch_top(sketch);
+    if (top < 0) {
+        /* empty: start with the key in the middle */
+        memset(sketch->bins, 0, sizeof(sketch->bins));
+        sketch->offset = key - SKETCH_BINS / 2;
+    } else if (key < sketch->offset) {
+        shift = sketch->offset - key;
+        if (top + shift < SKETCH_BINS) {
+            memmove(&sketch->bins[shift], sketch->bins, sizeof(sketch->bins[0]) * (size_t)(top + 1));
+            memset(sketch->bins, 0, sizeof(sketch->bins[0]) * (size_t)shift);
+            sketch->offset = key;
+        } else {
+            key = sketch->offset;
+        }
+    } else if (key >= sketch->offset + SKETCH_BINS) {
+        shift = key - (sketch->offset + SKETCH_BINS - 1);
+        folded = 0;
+        for (i = 0; i <= shift && i < SKETCH_BINS; i++) {
+            folded = (sketch->bins[i] > SKETCH_BIN_MAX - folded) ? SKETCH_BIN_MAX : folded + sketch->bins[i];
+        }
+        if (shift < SKETCH_BINS) {
+            memmove(&sketch->bins[1], &sketch->bins[shift + 1], sizeof(sketch->bins[0]) * (size_t)(SKETCH_BINS - 1 - shift));
+            memset(&sketch->bins[SKETCH_BINS - shift], 0, sizeof(sketch->bins[0]) * (size_t)shift);
+        } else {
+            memset(sketch->bins, 0, sizeof(sketch->bins));
+        }
+        sketch->bins[0] = folded;
+        sketch->offset = key - (SKETCH_BINS - 1);
+    }
+
+    i = key - sketch->offset;
+    sketch->bins[i] = (n > SKETCH_BIN_MAX - sketch->bins[i]) ? SKETCH_BIN_MAX : sketch->bins[i] + n;
+}
+
+void sketch_add(sketch_t *sketch, double value) {
+    sketch->count++;
+    if (!(value >= SKETCH_MIN_VALUE)) {
+        sketch->zeros++;
+        return;
+    }
+    sketch_add_key(sketch, sketch_key(value), 1);
+}
+
+void sketch_merge(sketch_t *dst, const sketch_t *src) {
+    int i;
+
+    dst->count += src->count;
+    dst->zeros += src->zeros;
+    for (i = 0; i < SKETCH_BINS; i++) {
+        if (src->bins[i]) sketch_add_key(dst, src->offset + i, src->bins[i]);
+    }
+}
+
+/* q in [0, 1]; 0 for an empty sketch */
+double sketch_quantile(const sketch_t *sketch, double q) {
+    double rank;
+    uint32_t seen;
+    int i, top;
+
+    if (sketch->count == 0) return 0.0;
+
+    rank = q * (double)(sketch->count - 1);
+    seen = sketch->zeros;
+    if ((double)seen > rank) return 0.0;
+
+    top = -1;
+    for (i = 0; i < SKETCH_BINS; i++) {
+        if (!sketch->bins[i]) continue;
+        top = i;
+        seen += sketch->bins[i];
+        if ((double)seen > rank) return sketch_key_value(sketch->offset + i);
+    }
+
+    /* only reached when the bins hold fewer samples than count */
+    return (top >= 0) ? sketch_key_value(sketch->offset + top) : 0.0;
+}
+
+/* Key of bins[0] of a window sketch, sketch_key(SKETCH_MIN_VALUE) */
+#define SKETCH_WINDOW_BASE (-258)
+
+static uint32_t sketch_window_index(double value) {
+    int32_t i;
+
+    if (value >= 1e300) return SKETCH_WINDOW_BINS - 1;
+    i = sketch_key(value) - SKETCH_WINDOW_BASE;
+    if (i < 0) return 0;
+    if (i >= SKETCH_WINDOW_BINS) return SKETCH_WINDOW_BINS - 1;
+    return (uint32_t)i;
+}
+
+void sketch_window_clear(sketch_window_t *sketch) {
+    memset(sketch, 0, sizeof(*sketch));
+}
+
+void sketch_window_add(sketch_window_t *sketch, double value) {
+    uint32_t i;
+
+    sketch->count++;
+    if (!(value >= SKETCH_MIN_VALUE)) {
+        sketch->zeros++;
+        return;
+    }
+
+    i = sketch_window_index(value);
+    if (sketch->count - sketch->zeros == 1) {
+        sketch->lo = i;
+        sketch->hi = i;
+    } else {
+        if (i < sketch->lo) sketch->lo = i;
+        if (i > sketch->hi) sketch->hi = i;
+    }
+    sketch->bins[i]++;
+}
+
+/* Takes back a sample added earlier; it is found in the very bin it went
+ * to, however the other samples moved since */
+void sketch_window_remove(sketch_window_t *sketch, double value) {
+    uint32_t i;
+
+    if (sketch->count == 0) return;
+
+    if (!(value >= SKETCH_MIN_VALUE)) {
+        if (sketch->zeros == 0) return;
+        sketch->zeros--;
+        sketch->count--;
+        return;
+    }
+
+    i = sketch_window_index(value);
+    if (sketch->bins[i] == 0) return;
+    sketch->bins[i]--;
+    sketch->count--;
+
+    if (sketch->count == sketch->zeros) {
+        sketch->lo = 0;
+        sketch->hi = 0;
+        return;
+    }
+    while (sketch->bins[sketch->lo] == 0) sketch->lo++;
+    while (sketch->bins[sketch->hi] == 0) sketch->hi--;
+}
+
+/* q in [0, 1]; 0 for an empty sketch. Only the bins in use are walked. */
+double sketch_window_quantile(const sketch_window_t *sketch, double q) {
+    double rank;
+    uint32_t seen, i;
+
+    if (sketch->count == 0) return 0.0;
+
+    rank = q * (double)(sketch->count - 1);
+    seen = sketch->zeros;
+    if ((double)seen > rank || sketch->count == sketch->zeros) return 0.0;
+
+    for (i = sketch->lo; i < sketch->hi; i++) {
+        seen += sketch->bins[i];
+        if ((double)seen > rank) break;
+    }
+    return sketch_key_value(SKETCH_WINDOW_BASE + (int32_t)i);
+}
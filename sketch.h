@@ -0,0 +1,46 @@
+#ifndef SKETCH_H
+#define SKETCH_H
+
+#include "compat.h"
+
+/* DDSketch-style quantile sketch: values are counted in logarithmic bins
+ * gamma = (1 + alpha) / (1 - alpha) wide, so any quantile is returned
+ * within alpha relative error. The bins cover a range of gamma^SKETCH_BINS
+ * (about 165x); when values spread wider, the lowest bins are folded
+ * together, which keeps the upper quantiles exact to alpha and memory
+ * fixed. Sketches merge by adding bins. */
+#define SKETCH_ALPHA 0.04
+#define SKETCH_BINS 64
+#define SKETCH_MIN_VALUE 1e-9   /* anything smaller is counted as zero */
+
+typedef struct {
+    int32_t offset;         /* key of bins[0] */
+    uint32_t count;         /* all samples, zeros included */
+    uint32_t zeros;
+    uint32_t bins[SKETCH_BINS];
+} sketch_t;
+
+void sketch_clear(sketch_t *sketch);
+void sketch_add(sketch_t *sketch, double value);
+void sketch_merge(sketch_t *dst, const sketch_t *src);
+double sketch_quantile(const sketch_t *sketch, double q);
+
+/* The same bins fixed over every value from SKETCH_MIN_VALUE to about
+ * 5e17 instead of a moving window. Nothing is ever folded, so a sample
+ * can always be taken back out exactly, as a sliding window needs; larger
+ * values share the top bin. */
+#define SKETCH_WINDOW_BINS 768
+
+typedef struct {
+    uint32_t count;         /* all samples, zeros included */
+    uint32_t zeros;
+    uint32_t lo, hi;        /* lowest and highest bin in use */
+    uint32_t bins[SKETCH_WINDOW_BINS];
+} sketch_window_t;
+
+void sketch_window_clear(sketch_window_t *sketch);
+void sketch_window_add(sketch_window_t *sketch, double value);
+void sketch_window_remove(sketch_window_t *sketch, double value);
+double sketch_window_quantile(const sketch_window_t *sketch, double q);
+
+#endif
@@ -0,0 +1,76 @@
+/* Quantile sketch checks: cc -I. tests/sketch_test.c sketch.c -lm */
+#include "compat.h"
+#include "sketch.h"
+#include <math.h>
+#include <stdio.h>
+
+#define WINDOW 100
+
+static int failures;
+
+static void expect(const char *what, double got, double want) {
+    if (fabs(got - want) > SKETCH_ALPHA * want + 1e-12) {
+        printf("FAIL %s: got %g, want %g\n", what, got, want);
+        failures++;
+    }
+}
+
+/* Slides a WINDOW-sample window over values, like ringbuf does, and
+ * checks the percentiles once the spike at index 0 has left it */
+static void window_spike(const char *name, const double *values, int n, double p50, double p99) {
+    sketch_window_t w;
+    char what[64];
+    int i;
+
+    sketch_window_clear(&w);
+    for (i = 0; i < n; i++) {
+        if (i >= WINDOW) sketch_window_remove(&w, values[i - WINDOW]);
+        sketch_window_add(&w, values[i]);
+    }
+
+    sprintf(what, "%s p50", name);
+    expect(what, sketch_window_quantile(&w, 0.50), p50);
+    sprintf(what, "%s p99", name);
+    expect(what, sketch_window_quantile(&w, 0.99), p99);
+    if (w.count != WINDOW) {
+        printf("FAIL %s: count %u\n", name, (unsigned)w.count);
+        failures++;
+    }
+}
+
+int main(void) {
+    static double values[3 * WINDOW];
+    sketch_t a, b;
+    int i;
+
+    /* ping around 0.4 ms with one 150 ms spike */
+    values[0] = 150.0;
+    for (i = 1; i < 3 * WINDOW; i++) values[i] = 0.4;
+    window_spike("ping", values, 3 * WINDOW, 0.4, 0.4);
+
+    /* 1000-1099 with one 1e9 spike */
+    values[0] = 1e9;
+    for (i = 1; i < 3 * WINDOW; i++) values[i] = 1000.0 + (double)(i % 100);
+    window_spike("counter", values, 3 * WINDOW, 1050.0, 1099.0);
+
+    /* zeros and out of range values come back out too */
+    values[0] = 1e300;
+    for (i = 1; i < 3 * WINDOW; i++) values[i] = (i % 4 == 0) ? 0.0 : 5.0;
+    window_spike("zeros", values, 3 * WINDOW, 5.0, 5.0);
+
+    /* a plain sketch moves back down for lower values that still fit */
+    sketch_clear(&a);
+    sketch_add(&a, 10.0);
+    for (i = 0; i < 99; i++) sketch_add(&a, 0.4);
+    expect("add p50", sketch_quantile(&a, 0.50), 0.4);
+
+    sketch_clear(&b);
+    for (i = 0; i < 100; i++) sketch_add(&b, 2.0);
+    sketch_merge(&a, &b);
+    expect("merge p25", sketch_quantile(&a, 0.25), 0.4);
+    expect("merge p75", sketch_quantile(&a, 0.75), 2.0);
+
+    if (failures) return 1;
+    printf("sketch: ok\n");
+    return 0;
+}
@@ -1,66 +1,322 @@
 #include "compat.h"
 #include "threading.h"
 #include "os/os_interface.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-static void data_source_thread(void *arg) {
+/* All plots share one timer wheel and a small pool of collector threads.
+ * Workers tick on their own periodic timer, advance the wheel under the
+ * scheduler mutex, pop whatever became due and run the collect call outside
+ * the lock. Thread count and wakeups scale with the pool, not with targets. */
+
+#define SCHED_MIN_TICK_MS 10
+#define SCHED_MAX_TICK_MS 1000
+#define SCHED_MAX_DELTA ((1UL << (SCHED_WHEEL_BITS * SCHED_WHEEL_LEVELS)) - 1)
+
+static uint32_t gcd_u32(uint32_t a, uint32_t b) {
+    uint32_t t;
+
+    while (b) {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static void sched_add(data_scheduler_t *sched, data_source_t *source) {
+    uint32_t expires;
+    uint32_t delta;
+    data_source_t **slot;
+
+    expires = source->due_tick;
+    delta = expires - sched->tick;
+
+    if ((int32_t)delta < 0) {
+        /* overdue: run on the tick about to be processed */
+        slot = &sched->slots[0][sched->tick & SCHED_WHEEL_MASK];
+    } else if (delta < (1UL << SCHED_WHEEL_BITS)) {
+        slot = &sched->slots[0][expires & SCHED_WHEEL_MASK];
+    } else if (delta < (1UL << (SCHED_WHEEL_BITS * 2))) {
+        slot = &sched->slots[1][(expires >> SCHED_WHEEL_BITS) & SCHED_WHEEL_MASK];
+    } else if (delta < (1UL << (SCHED_WHEEL_BITS * 3))) {
+        slot = &sched->slots[2][(expires >> (SCHED_WHEEL_BITS * 2)) & SCHED_WHEEL_MASK];
+    } else {
+        if (delta > SCHED_MAX_DELTA) {
+            expires = sched->tick + SCHED_MAX_DELTA;
+            source->due_tick = expires;
+        }
+        slot = &sched->slots[3][(expires >> (SCHED_WHEEL_BITS * 3)) & SCHED_WHEEL_MASK];
+    }
+
+    source->sched_next = *slot;
+    *slot = source;
+}
+
+static uint32_t sched_cascade(data_scheduler_t *sched, int level, uint32_t index) {
+    data_source_t *list;
+    data_source_t *next;
+
+    list = sched->slots[level][index];
+    sched->slots[level][index] = NULL;
+    while (list) {
+        next = list->sched_next;
+        sched_add(sched, list);
+        list = next;
+    }
+    return index;
+}
+
+static void sched_run_tick(data_scheduler_t *sched) {
+    uint32_t index;
+    data_source_t *list;
+    data_source_t *next;
+
+    index = sched->tick & SCHED_WHEEL_MASK;
+    if (!index &&
+        !sched_cascade(sched, 1, (sched->tick >> SCHED_WHEEL_BITS) & SCHED_WHEEL_MASK) &&
+        !sched_cascade(sched, 2, (sched->tick >> (SCHED_WHEEL_BITS * 2)) & SCHED_WHEEL_MASK)) {
+        sched_cascade(sched, 3, (sched->tick >> (SCHED_WHEEL_BITS * 3)) & SCHED_WHEEL_MASK);
+    }
+    sched->tick++;
+
+    list = sched->slots[0][index];
+    sched->slots[0][index] = NULL;
+    while (list) {
+        next = list->sched_next;
+        list->sched_next = NULL;
+        if (sched->ready_tail) {
+            sched->ready_tail->sched_next = list;
+        } else {
+            sched->ready_head = list;
+        }
+        sched->ready_tail = list;
+        list = next;
+    }
+}
+
+/* Caller holds sched->mutex */
+static data_source_t *sched_next_due(data_scheduler_t *sched) {
+    uint32_t now_tick;
+    data_source_t *source;
+
+    now_tick = (os_get_time_ms() - sched->start_ms) / sched->tick_ms;
+    while ((int32_t)(now_tick - sched->tick) >= 0) {
+        sched_run_tick(sched);
+    }
+
+    source = sched->ready_head;
+    if (source) {
+        sched->ready_head = source->sched_next;
+        if (!sched->ready_head) sched->ready_tail = NULL;
+        source->sched_next = NULL;
+    }
+    return source;
+}
+
+/* Caller holds sched->mutex. Missed periods (suspend, a slow probe) are
+ * skipped rather than replayed back to back. */
+static void sched_reschedule(data_scheduler_t *sched, data_source_t *source) {
+    uint32_t behind;
+
+    source->due_tick += source->interval_ticks;
+    behind = sched->tick - source->due_tick;
+    if ((int32_t)behind > 0) {
+        source->due_tick += (behind / source->interval_ticks + 1) * source->interval_ticks;
+    }
+    sched_add(sched, source);
+}
+
+/* Both series of a dual source go out as one row */
+static void data_source_push(data_source_t *source, int success, double value1, double value2) {
+    double row[2];
+
+    row[0] = success ? value1 : -1.0;
+    row[1] = success ? value2 : -1.0;
+    ringbuf_push(source->data_buffer, row, os_get_time_ms());
+    if (source->on_sample) source->on_sample();
+}
+
+/* Runs on whatever thread finished the sample; the push happens before
+ * in_flight drops so a source never has two producers at once. */
+static void data_source_done(void *arg, int success, double value1, double value2) {
     data_source_t *source;
-    uint32_t sample_count;
+
+    source = (data_source_t*)arg;
+    data_source_push(source, success, value1, value2);
+
+    os_plot_mutex_lock(source->sched_mutex);
+    source->in_flight = 0;
+    os_plot_mutex_unlock(source->sched_mutex);
+}
+
+static void data_source_collect(data_source_t *source) {
     double in_value, out_value;
     int success;
-    double value;
-    uint32_t now_ms;
+
+    if (!source->datasource) {
+        data_source_push(source, 0, -1.0, -1.0);
+        return;
+    }
+
+    in_value = 0.0;
+    out_value = 0.0;
+    if (source->is_dual && source->datasource->handler->collect_dual) {
+        success = source->datasource->handler->collect_dual(source->datasource->context, &in_value, &out_value);
+    } else {
+        success = datasource_collect(source->datasource, &in_value);
+    }
+
+    data_source_push(source, success, in_value, out_value);
+}
+
+static void data_collector_worker(void *arg) {
+    data_collector_t *collector;
+    data_scheduler_t *sched;
+    data_source_t *source;
     plot_timer_t *timer;
 
-    source = (data_source_t*)arg;
-    if (!source) return;
+    collector = (data_collector_t*)arg;
+    if (!collector) return;
+    sched = &collector->scheduler;
 
-    timer = os_plot_timer_create((uint32_t)source->refresh_interval_ms);
+    timer = os_plot_timer_create(sched->tick_ms);
     if (!timer) return;
 
-    if (!source->datasource) {
-        while (1) {
-            ringbuf_push(source->data_buffer, -1.0, os_get_time_ms());
+    while (1) {
+        os_plot_mutex_lock(sched->mutex);
+        source = sched_next_due(sched);
+
+        if (!source) {
+            os_plot_mutex_unlock(sched->mutex);
             os_plot_timer_wait(timer);
+            continue;
         }
+
+        if (source->datasource && source->datasource->handler->collect_async) {
+            /* a sample still outstanding from last period just skips this one */
+            if (!source->in_flight) {
+                source->in_flight = 1;
+                os_plot_mutex_unlock(sched->mutex);
+                if (!source->datasource->handler->collect_async(source->datasource->context,
+                                                                data_source_done, source)) {
+                    data_source_done(source, 0, -1.0, -1.0);
+                }
+                os_plot_mutex_lock(sched->mutex);
+            }
+            sched_reschedule(sched, source);
+            os_plot_mutex_unlock(sched->mutex);
+            continue;
+        }
+        os_plot_mutex_unlock(sched->mutex);
+
+        data_source_collect(source);
+
+        os_plot_mutex_lock(sched->mutex);
+        sched_reschedule(sched, source);
+        os_plot_mutex_unlock(sched->mutex);
     }
+}
 
-    sample_count = 0;
-    while (1) {
+/* <dir>/<type>-<target>-<hash>[-<n>].ring; the target is reduced to safe
+ * characters and the hash keeps targets that reduce alike apart. n counts
+ * earlier plots of the same type and target so each gets its own file. */
+static void data_source_history_path(char *path, size_t size, const char *dir,
+                                     const char *type, const char *target, uint32_t dup) {
+    char safe[64];
+    uint32_t hash;
+    const char *p;
+    size_t i;
+
+    hash = 2166136261U;
+    for (p = type; *p; p++) hash = (hash ^ (uint8_t)*p) * 16777619U;
+    hash = (hash ^ ',') * 16777619U;
+    for (p = target; *p; p++) hash = (hash ^ (uint8_t)*p) * 16777619U;
+
+    for (i = 0; target[i] && i < sizeof(safe) - 1; i++) {
+        safe[i] = ((target[i] >= 'a' && target[i] <= 'z') || (target[i] >= 'A' && target[i] <= 'Z') ||
+                   (target[i] >= '0' && target[i] <= '9') || target[i] == '.' || target[i] == '-') ?
+                  target[i] : '_';
+    }
+    safe[i] = '\0';
 
-        if (source->is_dual && source->datasource->handler->collect_dual) {
-            in_value = 0.0;
-            out_value = 0.0;
-            success = source->datasource->handler->collect_dual(source->datasource->context, &in_value, &out_value);
-            now_ms = os_get_time_ms();
-
-            if (success) {
-                ringbuf_push(source->data_buffer, in_value, now_ms);
-                ringbuf_push(source->data_buffer_secondary, out_value, now_ms);
-            } else {
-                ringbuf_push(source->data_buffer, -1.0, now_ms);
-                ringbuf_push(source->data_buffer_secondary, -1.0, now_ms);
-            }
+    if (dup) {
+        snprintf(path, size, "%s/%s-%s-%08x-%u.ring", dir, type, safe, (unsigned)hash, (unsigned)dup);
+    } else {
+        snprintf(path, size, "%s/%s-%s-%08x.ring", dir, type, safe, (unsigned)hash);
+    }
+}
 
-            sample_count++;
-        } else {
-            value = 0.0;
-            success = datasource_collect(source->datasource, &value);
-            now_ms = os_get_time_ms();
-
-            if (success) {
-                ringbuf_push(source->data_buffer, value, now_ms);
-            } else {
-                ringbuf_push(source->data_buffer, -1.0, now_ms);
-            }
+/* Raw samples kept for a plot: its own history, else the global one, else
+ * as many as default_width shows at one pixel per sample. The window
+ * width has no say, so resizing never costs history. */
+static uint32_t data_source_history_size(config_t *config, plot_config_t *pc, int32_t refresh_interval_ms) {
+    uint32_t samples, ms;
+
+    samples = pc->history_samples;
+    ms = pc->history_ms;
+    if (!samples && !ms) {
+        samples = config->history_samples;
+        ms = config->history_ms;
+    }
+    if (ms && refresh_interval_ms > 0) {
+        samples = ms / (uint32_t)refresh_interval_ms + 1;
+    }
+    if (!samples) {
+        samples = (config->default_width > 4) ? (uint32_t)config->default_width - 2 : 2;
+    }
+    if (samples < 2) samples = 2;
+    if (samples > DATA_SOURCE_MAX_HISTORY) samples = DATA_SOURCE_MAX_HISTORY;
+    return samples;
+}
 
-            sample_count++;
-        }
+/* Backs the buffer with a file under history_dir when one is configured
+ * and the platform can map it, otherwise keeps it in memory. Tiers and
+ * the compressed archive are best effort in memory and tiers no coarser
+ * than the sample interval add nothing. */
+static ringbuf_t *data_source_buffer_create(config_t *config, uint32_t index, data_source_t *source) {
+    ringbuf_tier_spec_t tiers[CONFIG_MAX_HISTORY_TIERS];
+    plot_config_t *pc;
+    ringbuf_t *buffer;
+    uint32_t tier_count, size, columns, archive_blocks, dup, i;
+    char path[1024];
+
+    pc = &config->plots[index];
+    size = data_source_history_size(config, pc, source->refresh_interval_ms);
+    columns = source->is_dual ? 2 : 1;
+    archive_blocks = config->history_compressed_kb * 1024 / TSBLOCK_BYTES;
+
+    tier_count = 0;
+    for (i = 0; i < config->history_tier_count; i++) {
+        if (config->history_tiers[i].bucket_ms <= (uint32_t)source->refresh_interval_ms) continue;
+        tiers[tier_count].bucket_ms = config->history_tiers[i].bucket_ms;
+        tiers[tier_count].buckets = config->history_tiers[i].buckets;
+        tiers[tier_count].sketches = config->history_percentiles;
+        tier_count++;
+    }
 
-        os_plot_timer_wait(timer);
+    if (config->history_dir) {
+        dup = 0;
+        for (i = 0; i < index; i++) {
+            if (strcmp(config->plots[i].type, source->type) == 0 &&
+                strcmp(config->plots[i].target, source->target) == 0) dup++;
+        }
+        data_source_history_path(path, sizeof(path), config->history_dir, source->type, source->target, dup);
+        buffer = ringbuf_create_file(path, size, columns, tiers, tier_count, archive_blocks);
+        if (buffer) return buffer;
     }
 
+    buffer = ringbuf_create(size, columns);
+    if (!buffer) return NULL;
+
+    for (i = 0; i < tier_count; i++) {
+        ringbuf_add_tier(buffer, tiers[i].bucket_ms, tiers[i].buckets, tiers[i].sketches);
+    }
+    if (archive_blocks > 0) {
+        ringbuf_add_archive(buffer, archive_blocks);
+    }
+    return buffer;
 }
 
 data_collector_t *data_collector_create(config_t *config) {
@@ -73,6 +329,17 @@ data_collector_t *data_collector_create(config_t *config) {
     collector = malloc(sizeof(data_collector_t));
     if (!collector) return NULL;
 
+    memset(&collector->scheduler, 0, sizeof(collector->scheduler));
+    collector->workers = NULL;
+    collector->worker_count = 0;
+    collector->on_sample = NULL;
+
+#ifdef OS_HAVE_MAP_FILE
+    if (config->history_dir) {
+        os_make_dir(config->history_dir);
+    }
+#endif
+
     collector->source_count = config->plot_count;
     collector->sources = malloc(sizeof(data_source_t) * collector->source_count);
     if (!collector->sources) {
@@ -98,8 +365,16 @@ data_collector_t *data_collector_create(config_t *config) {
         strcpy(source->type, config->plots[i].type);
         strcpy(source->target, config->plots[i].target);
         source->datasource = datasource_create(config->plots[i].type, config->plots[i].target);
-        source->data_buffer = ringbuf_create(config->default_width - 2);
-        source->thread = NULL;
+        source->refresh_interval_ms = (config->plots[i].refresh_interval_ms > 0) ?
+                                     config->plots[i].refresh_interval_ms :
+                                     config->refresh_interval_ms;
+        source->is_dual = (source->datasource && source->datasource->handler->is_dual);
+        source->data_buffer = data_source_buffer_create(config, i, source);
+        source->interval_ticks = 1;
+        source->due_tick = 0;
+        source->sched_next = NULL;
+        source->in_flight = 0;
+        source->sched_mutex = NULL;
 
         if (!source->data_buffer) {
             for (j = 0; j < i; j++) {
@@ -112,36 +387,16 @@ data_collector_t *data_collector_create(config_t *config) {
             return NULL;
         }
 
-        source->is_dual = (source->datasource && source->datasource->handler->is_dual);
-        if (source->is_dual) {
-            source->data_buffer_secondary = ringbuf_create(config->default_width - 2);
-            if (!source->data_buffer_secondary) {
-                ringbuf_destroy(source->data_buffer);
-                for (j = 0; j < i; j++) {
-                    free(collector->sources[j].type);
-                    free(collector->sources[j].target);
-                    ringbuf_destroy(collector->sources[j].data_buffer);
-                    if (collector->sources[j].data_buffer_secondary) {
-                        ringbuf_destroy(collector->sources[j].data_buffer_secondary);
-                    }
-                }
-                free(collector->sources);
-                free(collector);
-                return NULL;
-            }
-        } else {
-            source->data_buffer_secondary = NULL;
-        }
-
-        source->refresh_interval_ms = (config->plots[i].refresh_interval_ms > 0) ?
-                                     config->plots[i].refresh_interval_ms :
-                                     config->refresh_interval_ms;
-
         if (source->datasource) {
             datasource_set_refresh_interval(source->datasource, source->refresh_interval_ms);
         }
     }
 
+    collector->worker_count = (config->collector_threads > 0) ? (uint32_t)config->collector_threads : 1;
+    if (collector->worker_count > collector->source_count) {
+        collector->worker_count = collector->source_count;
+    }
+
     return collector;
 }
 
@@ -155,30 +410,61 @@ void data_collector_destroy(data_collector_t *collector) {
         free(collector->sources[i].target);
         datasource_destroy(collector->sources[i].datasource);
         ringbuf_destroy(collector->sources[i].data_buffer);
-        if (collector->sources[i].data_buffer_secondary) {
-            ringbuf_destroy(collector->sources[i].data_buffer_secondary);
-        }
     }
-    
+
+    if (collector->scheduler.mutex) {
+        os_plot_mutex_destroy(collector->scheduler.mutex);
+    }
+    free(collector->workers);
     free(collector->sources);
     free(collector);
 }
 
 int data_collector_start(data_collector_t *collector) {
     uint32_t i;
+    uint32_t tick_ms;
+    data_scheduler_t *sched;
     data_source_t *source;
 
     if (!collector) return 0;
+    if (collector->source_count == 0) return 1;
+
+    sched = &collector->scheduler;
+    sched->mutex = os_plot_mutex_create();
+    if (!sched->mutex) return 0;
+
+    /* tick on the common divisor of all intervals so every plot lands on one */
+    tick_ms = 0;
+    for (i = 0; i < collector->source_count; i++) {
+        tick_ms = gcd_u32(tick_ms, (uint32_t)collector->sources[i].refresh_interval_ms);
+    }
+    if (tick_ms < SCHED_MIN_TICK_MS) tick_ms = SCHED_MIN_TICK_MS;
+    if (tick_ms > SCHED_MAX_TICK_MS) tick_ms = SCHED_MAX_TICK_MS;
+
+    sched->tick_ms = tick_ms;
+    sched->tick = 0;
+    sched->start_ms = os_get_time_ms();
 
     for (i = 0; i < collector->source_count; i++) {
         source = &collector->sources[i];
-        source->thread = os_plot_thread_create(data_source_thread, source);
+        source->interval_ticks = ((uint32_t)source->refresh_interval_ms + tick_ms / 2) / tick_ms;
+        if (source->interval_ticks == 0) source->interval_ticks = 1;
+        source->due_tick = 0;
+        source->sched_mutex = sched->mutex;
+        source->on_sample = collector->on_sample;
+        sched_add(sched, source);
+    }
 
-        if (!source->thread) {
+    collector->workers = malloc(sizeof(plot_thread_t*) * collector->worker_count);
+    if (!collector->workers) return 0;
+
+    for (i = 0; i < collector->worker_count; i++) {
+        collector->workers[i] = os_plot_thread_create(data_collector_worker, collector);
+
+        if (!collector->workers[i]) {
             return 0;
         }
     }
 
     return 1;
 }
-
@@ -7,20 +7,49 @@
 #include "config.h"
 #include "datasource.h"
 
-typedef struct {
+/* Upper bound on raw samples kept per plot, 20 bytes each per series */
+#define DATA_SOURCE_MAX_HISTORY (1U << 22)
+
+typedef struct data_source_s {
     char *type;
     char *target;
     datasource_t *datasource;
-    ringbuf_t *data_buffer;
-    ringbuf_t *data_buffer_secondary;
-    plot_thread_t *thread;
+    ringbuf_t *data_buffer;     /* two columns when is_dual */
     int32_t refresh_interval_ms;
     int is_dual;
+
+    /* Scheduler bookkeeping, owned by the collector */
+    uint32_t interval_ticks;
+    uint32_t due_tick;
+    struct data_source_s *sched_next;
+    int in_flight;          /* async sample outstanding, under scheduler mutex */
+    plot_mutex_t *sched_mutex;
+    void (*on_sample)(void);
 } data_source_t;
 
+/* Hierarchical timer wheel: 4 levels of 64 slots, 2^24 ticks of horizon */
+#define SCHED_WHEEL_BITS 6
+#define SCHED_WHEEL_SLOTS (1 << SCHED_WHEEL_BITS)
+#define SCHED_WHEEL_MASK (SCHED_WHEEL_SLOTS - 1)
+#define SCHED_WHEEL_LEVELS 4
+
+typedef struct {
+    data_source_t *slots[SCHED_WHEEL_LEVELS][SCHED_WHEEL_SLOTS];
+    data_source_t *ready_head;
+    data_source_t *ready_tail;
+    uint32_t tick;          /* next tick to be processed */
+    uint32_t tick_ms;
+    uint32_t start_ms;
+    plot_mutex_t *mutex;
+} data_scheduler_t;
+
 typedef struct {
     data_source_t *sources;
     uint32_t source_count;
+    data_scheduler_t scheduler;
+    plot_thread_t **workers;
+    uint32_t worker_count;
+    void (*on_sample)(void);    /* after every push, on the pushing thread */
 } data_collector_t;
 
 data_collector_t *data_collector_create(config_t *config);
@@ -0,0 +1,265 @@
+#include "compat.h"
+#include "tsblock.h"
+#include <string.h>
+
+#ifdef TSBLOCK_SUPPORTED
+
+/* Worst case for one sample: '1111' + 32-bit delta-of-delta, then per
+ * value '11' + 5-bit leading + 6-bit length + 64 value bits */
+#define TSBLOCK_MAX_SAMPLE_BITS(values) (4 + 32 + (values) * (2 + 5 + 6 + 64))
+
+static uint64_t double_bits(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static double bits_double(uint64_t bits) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static uint32_t count_leading(uint64_t x) {
+    uint32_t n;
+
+    n = 0;
+    while (n < 64 && !(x & ((uint64_t)1 << 63))) {
+        x <<= 1;
+        n++;
+    }
+    return n;
+}
+
+static uint32_t count_trailing(uint64_t x) {
+    uint32_t n;
+
+    n = 0;
+    while (n < 64 && !(x & 1)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+}
+
+/* MSB-first; payload bytes past bits are zero, so writes only OR in */
+static void put_bits(tsblock_t *block, uint64_t value, uint32_t nbits) {
+    uint32_t pos, room, take;
+    uint8_t chunk;
+
+    while (nbits > 0) {
+        pos = block->bits;
+        room = 8 - (pos & 7);
+        take = (nbits < room) ? nbits : room;
+        chunk = (uint8_t)((value >> (nbits - take)) & ((1U << take) - 1));
+        block->payload[pos >> 3] |= (uint8_t)(chunk << (room - take));
+        block->bits += take;
+        nbits -= take;
+    }
+}
+
+/* Reads past the payload come back as zeros but still advance bitpos, so
+ * the caller can tell an overrun from the position */
+static uint64_t get_bits(const uint8_t *payload, uint32_t *bitpos, uint32_t nbits) {
+    uint64_t value;
+    uint32_t pos, room, take;
+
+    value = 0;
+    if (nbits > 64) nbits = 64;
+    while (nbits > 0) {
+        pos = *bitpos;
+        if (pos >= TSBLOCK_PAYLOAD_BYTES * 8) {
+            value = (nbits < 64) ? value << nbits : 0;
+            *bitpos += nbits;
+            break;
+        }
+        room = 8 - (pos & 7);
+        take = (nbits < room) ? nbits : room;
+        value = (value << take) | ((payload[pos >> 3] >> (room - take)) & ((1U << take) - 1));
+        *bitpos += take;
+        nbits -= take;
+    }
+    return value;
+}
+
+/* Starts the block over with a first sample of count values */
+void tsblock_start(tsblock_t *block, const double *values, uint32_t count, uint32_t timestamp_ms) {
+    uint32_t gen;
+    uint32_t i;
+
+    if (count > TSBLOCK_MAX_VALUES) count = TSBLOCK_MAX_VALUES;
+
+    gen = block->gen;
+    memset(block, 0, sizeof(*block));
+    block->gen = gen + 1;
+    block->count = 1;
+    block->values = count;
+    block->first_ts = timestamp_ms;
+    block->last_ts = timestamp_ms;
+    for (i = 0; i < count; i++) {
+        block->chains[i].first = double_bits(values[i]);
+        block->chains[i].last = block->chains[i].first;
+        block->chains[i].leading = 0xff;    /* no previous window yet */
+    }
+}
+
+/* Gorilla XOR encoding of one value against its column's previous one */
+static void put_value(tsblock_t *block, tsblock_chain_t *chain, double value) {
+    uint64_t bits, x;
+    uint32_t leading, trailing, meaningful;
+
+    bits = double_bits(value);
+    x = bits ^ chain->last;
+    chain->last = bits;
+    if (x == 0) {
+        put_bits(block, 0, 1);
+        return;
+    }
+
+    leading = count_leading(x);
+    trailing = count_trailing(x);
+    if (leading > 31) leading = 31;
+
+    if (chain->leading != 0xff && leading >= chain->leading && trailing >= chain->trailing) {
+        /* fits in the previous meaningful window */
+        meaningful = 64 - chain->leading - chain->trailing;
+        put_bits(block, 2, 2);
+        put_bits(block, x >> chain->trailing, meaningful);
+    } else {
+        meaningful = 64 - leading - trailing;
+        put_bits(block, 3, 2);
+        put_bits(block, leading, 5);
+        put_bits(block, meaningful & 63, 6);    /* 64 stored as 0 */
+        put_bits(block, x >> trailing, meaningful);
+        chain->leading = (uint8_t)leading;
+        chain->trailing = (uint8_t)trailing;
+    }
+}
+
+/* Appends one value per column; returns 0 when the block is full, in
+ * which case the sample is not consumed */
+int tsblock_append(tsblock_t *block, const double *values, uint32_t timestamp_ms) {
+    int32_t delta, dod;
+    uint32_t i;
+
+    if (block->bits + TSBLOCK_MAX_SAMPLE_BITS(block->values) > TSBLOCK_PAYLOAD_BYTES * 8) return 0;
+
+    delta = (int32_t)(timestamp_ms - block->last_ts);
+    dod = delta - block->last_delta;
+    if (dod == 0) {
+        put_bits(block, 0, 1);
+    } else if (dod >= -63 && dod <= 64) {
+        put_bits(block, 2, 2);
+        put_bits(block, (uint64_t)(dod + 63), 7);
+    } else if (dod >= -255 && dod <= 256) {
+        put_bits(block, 6, 3);
+        put_bits(block, (uint64_t)(dod + 255), 9);
+    } else if (dod >= -2047 && dod <= 2048) {
+        put_bits(block, 14, 4);
+        put_bits(block, (uint64_t)(dod + 2047), 12);
+    } else {
+        put_bits(block, 15, 4);
+        put_bits(block, (uint64_t)(uint32_t)dod, 32);
+    }
+
+    for (i = 0; i < block->values; i++) {
+        put_value(block, &block->chains[i], values[i]);
+    }
+
+    block->last_ts = timestamp_ms;
+    block->last_delta = delta;
+    block->count++;
+    return 1;
+}
+
+/* Checks a block read back from outside (e.g. a mapped file) for encoder
+ * state the code could not have produced: an untouched block is all
+ * zeros, anything else holds values columns and fits its payload */
+int tsblock_valid(const tsblock_t *block, uint32_t values) {
+    const tsblock_chain_t *chain;
+    uint32_t i;
+
+    if (block->count == 0) return block->values == 0 && block->bits == 0;
+    if (values > TSBLOCK_MAX_VALUES) values = TSBLOCK_MAX_VALUES;
+    if (block->values != values || block->bits > TSBLOCK_PAYLOAD_BYTES * 8) return 0;
+    /* every sample after the first takes at least one bit per field */
+    if (block->count - 1 > block->bits) return 0;
+
+    for (i = 0; i < values; i++) {
+        chain = &block->chains[i];
+        if (chain->leading == 0xff) continue;
+        if (chain->leading > 31 || chain->leading + chain->trailing > 63) return 0;
+    }
+    return 1;
+}
+
+/* Walks the samples the block held when the iterator was set up */
+void tsblock_iter_init(tsblock_iter_t *it, const tsblock_t *block) {
+    uint32_t i;
+
+    it->block = block;
+    it->index = 0;
+    it->count = block->count;
+    it->bitpos = 0;
+    it->ts = block->first_ts;
+    it->delta = 0;
+    for (i = 0; i < TSBLOCK_MAX_VALUES; i++) {
+        it->value[i] = (i < block->values) ? block->chains[i].first : 0;
+        it->leading[i] = 0;
+        it->trailing[i] = 0;
+    }
+}
+
+/* Yields the next sample's timestamp and its values, one per column */
+int tsblock_iter_next(tsblock_iter_t *it, double *values, uint32_t *timestamp_ms) {
+    const uint8_t *p;
+    int32_t dod;
+    uint32_t meaningful;
+    uint32_t i, count;
+
+    if (it->index >= it->count) return 0;
+
+    p = it->block->payload;
+    count = it->block->values;
+    if (count > TSBLOCK_MAX_VALUES) return 0;
+
+    if (it->index > 0) {
+        if (!get_bits(p, &it->bitpos, 1)) {
+            dod = 0;
+        } else if (!get_bits(p, &it->bitpos, 1)) {
+            dod = (int32_t)get_bits(p, &it->bitpos, 7) - 63;
+        } else if (!get_bits(p, &it->bitpos, 1)) {
+            dod = (int32_t)get_bits(p, &it->bitpos, 9) - 255;
+        } else if (!get_bits(p, &it->bitpos, 1)) {
+            dod = (int32_t)get_bits(p, &it->bitpos, 12) - 2047;
+        } else {
+            dod = (int32_t)(uint32_t)get_bits(p, &it->bitpos, 32);
+        }
+        it->delta = (int32_t)((uint32_t)it->delta + (uint32_t)dod);
+        it->ts += (uint32_t)it->delta;
+
+        for (i = 0; i < count; i++) {
+            if (!get_bits(p, &it->bitpos, 1)) continue;
+            if (get_bits(p, &it->bitpos, 1)) {
+                it->leading[i] = (uint8_t)get_bits(p, &it->bitpos, 5);
+                meaningful = (uint32_t)get_bits(p, &it->bitpos, 6);
+                if (meaningful == 0) meaningful = 64;
+                if (it->leading[i] + meaningful > 64) return 0;
+                it->trailing[i] = (uint8_t)(64 - it->leading[i] - meaningful);
+            } else {
+                meaningful = 64 - it->leading[i] - it->trailing[i];
+            }
+            it->value[i] ^= get_bits(p, &it->bitpos, meaningful) << it->trailing[i];
+        }
+        if (it->bitpos > TSBLOCK_PAYLOAD_BYTES * 8) return 0;
+    }
+
+    it->index++;
+    for (i = 0; i < count; i++) {
+        values[i] = bits_double(it->value[i]);
+    }
+    *timestamp_ms = it->ts;
+    return 1;
+}
+
+#endif /* TSBLOCK_SUPPORTED */
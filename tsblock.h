@@ -0,0 +1,62 @@
+#ifndef TSBLOCK_H
+#define TSBLOCK_H
+
+#include "compat.h"
+
+/* Fixed-size compressed sample blocks in the style of Facebook's Gorilla:
+ * timestamps as delta-of-delta, values as XOR against the previous value.
+ * Slowly changing series land around 1-3 bytes per sample against 12 raw.
+ * VAX has no 64-bit integers, so blocks are unavailable there. */
+#if !(defined(__VMS) && defined(__VAX))
+#define TSBLOCK_SUPPORTED
+#endif
+
+#define TSBLOCK_BYTES 1024
+#define TSBLOCK_MAX_VALUES 2    /* values per sample, sharing one timestamp */
+#define TSBLOCK_HEADER_BYTES (32 + 24 * TSBLOCK_MAX_VALUES)
+#define TSBLOCK_PAYLOAD_BYTES (TSBLOCK_BYTES - TSBLOCK_HEADER_BYTES)
+
+/* XOR chain state of one value column */
+typedef struct {
+    uint64_t first;         /* IEEE bits, the base of the chain */
+    uint64_t last;
+    uint8_t leading;
+    uint8_t trailing;
+    uint8_t pad[6];
+} tsblock_chain_t;
+
+/* The header carries the encoder state, so a block can be continued from
+ * nothing but its own bytes (e.g. after being mapped back from a file).
+ * Each sample is its timestamp followed by every column's value. */
+typedef struct {
+    uint32_t gen;           /* bumped every time the block is restarted */
+    uint32_t count;
+    uint32_t bits;          /* payload bits in use */
+    uint32_t first_ts;
+    uint32_t last_ts;
+    int32_t last_delta;
+    uint32_t values;        /* columns per sample */
+    uint32_t pad;
+    tsblock_chain_t chains[TSBLOCK_MAX_VALUES];
+    uint8_t payload[TSBLOCK_PAYLOAD_BYTES];
+} tsblock_t;
+
+typedef struct {
+    const tsblock_t *block;
+    uint32_t index;
+    uint32_t count;
+    uint32_t bitpos;
+    uint32_t ts;
+    int32_t delta;
+    uint64_t value[TSBLOCK_MAX_VALUES];
+    uint8_t leading[TSBLOCK_MAX_VALUES];
+    uint8_t trailing[TSBLOCK_MAX_VALUES];
+} tsblock_iter_t;
+
+void tsblock_start(tsblock_t *block, const double *values, uint32_t count, uint32_t timestamp_ms);
+int tsblock_append(tsblock_t *block, const double *values, uint32_t timestamp_ms);
+int tsblock_valid(const tsblock_t *block, uint32_t values);
+void tsblock_iter_init(tsblock_iter_t *it, const tsblock_t *block);
+int tsblock_iter_next(tsblock_iter_t *it, double *values, uint32_t *timestamp_ms);
+
+#endif